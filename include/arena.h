@@ -0,0 +1,65 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Arena allocator module interface.
+ *
+ * The symbol table allocates many small, same-lifetime objects: the copy of
+ * every symbol, plus the slots of its hash table.  None of them is ever
+ * released before the assembly ends.  An arena hands them out by bumping a
+ * pointer through large blocks, and releases all of them at once, block by
+ * block, when it is destroyed.  The addresses and kinds of the symbols are
+ * not among them: their arrays grow with `realloc()`, which an arena can't do.
+ *
+ * Allocations are aligned to `ARENA_ALIGN`.  Requests larger than a quarter
+ * of the block size get a block of their own, so they never waste the rest of
+ * the current one.
+ *
+ * An arena lives in an opaque `Arena` object.  `arena_allocator()` wraps it as
+ * an `Allocator`, for modules that take an allocator hook.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#include "common/shared_defs.h"
+
+#define ARENA_ALIGN 16
+
+typedef struct arena_type Arena;
+
+/*
+ * Create an empty arena that allocates blocks of `block_size` bytes, or of a
+ * default size if zero.  Returns `NULL` setting `errno` on failure.
+ */
+Arena *
+arena_init(size_t block_size);
+
+/*
+ * Returns `size` bytes of uninitialized memory, valid until the arena is
+ * destroyed.  Returns `NULL` setting `errno` on failure.
+ */
+void *
+arena_alloc(Arena *arena, size_t size);
+
+/*
+ * Returns an `Allocator` drawing from `arena`.  Its `release` does nothing, the
+ * memory is only reclaimed by `arena_destroy()`.
+ */
+Allocator
+arena_allocator(Arena *arena);
+
+/*
+ * Returns the number of bytes handed out so far.
+ */
+size_t
+arena_used(const Arena *arena);
+
+/*
+ * Deallocate the arena and everything allocated from it.  Does nothing on a
+ * NULL arena.
+ */
+void
+arena_destroy(Arena *arena);
+
+#endif /* ARENA_H */
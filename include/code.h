@@ -12,7 +12,9 @@
  * 
  * The implementation file `code.c` performs lookups on constant symbol-address
  * pairs arrays and returns a value according to the implementation details, or
- * the `ERROR` macro if applicable.
+ * the `ERROR` macro if applicable.  The arrays, in `common/mnemonics.h`, are
+ * turned into perfect hash tables at build time by `tools/gencode.c`, so each
+ * lookup probes a single slot.
  *
  * The rationale behind this design is: 
  * + The constant arrays pairs are self-explanatory. 
@@ -26,6 +28,9 @@
  * `code_jump("JMP")` returns 7, in binary:    `0000 0000 0000 0111`
  *                                              -------------------
  * ORing with 0xE000 gives the instruction:    `1111 0101 0100 1111`
+ *
+ * The assembler hands the three fields over at once to `code_c_instruction()`,
+ * as `Field` slices straight out of the parsed line.
  */
 
 #ifndef CODE_H
@@ -59,4 +64,12 @@ code_comp(const char *mnemonic);
 uint16_t 
 code_jump(const char *mnemonic);
 
+/*
+ * Returns the whole C-instruction encoded from its `dest`, `comp` and `jump`
+ * fields, empty fields being allowed for `dest` and `jump`.  
+ * Returns `ERROR` if any of them is not a valid mnemonic.
+ */
+uint16_t
+code_c_instruction(Field dest, Field comp, Field jump);
+
 #endif /* CODE_H */
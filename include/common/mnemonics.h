@@ -0,0 +1,92 @@
+/*
+ * Part of the Hack Assembler from Nand2Tetris.
+ *
+ * The mnemonic tables of section 6.2.2.  They are not compiled into the
+ * assembler as they are: `tools/gencode.c` includes them at build time and
+ * generates the perfect hash tables `code.c` looks mnemonics up in.
+ */
+#ifndef MNEMONICS_H
+#define MNEMONICS_H
+
+#include "common/shared_defs.h"
+
+#define MAX_MNEMONIC_LEN 3      /* Max length of a mnemonic string */
+
+/*
+ * These arrays pair the most significant bits of a mnemonic field with its
+ * corresponding string, as the tables in section 6.2.2
+ */
+static const SymbolAddressPair Destinations[] = {
+                   /* ddd */
+    {0x0,    ""},  /* 000 */
+    {0x1,   "M"},  /* 001 */
+    {0x2,   "D"},  /* 010 */
+    {0x3,  "MD"},  /* 011 */
+    {0x4,   "A"},  /* 100 */
+    {0x5,  "AM"},  /* 101 */
+    {0x6,  "AD"},  /* 110 */
+    {0x7, "AMD"},  /* 111 */
+};
+
+static const SymbolAddressPair Computations[] = {
+                     /* acc cccc */
+    {0x2A,     "0"}, /* 010 1010 */
+    {0x3F,     "1"}, /* 011 1111 */
+    {0x3A,    "-1"}, /* 011 1010 */
+    {0x0C,     "D"},                       /* adding 0x40 toggles the `a` bit */
+    {0x30,     "A"}, {0x30 + 0x40,  "M"},  /* 011 0000, 111 0000 */
+    {0x0D,    "!D"},
+    {0x31,    "!A"}, {0x31 + 0x40,  "!M"}, /* 011 0001, 111 0001 */
+    {0x0F,    "-D"},
+    {0x33,    "-A"}, {0x33 + 0x40,  "-M"},
+    {0x1F,   "D+1"},
+    {0x37,   "A+1"}, {0x37 + 0x40, "M+1"},
+    {0x0E,   "D-1"},
+    {0x32,   "A-1"}, {0x32 + 0x40, "M-1"},
+    {0x02,   "D+A"}, {0x02 + 0x40, "D+M"},
+    {0x13,   "D-A"}, {0x13 + 0x40, "D-M"},
+    {0x07,   "A-D"}, {0x07 + 0x40, "M-D"},
+    {0x00,   "D&A"}, {0x00 + 0x40, "D&M"},
+    {0x15,   "D|A"}, {0x15 + 0x40, "D|M"}
+};
+
+static const SymbolAddressPair Jumps[] = {
+    {0x00,    ""},
+    {0x01, "JGT"},
+    {0x02, "JEQ"},
+    {0x03, "JGE"},
+    {0x04, "JLT"},
+    {0x05, "JNE"},
+    {0x06, "JLE"},
+    {0x07, "JMP"}
+};
+
+/*
+ * Packs the `len` bytes of a mnemonic into an integer, the first byte lowest,
+ * the way the lookups of `code.c` see it.  Mnemonics are at most 3 bytes long,
+ * so no key has its top byte set: longer strings pack to the impossible key
+ * `UINT32_MAX`.
+ */
+static inline uint32_t
+mnemonic_key(const char *s, uint32_t len)
+{
+    uint32_t key = 0;
+
+    switch (len) {
+    case 3:
+        key |= (uint32_t)(uint8_t)s[2] << 16;
+        /* FALLTHROUGH */
+    case 2:
+        key |= (uint32_t)(uint8_t)s[1] << 8;
+        /* FALLTHROUGH */
+    case 1:
+        key |= (uint32_t)(uint8_t)s[0];
+        /* FALLTHROUGH */
+    case 0:
+        return key;
+    default:
+        return UINT32_MAX;
+    }
+}
+
+#endif /* MNEMONICS_H */
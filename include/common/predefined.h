@@ -0,0 +1,35 @@
+/*
+ * Part of the Hack Assembler from Nand2Tetris.
+ *
+ * The predefined symbols of section 6.2.3.  `tools/gensymbols.c` includes
+ * them at build time and generates the matcher `symboltable.c` resolves them
+ * with, so they never go through the hash table.  Their index in the array is
+ * their ID in the symbol table.
+ */
+#ifndef PREDEFINED_H
+#define PREDEFINED_H
+
+#include "common/shared_defs.h"
+
+static const SymbolAddressPair PredefinedSymbols[] = {
+    {0x0000, "R0"},     {0x0000, "SP"},  
+    {0x0001, "R1"},     {0x0001, "LCL"}, 
+    {0x0002, "R2"},     {0x0002, "ARG"},
+    {0x0003, "R3"},     {0x0003, "THIS"},
+    {0x0004, "R4"},     {0x0004, "THAT"},
+    {0x0005, "R5"},
+    {0x0006, "R6"},
+    {0x0007, "R7"},
+    {0x0008, "R8"},     
+    {0x0009, "R9"},     
+    {0x000A, "R10"},
+    {0x000B, "R11"},
+    {0x000C, "R12"},    
+    {0x000D, "R13"},    
+    {0x000E, "R14"},    
+    {0x000F, "R15"},    
+    {0x4000, "SCREEN"},
+    {0x6000, "KBD"},
+};
+
+#endif /* PREDEFINED_H */
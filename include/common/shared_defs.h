@@ -7,6 +7,7 @@
 #ifndef SARED_DEFS_H
 #define SARED_DEFS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define ERROR       0x8000    /* Decimal -32768 reserved as error code */
@@ -26,4 +27,27 @@ typedef struct SymbolAddressPair {
     char     *symbol;         /* i.e.: JGT, D|M, (LABEL), @variable, etc.  */
 } SymbolAddressPair;
 
+/*
+ * A field of a command, `len` bytes at `str`, as split by the parser.  It is
+ * not null-terminated: it points into the line, the bytes after it belong to
+ * the next field.
+ */
+typedef struct Field {
+    const char *str;
+    uint32_t    len;
+} Field;
+
+/*
+ * A pluggable memory allocator: `alloc` returns `size` bytes or `NULL`, and
+ * `release` gives back a block `alloc` returned, so a module can get its
+ * memory from somewhere else than `malloc()`.  Both receive the opaque `ctx`.
+ * An allocator that releases everything at once, as an `Arena` does, may
+ * leave `release` as a no-op.
+ */
+typedef struct Allocator {
+    void *(*alloc)(void *ctx, size_t size);
+    void  (*release)(void *ctx, void *ptr);
+    void   *ctx;
+} Allocator;
+
 #endif /* SHARED_DEFS_H */
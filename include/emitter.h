@@ -0,0 +1,120 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Output emitter module interface.
+ *
+ * An emitter writes the words of a program as a ROM image, in one of the
+ * formats of `EmitterFormat`:
+ *
+ *  + `EMITTER_HACK`, the `.hack` text of the book: a line per word, its 16 bits
+ *    as ASCII digits.  17 bytes a word.
+ *  + `EMITTER_BIN_LE` and `EMITTER_BIN_BE`, the raw words, 2 bytes each, least
+ *    or most significant byte first.
+ *  + `EMITTER_IHEX`, Intel HEX: data records of up to 8 words, most significant
+ *    byte first, at byte addresses, and an end of file record.  The 32K words
+ *    of the Hack ROM fit in the 16-bit addresses, so there are no extended
+ *    address records.
+ *  + `EMITTER_READMEMH`, a line of 4 hexadecimal digits per word, as read by
+ *    the `$readmemh` task of Verilog.
+ *
+ * Writing a word at a time, through stdio, costs more than the whole
+ * translation.  The emitter collects words in batches of `EMITTER_BATCH`,
+ * formats every batch at once, with `hacktext_format()` for the `.hack` text,
+ * straight into a buffer of `EMITTER_BUFFER_SIZE` bytes, and hands full
+ * buffers to `write()`.
+ *
+ * Nothing is written until the buffer fills up or `emitter_flush()` is
+ * called, so the file descriptor must not be written through any other path
+ * in between.  `emitter_finish()` ends the image, with the trailer of its
+ * format if any.
+ *
+ * Errors are sticky, as in stdio: a failed `write()` is remembered, and
+ * reported by the next `emitter_flush()`.
+ *
+ * An emitter lives in an opaque `Emitter` object.
+ */
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hacktext.h"
+
+#define EMITTER_BATCH 64            /* Words formatted at once */
+#define EMITTER_BUFFER_SIZE (HACKTEXT_LINE * 8192)
+
+typedef enum EmitterFormat {
+    EMITTER_HACK,
+    EMITTER_BIN_LE,
+    EMITTER_BIN_BE,
+    EMITTER_IHEX,
+    EMITTER_READMEMH,
+    EMITTER_FORMATS                 /* How many there are */
+} EmitterFormat;
+
+typedef struct emitter_type Emitter;
+
+/*
+ * Create an emitter writing words to the file descriptor `fd`, open for
+ * writing, in `format`.  Returns `NULL` setting `errno` on failure.
+ */
+Emitter *
+emitter_init(int fd, EmitterFormat format);
+
+/*
+ * Appends `word` to the output.
+ */
+void
+emitter_word(Emitter *em, uint16_t word);
+
+/*
+ * Appends the `n` words in `words` to the output.
+ */
+void
+emitter_words(Emitter *em, const uint16_t *words, size_t n);
+
+/*
+ * Writes out whatever is buffered.  Returns `false` setting `errno` if this
+ * or any earlier write failed.
+ */
+bool
+emitter_flush(Emitter *em);
+
+/*
+ * Ends the output with the trailer of the format, if any, and writes out
+ * whatever is buffered.  Nothing may be appended afterwards.  Returns `false`
+ * setting `errno` if this or any earlier write failed.
+ */
+bool
+emitter_finish(Emitter *em);
+
+/*
+ * Returns the format named `name`, the name of an option, or
+ * `EMITTER_FORMATS` if there is none.
+ */
+EmitterFormat
+emitter_format(const char *name);
+
+/*
+ * Returns the name of `format`: "hack", "bin", "binbe", "ihex" or "readmemh".
+ */
+const char *
+emitter_format_name(EmitterFormat format);
+
+/*
+ * Returns the file extension of `format`, dot included: ".hack", ".bin",
+ * ".be.bin", ".hex" or ".mem".
+ */
+const char *
+emitter_format_extension(EmitterFormat format);
+
+/*
+ * Deallocate the emitter, dropping whatever is still buffered.  Does nothing
+ * on a NULL emitter.
+ */
+void
+emitter_destroy(Emitter *em);
+
+#endif /* EMITTER_H */
@@ -0,0 +1,70 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Fixup list module interface, backing the single-pass mode of the assembler.
+ *
+ * In a single pass an `@LABEL` may show up before `(LABEL)` does.  Its address
+ * is unknown at that point, so the instruction is emitted as a placeholder and
+ * the use is recorded here until the label is bound, or until the end of the
+ * input reveals that the symbol is in fact a variable.
+ *
+ * The uses of a pending symbol are threaded through the placeholder words
+ * themselves: every placeholder holds the index of the previous use of the same
+ * symbol, and this module only remembers the index of the latest one, the head
+ * of the chain.  The `ERROR` macro, never a valid instruction index, ends the
+ * chain.  For instance, after three uses of `@END` at instructions 2, 7 and 9:
+ *
+ * `fixups_take(fx, "END")` returns 9, word 9 holds 7, word 7 holds 2, and
+ * word 2 holds `ERROR`.
+ *
+ * Walking the chain and overwriting every word with the bound address is left
+ * to the caller, who owns the instruction words.
+ *
+ * The list lives in an opaque `Fixups` object, passed to every function.
+ */
+#ifndef FIXUPS_H
+#define FIXUPS_H
+
+#include <stdint.h>
+
+#include "common/shared_defs.h"
+
+typedef struct fixups_type Fixups;
+
+/*
+ * Create and initialize the fixup list.  Returns `NULL` setting `errno` on
+ * failure.
+ */
+Fixups *
+fixups_init(void);
+
+/*
+ * Records a use of the unresolved `symbol` at instruction `index`.  Returns the
+ * index of the previous use, the value the placeholder word must hold, or the
+ * `ERROR` macro if this is the first one.  Sets `errno` on failure.
+ */
+uint16_t
+fixups_add(Fixups *fx, const char *symbol, uint16_t index);
+
+/*
+ * Returns the head of the chain of uses of `symbol`, or the `ERROR` macro if it
+ * has none.  The symbol is no longer pending afterwards.
+ */
+uint16_t
+fixups_take(Fixups *fx, const char *symbol);
+
+/*
+ * Iterates over the symbols still pending, in order of first use.  Returns the
+ * next one storing the head of its chain in `head`, or `NULL` when exhausted.
+ * The symbols returned are no longer pending afterwards.
+ */
+const char *
+fixups_next_pending(Fixups *fx, uint16_t *head);
+
+/*
+ * Deallocate the fixup list.  Does nothing on a NULL list.
+ */
+void
+fixups_destroy(Fixups *fx);
+
+#endif /* FIXUPS_H */
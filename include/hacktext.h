@@ -0,0 +1,82 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Hack text conversion module interface.
+ *
+ * Converts between 16-bit words and the lines of a `.hack` file, 16 ASCII
+ * digits, most significant bit first, and a newline.  Whole arrays of words
+ * are converted at once, by one of several kernels:
+ *
+ *  + `HACKTEXT_SCALAR` formats a word with two lookups in a table of the 8
+ *    digits of every byte.  Runs anywhere.
+ *  + `HACKTEXT_SSE2` formats 8 words per iteration.  Every byte of a word is
+ *    broadcast to 8 lanes by unpacking, ANDed with a vector of single-bit
+ *    masks, compared to the masks and subtracted from '0': 0xFF, minus one,
+ *    turns a '0' into a '1'.
+ *  + `HACKTEXT_AVX2` formats as `HACKTEXT_SSE2` does: a line is 17 bytes, so
+ *    the digits of a 256-bit vector still go out as two 128-bit stores, and
+ *    the wider unpacking doesn't pay for itself.
+ *
+ * Parsing runs the other way: a line is compared to '1', its 16 bytes
+ * reversed, and their top bits gathered by a move mask into the word.  The
+ * AVX2 kernel parses two lines at once, one per 128-bit lane.
+ *
+ * The fastest kernel the CPU supports is picked on first use, at run time.
+ * `hacktext_select()` forces one, for tests and benchmarks.  On other
+ * architectures than x86 only the scalar kernel exists.
+ */
+#ifndef HACKTEXT_H
+#define HACKTEXT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HACKTEXT_LINE 17            /* 16 digits and a newline */
+
+typedef enum HackTextKernel {
+    HACKTEXT_SCALAR,
+    HACKTEXT_SSE2,
+    HACKTEXT_AVX2
+} HackTextKernel;
+
+/*
+ * Stores the `HACKTEXT_LINE` bytes of the line of `word` in `line`, not
+ * null-terminated.  Always scalar, the cheapest for a single word.
+ */
+void
+hacktext_line(uint16_t word, char *line);
+
+/*
+ * Stores the lines of the `n` words in `words` in `text`, `n` times
+ * `HACKTEXT_LINE` bytes, not null-terminated.
+ */
+void
+hacktext_format(const uint16_t *words, size_t n, char *text);
+
+/*
+ * Parses the `size` bytes of `text`, lines as `hacktext_format()` writes them,
+ * into `words`, room for `size / HACKTEXT_LINE` of them.  Stores the number of
+ * words parsed in `n`.  Returns `false` setting `errno` to `EINVAL` on a
+ * malformed line, `n` being then its index.
+ */
+bool
+hacktext_parse(const char *text, size_t size, uint16_t *words, size_t *n);
+
+/*
+ * Makes `kernel` the one used from now on, by every thread.  Returns `false`
+ * if the CPU doesn't support it.
+ */
+bool
+hacktext_select(HackTextKernel kernel);
+
+/*
+ * The kernel in use, and its name.
+ */
+HackTextKernel
+hacktext_kernel(void);
+
+const char *
+hacktext_kernel_name(HackTextKernel kernel);
+
+#endif /* HACKTEXT_H */
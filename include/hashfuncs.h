@@ -0,0 +1,49 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Hash function suite interface.
+ *
+ * The functions below all match the `HashFunction` type of the hash table ADT
+ * and all hash exactly `size` bytes, whatever they hold:
+ *
+ * + "djb2", one byte at a time, `hash * 33 + c`.  The original hash of the
+ *   symbol table, kept as a baseline.
+ * + "fnv1a", one byte at a time, 64-bit FNV-1a.
+ * + "wyhash", eight bytes at a time, in the style of wyhash: 64x64-bit
+ *   multiplications folded from 128 bits.
+ * + "crc32c", eight bytes at a time with the SSE4.2 `crc32` instruction when
+ *   the CPU supports it, one byte at a time otherwise.
+ *
+ * They are picked by name with `hash_select()`, which also resolves the
+ * hardware dispatch of "crc32c" once, at selection time.  The default one
+ * was chosen by running `make bench` over the symbols of the test corpus.
+ */
+#ifndef HASHFUNCS_H
+#define HASHFUNCS_H
+
+#include <stddef.h>
+
+#include "hashtable_adt.h"
+
+/*
+ * Returns the hash function called `name`, or the default one if `name` is
+ * `NULL`.  Returns `NULL` setting `errno` to `EINVAL` on an unknown name.
+ */
+HashFunction *
+hash_select(const char *name);
+
+/*
+ * Returns the name of the `i`th hash function of the suite, or `NULL` past the
+ * last one.
+ */
+const char *
+hash_name(size_t i);
+
+/*
+ * The "wyhash" function of the suite, for clients that call it directly
+ * rather than through a `HashFunction` pointer.
+ */
+size_t
+hash_wyhash(const void *key, size_t size);
+
+#endif /* HASHFUNCS_H */
@@ -5,6 +5,8 @@
 #include <stddef.h>
 /** @endcond */
 
+#include "common/shared_defs.h"
+
 /**
  * @brief Typedef for a _generic_ client-defined hash function.
  *
@@ -29,32 +31,64 @@ typedef size_t HashFunction(const void*, size_t);
 typedef struct hash_table_type HashTableADT;
 /** @endcond */
 
+/** Probe lengths the histogram of `HashTableStats` tells apart. */
+#define HT_HISTOGRAM_SIZE 8
+
+/**
+ * @brief A snapshot of the shape and usage of a hash table.
+ *
+ * The table is open addressed, so an element has no chain: its chain length is
+ * the number of 16-slot groups the search for its key visits, 1 when it sits
+ * in its home group.  The tables of `hashtable_tmpl.h` fill the same fields,
+ * counting slots instead of groups.
+ */
+typedef struct hash_table_stats {
+    size_t nelems;            /**< Elements held */
+    size_t nbuckets;          /**< Slots, of both arrays while rehashing */
+    size_t tombstones;        /**< Slots of deleted or migrated elements */
+    double load_factor;       /**< `nelems` over `nbuckets` */
+    size_t max_chain;         /**< Longest chain */
+    double mean_chain;        /**< Mean chain over the elements */
+    /** Elements by chain length 1, 2, ..., the last one counts longer ones */
+    size_t histogram[HT_HISTOGRAM_SIZE];
+    unsigned long lookups;    /**< Key searches, insertions and deletions too */
+    unsigned long probes;     /**< Groups visited by those searches */
+    unsigned long compares;   /**< Keys compared by those searches */
+} HashTableStats;
+
 /**
  * @brief Creates a new hash table with the specified number of buckets and hash
  * function.
  *
- * Allocates memory for a new hash table with the given number of buckets.
- * The actual number of buckets used may _slightly differ_, as it will be 
- * adjusted to the nearest greater prime number.  The hash table will use the 
- * provided hash function for hashing keys.  The signature has to match the 
- * `HashFuntion` type.  
+ * Allocates memory for a new hash table able to hold `nbuckets` elements
+ * before growing.  The actual number of slots allocated is the smallest power
+ * of two, at least 16, that keeps `nbuckets` elements under the maximum load
+ * factor of 7/8.  The hash table will use the provided hash function for
+ * hashing keys.  The signature has to match the `HashFuntion` type.
+ *
+ * Every block of memory the table needs, the table itself included, comes
+ * from the allocator `mem`, or from `malloc()` if it is `NULL`.  Passing an
+ * arena lets the client release a whole table at once.
  *
  * If the memory allocation fails, the function sets `errno` to `ENOMEM` and
  * outputs the interpreted error message to `stderr`. If the `nbuckets` argument
  * passed is zero or the hash function pointer (`fp`) passed is NULL, `errno` is
  * set to `EINVAL`, and the function returns `NULL`.
  *
- * @param nbuckets The number of buckets to allocate for the hash table.  An
- *                 unsigned integer greater than zero.
+ * @param nbuckets The number of elements to allocate room for.  An unsigned
+ *                 integer greater than zero.
  *
  * @param fp       The hash function used for hashing keys.  The function's type
  *                 has to be explicitly `HashFunction`.
  *
+ * @param mem      The allocator the table draws from, or `NULL` for the heap.
+ *                 It is copied, and has to outlive the table.
+ *
  * @return A pointer to the newly created HashTableADT structure if successful,
  *         or `NULL` on failure.
  */
 HashTableADT *
-cadthashtable_new(size_t nbuckets, HashFunction *fp);
+cadthashtable_new(size_t nbuckets, HashFunction *fp, const Allocator *mem);
 
 /**
  * @brief Deallocates a `HashTableADT` object.
@@ -82,8 +116,10 @@ cadthashtable_destroy(HashTableADT *ht);
  * If the specified key already exists in the hash table, the function sets
  * errno to `EEXIST` and returns `NULL` without modifying the hash table. 
  *
- * If memory allocation fails during the insertion process, the function outputs
- * an error message to `stderr`, sets `errno` to `ENOMEM` and returns `NULL`.
+ * The table grows by doubling its slots once the maximum load factor is
+ * reached, moving the elements over the following insertions.  If memory
+ * allocation fails during the insertion process, the function outputs an error
+ * message to `stderr`, sets `errno` to `ENOMEM` and returns `NULL`.
  *
  * @param ht      Pointer to the `HashTableADT` object.
  * @param key     Pointer to the key to be inserted into the hash table.
@@ -162,6 +198,22 @@ cadthashtable_lookup(HashTableADT *ht, const void *key, size_t key_size);
 void *
 cadthashtable_delete(HashTableADT *ht, void *key, size_t key_size, void *e);
 
+/**
+ * @brief Fills `stats` with the shape of the table and its search counters.
+ *
+ * The shape is measured walking every slot, so it is costly on a large table.
+ * The counters add up since the creation of the table.  Searches running on
+ * other threads are counted, though a few of their increments may be lost.
+ *
+ * If the `ht` pointer is `NULL`, `stats` is zeroed and `errno` is set to
+ * `EINVAL`.
+ *
+ * @param ht    Pointer to the `HashTableADT` object.
+ * @param stats Where the statistics are stored.
+ */
+void
+cadthashtable_stats(HashTableADT *ht, HashTableStats *stats);
+
 #endif
 
 /**
@@ -187,14 +239,19 @@ cadthashtable_delete(HashTableADT *ht, void *key, size_t key_size, void *e);
  *  + Relies on `void` pointers to allow manipulating elements of any type. See 
  *    @ref data_types.h.
  *  + Uses `errno` to manage errors.
- *  + Dynamically allocated, fixed size. 
+ *  + Open addressing: a flat array of slots probed in groups of 16, with one
+ *    control byte per slot holding 7 bits of the hash of its key.  A group is
+ *    matched with a single SSE2 compare, or a scalar loop without SSE2.
+ *  + Keys are copied back to back into blocks that never move.
+ *  + Dynamically allocated, grows by doubling at a load factor of 7/8.  The
+ *    rehash is incremental: each insertion migrates a few slots of the old
+ *    array, and lookups search both arrays until it is done.
+ *  + The allocator is pluggable.
  *
  * ### Considerations
  *  + Clients are responsible for managing the memory space of the objects 
  *    loaded to the structure.  
  *  + No type safety.
- *
- * ### Future Improvements
- *  + Implement resizing according to load factor.
+ *  + The copies of deleted keys are only released along with the table.
  *
  */
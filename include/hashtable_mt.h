@@ -0,0 +1,75 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Thread-safe hash table module interface.
+ *
+ * `HashTableADT` checks for a duplicate and then inserts, so two threads
+ * adding the same label could both succeed.  `HashTableMT` is the variant for
+ * tables filled by several threads at once, say pass one run in parallel over
+ * chunks or files:
+ *
+ *  + Lookups take no lock.  An element becomes visible by publishing its key
+ *    pointer with a release store, after everything else in its slot is set.
+ *  + Insertions lock one of `HT_MT_STRIPES` stripes, picked by the high bits
+ *    of the hash, so threads inserting different keys rarely wait on each
+ *    other.  The duplicate check runs under the same lock as the insertion,
+ *    so for any key exactly one `cadthashtable_mt_insert()` succeeds and every
+ *    other one fails with `EEXIST`, as `symbol_table_add_entry()` expects.
+ *
+ * A stripe grows by building a larger array aside and publishing it.  Readers
+ * may still be walking the old one, so it is kept until the table is
+ * destroyed: at most as much memory again as the live arrays.
+ *
+ * There is no deletion, labels are never removed.  Keys are copied, as in
+ * `HashTableADT`, and hashed by a client `HashFunction`.
+ */
+#ifndef HASHTABLE_MT_H
+#define HASHTABLE_MT_H
+
+#include <stddef.h>
+
+#include "hashtable_adt.h"
+
+#define HT_MT_STRIPES 64        /* Power of two */
+
+typedef struct hash_table_mt_type HashTableMT;
+
+/*
+ * Create a table with room for `nbuckets` elements before any stripe grows,
+ * hashing keys with `fp`.  Returns `NULL` setting `errno` to `EINVAL` if
+ * `nbuckets` is zero or `fp` is `NULL`, or to `ENOMEM`.
+ */
+HashTableMT *
+cadthashtable_mt_new(size_t nbuckets, HashFunction *fp);
+
+/*
+ * Deallocate the table.  No other thread may be using it.  Does nothing on a
+ * NULL table.
+ */
+void
+cadthashtable_mt_destroy(HashTableMT *ht);
+
+/*
+ * Adds the `key_size` bytes `key` paired with `e`, and returns `e`.  Returns
+ * `NULL` setting `errno` to `EEXIST` if the key is already in the table, to
+ * `EINVAL` on a NULL or empty argument, or to `ENOMEM`.  Safe to call from
+ * any number of threads.
+ */
+void *
+cadthashtable_mt_insert(HashTableMT *ht, const void *key, size_t key_size,
+                        void *e);
+
+/*
+ * Returns the element paired with `key`, or `NULL` if none is.  Never blocks,
+ * and is safe to call while other threads insert.
+ */
+void *
+cadthashtable_mt_lookup(HashTableMT *ht, const void *key, size_t key_size);
+
+/*
+ * Number of elements in the table.  Exact once the inserting threads are done.
+ */
+size_t
+cadthashtable_mt_count(HashTableMT *ht);
+
+#endif /* HASHTABLE_MT_H */
@@ -0,0 +1,327 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Type-specialized hash table template.
+ *
+ * `HashTableADT` is generic at run time: keys are byte regions, items are
+ * `void *` and the hash is called through a pointer, so nothing can be
+ * inlined.  `DEFINE_HASHTABLE(name, key_t, val_t, hash, eq)` generates a table
+ * specialized at compile time instead, for clients on a hot path:
+ *
+ *  + `hash(key)` returns a `size_t` and `eq(a, b)` whether two keys are equal.
+ *    Both are expanded in place, as functions or macros, never called through
+ *    a pointer.
+ *  + Values are stored inline in the slots, `name_find()` returns a pointer
+ *    into the slot, not to a separate allocation.
+ *  + Keys are stored as they are, `key_t` copied by assignment.  A key that
+ *    points to memory, a string for instance, has to outlive the table.
+ *
+ * The slots are linearly probed, each keeps the hash of its key, so probing
+ * past another key mostly costs an integer compare.  Zero marks an empty slot,
+ * stored hashes have their top bit set.  There is no deletion.  At a load of
+ * 3/4, new elements go to twice as many slots, and every insertion moves
+ * `HT_TMPL_MIGRATE_STEP` old slots across, leaving a tombstone behind, as
+ * `HashTableADT` does.  Until the old slots are empty both arrays are
+ * searched.  Moving elements invalidates the pointers `name_find()` and
+ * `name_insert()` returned, so they are only good until the next insertion.
+ *
+ * The slots come from the `Allocator` given to `name_init()`, or from
+ * `malloc()` if it is `NULL`.  With an arena, the old slots are not reclaimed
+ * before the arena is destroyed.
+ *
+ * For instance, `DEFINE_HASHTABLE(Ports, int, uint16_t, hash_int, eq_int)`
+ * defines the type `Ports` and:
+ *
+ * `bool Ports_init(Ports *t, size_t n, const Allocator *mem)`, room for `n`
+ *     elements before growing, slots drawn from `mem`.  The allocator is
+ *     copied, and has to outlive the table.
+ * `uint16_t *Ports_find(Ports *t, int key)`, `NULL` if missing.
+ * `uint16_t *Ports_insert(Ports *t, int key, uint16_t val)`, `NULL` setting
+ *     `errno` to `EEXIST` if `key` is in, or to `ENOMEM`.
+ * `void Ports_stats(const Ports *t, HashTableStats *stats)`, chains counted
+ *     in slots probed.
+ * `void Ports_destroy(Ports *t)`.
+ *
+ * Lookups only read the slots, several threads can run them at once as long
+ * as none inserts.  Their counters are bumped as `HashTableADT` does.
+ */
+#ifndef HASHTABLE_TMPL_H
+#define HASHTABLE_TMPL_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashtable_adt.h"
+
+#define HT_TMPL_MIN_CAPACITY 16
+#define HT_TMPL_MIGRATE_STEP 64             /* Old slots moved per insertion */
+#define HT_TMPL_FULL (~(~(size_t)0 >> 1))  /* Set in every stored hash */
+#define HT_TMPL_MOVED ((size_t)1)           /* Hash of a migrated old slot */
+
+#define HT_TMPL_COUNT(counter, n) \
+    __atomic_store_n(&(counter), \
+                     __atomic_load_n(&(counter), __ATOMIC_RELAXED) + (n), \
+                     __ATOMIC_RELAXED)
+
+static inline void *
+ht_tmpl_heap_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+static inline void
+ht_tmpl_heap_release(void *ctx, void *ptr)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+#define DEFINE_HASHTABLE(name, key_t, val_t, hash, eq)                        \
+                                                                              \
+typedef struct name##_slot {                                                  \
+    size_t hash;                /* Zero while empty */                        \
+    key_t key;                                                                \
+    val_t val;                                                                \
+} name##_slot;                                                                \
+                                                                              \
+typedef struct name {                                                         \
+    Allocator mem;              /* Where the slots come from */               \
+    name##_slot *slots;         /* Slots new elements go to */                \
+    size_t mask;                /* Number of slots minus one */               \
+    name##_slot *old;           /* Slots being migrated, `NULL` if none */    \
+    size_t old_mask;                                                          \
+    size_t migrated;            /* Old slots migrated so far */               \
+    size_t count;               /* Elements in both arrays */                 \
+    unsigned long lookups, probes, compares;                                  \
+} name;                                                                       \
+                                                                              \
+static inline size_t                                                          \
+name##_hash(key_t key)                                                        \
+{                                                                             \
+    uint64_t h = (uint64_t)(hash(key)) * 0x9E3779B97F4A7C15ULL;               \
+                                                                              \
+    return (size_t)(h ^ h >> 32) | HT_TMPL_FULL;                              \
+}                                                                             \
+                                                                              \
+static inline name##_slot *                                                   \
+name##_alloc_slots(name *t, size_t capacity)                                  \
+{                                                                             \
+    name##_slot *slots;                                                       \
+                                                                              \
+    if ((slots = t->mem.alloc(t->mem.ctx,                                     \
+                              capacity * sizeof(name##_slot))) != NULL) {     \
+        memset(slots, 0, capacity * sizeof(name##_slot));                     \
+    }                                                                         \
+    return slots;                                                             \
+}                                                                             \
+                                                                              \
+static inline bool                                                            \
+name##_init(name *t, size_t n, const Allocator *mem)                          \
+{                                                                             \
+    static const Allocator heap = {ht_tmpl_heap_alloc, ht_tmpl_heap_release,  \
+                                   NULL};                                     \
+    size_t capacity;                                                          \
+                                                                              \
+    for (capacity = HT_TMPL_MIN_CAPACITY; capacity / 4 * 3 < n;               \
+         capacity *= 2)                                                       \
+        ;                                                                     \
+    memset(t, 0, sizeof(name));                                               \
+    t->mem = mem != NULL ? *mem : heap;                                       \
+    if ((t->slots = name##_alloc_slots(t, capacity)) == NULL) {               \
+        errno = ENOMEM;                                                       \
+        return false;                                                         \
+    }                                                                         \
+    t->mask = capacity - 1;                                                   \
+    return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline void                                                            \
+name##_destroy(name *t)                                                       \
+{                                                                             \
+    if (t->old != NULL) {                                                     \
+        t->mem.release(t->mem.ctx, t->old);                                   \
+        t->old = NULL;                                                        \
+    }                                                                         \
+    if (t->slots != NULL) {                                                   \
+        t->mem.release(t->mem.ctx, t->slots);                                 \
+        t->slots = NULL;                                                      \
+    }                                                                         \
+}                                                                             \
+                                                                              \
+/* The slot of `slots` holding `key`, `NULL` if the probe reaches an empty */ \
+static inline name##_slot *                                                   \
+name##_probe(name##_slot *slots, size_t mask, key_t key, size_t h,            \
+             unsigned long *probes, unsigned long *compares)                  \
+{                                                                             \
+    name##_slot *s;                                                           \
+    size_t i;                                                                 \
+                                                                              \
+    for (i = h & mask; ; i = (i + 1) & mask) {                                \
+        s = &slots[i];                                                        \
+        ++*probes;                                                            \
+        if (s->hash == 0) {                                                   \
+            return NULL;                                                      \
+        }                                                                     \
+        if (s->hash == h) {                                                   \
+            ++*compares;                                                      \
+            if (eq(s->key, key)) {                                            \
+                return s;                                                     \
+            }                                                                 \
+        }                                                                     \
+    }                                                                         \
+}                                                                             \
+                                                                              \
+/* Searches the new slots, then the old ones */                               \
+static inline name##_slot *                                                   \
+name##_lookup(name *t, key_t key, size_t h)                                   \
+{                                                                             \
+    unsigned long probes = 0, compares = 0;                                   \
+    name##_slot *s;                                                           \
+                                                                              \
+    s = name##_probe(t->slots, t->mask, key, h, &probes, &compares);          \
+    if (s == NULL && t->old != NULL) {                                        \
+        s = name##_probe(t->old, t->old_mask, key, h, &probes, &compares);    \
+    }                                                                         \
+    HT_TMPL_COUNT(t->lookups, 1);                                             \
+    HT_TMPL_COUNT(t->probes, probes);                                         \
+    HT_TMPL_COUNT(t->compares, compares);                                     \
+    return s;                                                                 \
+}                                                                             \
+                                                                              \
+static inline val_t *                                                         \
+name##_find(name *t, key_t key)                                               \
+{                                                                             \
+    name##_slot *s = name##_lookup(t, key, name##_hash(key));                 \
+                                                                              \
+    return s != NULL ? &s->val : NULL;                                        \
+}                                                                             \
+                                                                              \
+/* First empty slot probing from `h`, new slots never hold tombstones */      \
+static inline name##_slot *                                                   \
+name##_place(name *t, size_t h)                                               \
+{                                                                             \
+    size_t i;                                                                 \
+                                                                              \
+    for (i = h & t->mask; t->slots[i].hash != 0; i = (i + 1) & t->mask)       \
+        ;                                                                     \
+    return &t->slots[i];                                                      \
+}                                                                             \
+                                                                              \
+/* Moves the next `n` old slots into the new ones, releasing the old slots */ \
+/* once they are all migrated */                                              \
+static inline void                                                            \
+name##_migrate(name *t, size_t n)                                             \
+{                                                                             \
+    name##_slot *s;                                                           \
+    size_t end;                                                               \
+                                                                              \
+    if (t->old == NULL) {                                                     \
+        return;                                                               \
+    }                                                                         \
+    end = t->migrated + n > t->old_mask ? t->old_mask + 1 : t->migrated + n;  \
+    for ( ; t->migrated < end; t->migrated++) {                               \
+        s = &t->old[t->migrated];                                             \
+        if (s->hash != 0) {                                                   \
+            *name##_place(t, s->hash) = *s;                                   \
+            s->hash = HT_TMPL_MOVED;                                          \
+        }                                                                     \
+    }                                                                         \
+    if (t->migrated > t->old_mask) {                                          \
+        t->mem.release(t->mem.ctx, t->old);                                   \
+        t->old = NULL;                                                        \
+    }                                                                         \
+}                                                                             \
+                                                                              \
+/* Finishes the previous migration, and starts one into twice the slots */    \
+static inline bool                                                            \
+name##_grow(name *t)                                                          \
+{                                                                             \
+    name##_slot *slots;                                                       \
+                                                                              \
+    name##_migrate(t, t->old_mask + 1);                                       \
+    if ((slots = name##_alloc_slots(t, (t->mask + 1) * 2)) == NULL) {         \
+        return false;                                                         \
+    }                                                                         \
+    t->old = t->slots;                                                        \
+    t->old_mask = t->mask;                                                    \
+    t->migrated = 0;                                                          \
+    t->slots = slots;                                                         \
+    t->mask = t->mask * 2 + 1;                                                \
+    return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline val_t *                                                         \
+name##_insert(name *t, key_t key, val_t val)                                  \
+{                                                                             \
+    size_t h = name##_hash(key);                                              \
+    name##_slot *s;                                                           \
+                                                                              \
+    if (name##_lookup(t, key, h) != NULL) {                                   \
+        errno = EEXIST;                                                       \
+        return NULL;                                                          \
+    }                                                                         \
+    name##_migrate(t, HT_TMPL_MIGRATE_STEP);                                  \
+    if (t->count >= (t->mask + 1) / 4 * 3) {                                  \
+        if (!name##_grow(t)) {                                                \
+            errno = ENOMEM;                                                   \
+            return NULL;                                                      \
+        }                                                                     \
+        name##_migrate(t, HT_TMPL_MIGRATE_STEP);                              \
+    }                                                                         \
+    s = name##_place(t, h);                                                   \
+    s->hash = h;                                                              \
+    s->key = key;                                                             \
+    s->val = val;                                                             \
+    t->count++;                                                               \
+    return &s->val;                                                           \
+}                                                                             \
+                                                                              \
+static inline void                                                            \
+name##_array_stats(const name##_slot *slots, size_t mask,                     \
+                   HashTableStats *stats, size_t *total)                      \
+{                                                                             \
+    size_t i, length;                                                         \
+                                                                              \
+    for (i = 0; i <= mask; i++) {                                             \
+        if (slots[i].hash == HT_TMPL_MOVED) {                                 \
+            stats->tombstones++;                                              \
+        }                                                                     \
+        if (!(slots[i].hash & HT_TMPL_FULL)) {                                \
+            continue;                                                         \
+        }                                                                     \
+        length = ((i - slots[i].hash) & mask) + 1;                            \
+        *total += length;                                                     \
+        if (length > stats->max_chain) {                                      \
+            stats->max_chain = length;                                        \
+        }                                                                     \
+        if (length > HT_HISTOGRAM_SIZE) {                                     \
+            length = HT_HISTOGRAM_SIZE;                                       \
+        }                                                                     \
+        stats->histogram[length - 1]++;                                       \
+    }                                                                         \
+    stats->nbuckets += mask + 1;                                              \
+}                                                                             \
+                                                                              \
+static inline void                                                            \
+name##_stats(const name *t, HashTableStats *stats)                            \
+{                                                                             \
+    size_t total = 0;                                                         \
+                                                                              \
+    memset(stats, 0, sizeof(HashTableStats));                                 \
+    name##_array_stats(t->slots, t->mask, stats, &total);                     \
+    if (t->old != NULL) {                                                     \
+        name##_array_stats(t->old, t->old_mask, stats, &total);               \
+    }                                                                         \
+    stats->nelems = t->count;                                                 \
+    stats->load_factor = (double)t->count / (double)stats->nbuckets;          \
+    stats->mean_chain = t->count ? (double)total / (double)t->count : 0.0;    \
+    stats->lookups = __atomic_load_n(&t->lookups, __ATOMIC_RELAXED);          \
+    stats->probes = __atomic_load_n(&t->probes, __ATOMIC_RELAXED);            \
+    stats->compares = __atomic_load_n(&t->compares, __ATOMIC_RELAXED);        \
+}
+
+#endif /* HASHTABLE_TMPL_H */
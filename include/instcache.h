@@ -0,0 +1,65 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Instruction cache module interface.
+ *
+ * Generated Hack code repeats the same few C-instructions over and over: in
+ * `PongL.asm`, `M=D` shows up 3375 times and `A=A-1` 2309 times.  Instead of
+ * splitting and looking up their fields every time, the assembler keeps the
+ * encoded word of the C-instructions it has already seen, keyed by the text
+ * of the trimmed line.
+ *
+ * The cache is direct-mapped: a line hashes to a single slot, which holds the
+ * last line stored there.  Lines too long to be a valid C-instruction are
+ * never cached.  For instance, after storing `M=D` as 0xE308:
+ *
+ * `instcache_lookup(ic, "M=D", 3)` returns 0xE308, a hit.
+ * `instcache_lookup(ic, "D=M", 3)` returns `ERROR`, a miss.
+ *
+ * Every cache is an opaque `InstCache` object of its own, so every thread can
+ * have one.
+ */
+#ifndef INSTCACHE_H
+#define INSTCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/shared_defs.h"
+
+typedef struct instcache_type InstCache;
+
+/*
+ * Create an empty cache.  Returns `NULL` setting `errno` on failure.
+ */
+InstCache *
+instcache_init(void);
+
+/*
+ * Returns the word stored for the `len` bytes `line`, or the `ERROR` macro if
+ * it isn't cached.  Counts a hit or a miss.
+ */
+uint16_t
+instcache_lookup(InstCache *ic, const char *line, size_t len);
+
+/*
+ * Stores `word` as the encoding of the `len` bytes `line`, evicting whatever
+ * line shared its slot.
+ */
+void
+instcache_insert(InstCache *ic, const char *line, size_t len, uint16_t word);
+
+/*
+ * Stores the number of hits and misses counted so far in `hits` and `misses`.
+ */
+void
+instcache_stats(const InstCache *ic, unsigned long *hits,
+                unsigned long *misses);
+
+/*
+ * Deallocate the cache.  Does nothing on a NULL cache.
+ */
+void
+instcache_destroy(InstCache *ic);
+
+#endif /* INSTCACHE_H */
@@ -0,0 +1,93 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Instruction IR module interface.
+ *
+ * The first pass already reads every line of the input, so it also translates
+ * each A and C instruction into a compact intermediate representation.  The
+ * second pass then loops over these arrays instead of re-reading and
+ * re-tokenizing the file: labels are the only thing it still has to resolve.
+ *
+ * The representation is a structure of arrays, indexed by instruction number:
+ *
+ * + `kind` tells how to read the `operand` of the instruction.
+ * + `operand` holds either the final 16-bit word, for numeric A-instructions
+ *   and pre-encoded C-instructions, the ID of the symbol in the symbol table,
+ *   or the offset of the symbol in `names`.
+ * + `names` is a single buffer with the null-terminated symbols back to back.
+ *
+ * For instance, `@i`, `M=D`, `@7` and `@j` become, when `i` is interned as 23
+ * and `j` is not interned:
+ *
+ * kind:    `IR_ID`  `IR_WORD`  `IR_WORD`  `IR_SYMBOL`
+ * operand: 23       0xE308     0x0007     0
+ * names:   "j\0"
+ */
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+
+typedef enum {
+    IR_WORD,       /* Operand is the encoded instruction */
+    IR_SYMBOL,     /* Operand is an offset into `names`, resolved in pass two */
+    IR_ID          /* Operand is an interned symbol ID, resolved in pass two */
+} IrKind;
+
+/*
+ * The first four fields may be read directly by clients, the arrays are
+ * invalidated by the next call to an `ir_add_` function.  The
+ * remaining ones are private bookkeeping.
+ */
+typedef struct Ir {
+    uint8_t  *kind;             /* `IrKind` of each instruction */
+    uint32_t *operand;          /* Encoded word or offset into `names` */
+    char     *names;            /* Symbols referenced by A-instructions */
+    uint16_t  count;            /* Number of instructions */
+    size_t    capacity;         /* Instructions allocated */
+    size_t    names_size;       /* Bytes in use in `names` */
+    size_t    names_capacity;   /* Bytes allocated for `names` */
+} Ir;
+
+/*
+ * Create and initialize an empty IR.  Returns `NULL` setting `errno` on
+ * failure.
+ */
+Ir *
+ir_init(void);
+
+/*
+ * Appends an instruction whose encoded `word` is already known.  Sets `errno`
+ * on failure.
+ */
+void
+ir_add_word(Ir *ir, uint16_t word);
+
+/*
+ * Appends an A-instruction referencing `symbol`, which is copied.  Sets `errno`
+ * on failure.
+ */
+void
+ir_add_symbol(Ir *ir, const char *symbol);
+
+/*
+ * Appends an A-instruction referencing the symbol interned as `id`.  Sets
+ * `errno` on failure.
+ */
+void
+ir_add_id(Ir *ir, uint32_t id);
+
+/*
+ * Replaces the instruction at `index` with the encoded `word`, once its symbol
+ * is resolved.
+ */
+void
+ir_set_word(Ir *ir, uint16_t index, uint16_t word);
+
+/*
+ * Deallocate the IR.  Does nothing on a NULL IR.
+ */
+void
+ir_destroy(Ir *ir);
+
+#endif /* IR_H */
@@ -0,0 +1,48 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Line index module interface.
+ *
+ * Before parsing, the whole input is scanned once to locate the lines that
+ * hold a command.  Blank and comment lines are dropped from the index, and the
+ * remaining lines are trimmed of leading blanks, trailing blanks and trailing
+ * comments.  The parser then walks the index, it never looks at a skipped byte.
+ *
+ * The scan looks for three things: newlines, `//` starts, and the first
+ * non-blank byte of a line.  Generated code is mostly comments and
+ * indentation, so these searches are vectorized, 16 bytes at a time with SSE2
+ * or 32 bytes at a time with AVX2 when the CPU supports it.  The choice is
+ * made at runtime, with a scalar fallback for other architectures.
+ *
+ * For instance, the line `    D=M   // D = x` at offset 100 of the input, the
+ * 7th line of the file, is indexed as `{104, 3, 7}`.
+ */
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Line {
+    uint32_t offset;            /* Offset of the first byte of the command */
+    uint32_t length;            /* Length of the command, without trimmings */
+    uint32_t number;            /* Line number in the input, starting at 1 */
+} Line;
+
+/*
+ * Scans the `size` bytes at `text` and returns a dynamically allocated array
+ * of the lines that hold a command, in order, storing their count in `nlines`.
+ * The client is responsible for releasing the array.  Returns `NULL` setting
+ * `errno` on failure.
+ */
+Line *
+lineindex_build(const char *text, size_t size, size_t *nlines);
+
+/*
+ * Returns the name of the instruction set used by the scan: "avx2", "sse2" or
+ * "scalar".
+ */
+const char *
+lineindex_isa(void);
+
+#endif /* LINEINDEX_H */
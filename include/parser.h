@@ -7,16 +7,25 @@
  *
  * This module accesses the input code managing its fields and symbols.
  * 
- * Its implementation `parser.c` relies on a set of local variables that model
- * the status of the parsing process.  All operations over its variables are
- * abstracted away and accessed through these interface functions.  Strings
- * returned are null-terminated.
+ * Its implementation `parser.c` keeps the status of a parsing process in an
+ * opaque `Parser` object, created by `parser_init()` and passed to every other
+ * function.  All operations over its fields are abstracted away and accessed
+ * through these interface functions.  Separate parsers share no state, so
+ * they can run on separate threads.
+ *
+ * Instead of the `symbol()`, `dest()`, `comp()` and `jump()` routines of the
+ * book, which each rescan the line, `parser_command()` splits every field of
+ * the current command at once.
  */
 
 #ifndef PARSER_H
 #define PARSER_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/shared_defs.h"
 
 /*
  * This typedef'd enum serves as a bridge to ensure that both the main program
@@ -30,72 +39,88 @@ typedef enum {
 } CommandType;
 
 /*
- * Initializes the parser to read from the stream `filename`.
- * Returns `NULL` on failure.
+ * The current command split into its fields.  The `symbol` of an A or L
+ * instruction is null-terminated, so it can be handed to the symbol table.
  */
-void *
-parser_init(char *filename);
+typedef struct Command {
+    CommandType type;
+    Field symbol;           /* @Xxx or (Xxx), empty for a decimal */
+    uint16_t value;         /* Decimal of an A-instruction */
+    Field dest;             /* dest=comp;jump */
+    Field comp;
+    Field jump;
+} Command;
+
+typedef struct parser_type Parser;
 
 /*
- * Reads the next command from the input setting `errno` on error.
+ * Initializes the parser to read from the file `filename`, which is mapped into
+ * memory once for both passes.  The name "-" reads the standard input, which
+ * may be a pipe.  Returns `NULL` on failure.
  */
-void
-parser_advance(void);
+Parser *
+parser_init(char *filename);
 
 /*
- * Returns `false` if there are no more commands or if an error occurred while
- * reading the stream.
+ * Reads the next command from the input setting `errno` on error.  Blank and
+ * comment lines are skipped, and the command comes trimmed of indentation and
+ * trailing comments.
  */
-bool
-parser_has_more_commands(void);
+void
+parser_advance(Parser *ps);
 
 /*
- * Returns the type of the current command, as defined in the `CommandType`
- * enumeration.
+ * Returns `false` if the last call to `parser_advance()` reached the end of the
+ * input.
  */
-CommandType
-parser_get_command_type(void);
+bool
+parser_has_more_commands(Parser *ps);
 
 /*
- * Returns a pointer to the symbol or decimal of the current command @Xxx or
- * (Xxx).  Should be called strictly only on `A_COMMAND` or `L_COMMAND`.  
+ * Returns the text of the current command, trimmed of blanks and comments, and
+ * stores its length in `len`.  It is not null-terminated.
  */
 const char *
-parser_symbol(void);  
+parser_line(Parser *ps, size_t *len);
 
 /*
- * Returns a pointer to the `dest` field of the current C-instruction.  If the
- * field is empty returns a pointer to the empty string.  
- * Should be called strictly first on C_COMMAND.
+ * Lexes the current command into `cmd` in a single pass: classifies it, and
+ * splits its fields.  For an A-instruction either `symbol` is set, or `symbol`
+ * is empty and `value` holds the decimal.  For an L-instruction `symbol` holds
+ * the label.  For a C-instruction `dest`, `comp` and `jump` are set, `dest` and
+ * `jump` possibly empty.  Returns `false` setting `errno` to `EINVAL` if the
+ * command is malformed, or a decimal doesn't fit in 15 bits.
  */
-const char *
-parser_dest(void);   
+bool
+parser_command(Parser *ps, Command *cmd);
 
 /*
- * Returns a pointer to the `comp` field of the current C-instruction.  
- * Should be called strictly second on C_COMMAND. 
+ * Returns a new parser over `count` commands of the input of `ps`, skipping the
+ * `first` ones left, which can run on another thread.  It shares the input with
+ * `ps`, that must neither advance nor be destroyed while the slice is in use.
+ * Returns `NULL` setting `errno` on failure.
  */
-const char *
-parser_comp(void);
+Parser *
+parser_slice(Parser *ps, size_t first, size_t count);
 
 /*
- * Returns a pointer to the `jump` field of the current C-instruction.  If the
- * field is empty returns a pointer to the empty string.  
- * Should be called strictly third on C_COMMAND. 
+ * Returns the number of commands left in the input, blank and comment lines
+ * excluded.
  */
-const char *
-parser_jump(void);
+size_t
+parser_length(Parser *ps);
 
 /*
- * Repositions the parser at beginning of the file. 
+ * Repositions the parser at beginning of the file.  Sets `errno` on failure,
+ * `ESPIPE` if the input is not a regular file, `EPERM` on a slice.
  */
 void
-parser_rewind(void);
+parser_rewind(Parser *ps);
 
 /*
- * Releases memory and closes the stream associated with the parser.
+ * Releases the mapping, closes the file and deallocates the parser `ps`.
  */
 void
-parser_destroy(void);
+parser_destroy(Parser *ps);
 
 #endif /* PARSER_H */
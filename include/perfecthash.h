@@ -0,0 +1,69 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Minimal perfect hash module interface.
+ *
+ * Once the first pass is over, every label is known and the set of names
+ * interned so far never changes again.  A minimal perfect hash maps such a
+ * fixed set of `n` keys onto the indexes from 0 to `n - 1`, one each, without
+ * collisions: a lookup computes an index and checks a single slot, there is no
+ * probing nor chain to walk.
+ *
+ * It is built in the style of CHD, "hash, displace and compress" by
+ * Belazzougui, Botelho and Dietzfelbinger.  Keys are spread over buckets of
+ * about `PH_BUCKET_SIZE` each, and the buckets are placed largest first: every
+ * one searches for a displacement `(d0, d1)` that sends all its keys to free
+ * indexes,
+ *
+ *     index = (f1 + d0 * f2 + d1) mod n
+ *
+ * with `f1` and `f2` derived from the hash of the key.  A lookup reads the
+ * displacement of its bucket, a table of 2 bytes per key, then computes the
+ * index.
+ *
+ * The module never sees the keys themselves, only their hashes, computed once
+ * by the client: `hash_wyhash()` for instance.  Any value maps to some index,
+ * so the client keeps the key at its index and compares it, to tell members of
+ * the set from anything else.
+ *
+ * A perfect hash lives in an opaque `PerfectHash` object, read-only once
+ * built: any number of threads can look it up at once.
+ */
+#ifndef PERFECTHASH_H
+#define PERFECTHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PH_BUCKET_SIZE 4            /* Mean keys per bucket */
+
+typedef struct perfect_hash_type PerfectHash;
+
+/*
+ * Builds the perfect hash of the `n` distinct key hashes in `hashes`.  Returns
+ * `NULL` setting `errno` to `EINVAL` if `n` is zero or two hashes are equal,
+ * or to `ENOMEM`.
+ */
+PerfectHash *
+perfecthash_build(const size_t *hashes, uint32_t n);
+
+/*
+ * The index of the key whose hash is `hash`, below the number of keys.  Only
+ * meaningful for the keys the perfect hash was built of.
+ */
+uint32_t
+perfecthash_index(const PerfectHash *ph, size_t hash);
+
+/*
+ * Bytes taken by the perfect hash.
+ */
+size_t
+perfecthash_size(const PerfectHash *ph);
+
+/*
+ * Deallocate the perfect hash.  Does nothing on a NULL object.
+ */
+void
+perfecthash_destroy(PerfectHash *ph);
+
+#endif /* PERFECTHASH_H */
@@ -16,11 +16,45 @@
  * and more enjoyable to read, but it might be somewhat challenging to
  * comprehend.
  *
- * In `symboltable.c`, a Hash Table ADT is allocated, in which the predefined
- * symbols are "loaded" at initialization.  When a "new" symbol-address pair
- * arrives, it is first stored in an array of `SymbolAddressPairs` before being
- * added to the hash table, which only maintains pointers.  
- * Both `contains()` and `get_addr()` are simple lookup operations.
+ * In `symboltable.c`, a hash table specialized by `DEFINE_HASHTABLE()` is
+ * allocated for the symbols of the program: names are hashed and compared
+ * inline, and IDs are stored in the slots.  The predefined symbols never enter
+ * it: a matcher generated at build time out of `common/predefined.h` resolves
+ * them first, switching on their length and bytes, so initialization inserts
+ * nothing.  Symbols are interned: the first time one is seen it gets a dense
+ * integer ID, and the hash table maps its name to the ID.  The predefined ones
+ * own the first IDs.  Addresses live in a flat array indexed by ID, so a client
+ * that kept the ID of a symbol resolves it with a single load, without hashing
+ * the name again.  For instance, right after initialization:
+ *
+ * `symbol_table_intern(st, "LOOP")` returns 23, after the predefined symbols.
+ * `symbol_table_address(st, 23)` returns `ERROR`, until
+ * `symbol_table_bind(st, 23, 0x0010, SYMBOL_LABEL)` binds it.
+ *
+ * Once the first pass is over every label is known, and the second pass only
+ * adds variables.  `symbol_table_freeze()` then compacts the symbols interned
+ * so far into a minimal perfect hash, built at run time by `perfecthash.c`:
+ * their names are copied to a single blob, and each one keeps a 16 bytes slot
+ * with its ID, address and a tag of its hash.  A lookup hashes the name, reads
+ * the displacement of its bucket and the slot, and compares the name in the
+ * blob only if the tag matches.  It never walks a probe sequence.  The hash
+ * table starts over empty, as a small side table for the variables added
+ * afterwards.
+ *
+ * Generated code uses a handful of symbols over and over, in long runs: the
+ * return labels of calls, the variables of a loop.  A direct-mapped cache of
+ * `HOT_ENTRIES` entries, picked by the length and the last bytes of a name,
+ * keeps the ID of the last symbol interned at each, so a repeat skips hashing
+ * altogether.  Predefined symbols, `SP` or `R13`, never reach it, the matcher
+ * resolves them as cheaply.  `symbol_table_cache_stats()` counts its hits, to
+ * size it.
+ *
+ * Names are copied to an arena, and the slots of the hash table are drawn
+ * from it, so destroying the symbol table releases them all at once.  Both `contains()` and `get_addr()` are simple lookup
+ * operations.
+ *
+ * The table and its array live in an opaque `SymbolTable` object, passed to
+ * every function, so separate assemblies keep separate tables.
  */
 #ifndef SYMBOLTABLE_H
 #define SYMBOLTABLE_H
@@ -28,37 +62,136 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "hashtable_adt.h"
+
+typedef struct symbol_table_type SymbolTable;
+
 /*
- * Create and initialize symbol table with predefined symbols. Sets `errno` on
- * failure.
+ * What a bound symbol names, for the symbol maps.  Labels are ROM addresses,
+ * the other two RAM addresses.
  */
-void 
+typedef enum SymbolKind {
+    SYMBOL_PREDEFINED,
+    SYMBOL_LABEL,
+    SYMBOL_VARIABLE
+} SymbolKind;
+
+/*
+ * Create and initialize symbol table with predefined symbols.  Returns `NULL`
+ * setting `errno` on failure.
+ */
+SymbolTable *
 symbol_table_init(void);
 
 /*
- * Adds the pair `symbol`-`addr` to the table.  Does not allows duplicates. Sets
- * `errno` on failure.  
+ * Adds the pair `symbol`-`addr` to the table, as a label.  Does not allows
+ * duplicates. Sets `errno` on failure.  
  */
 void 
-symbol_table_add_entry(const char *symbol, const uint16_t addr);
+symbol_table_add_entry(SymbolTable *st, const char *symbol,
+                       const uint16_t addr);
+
+/*
+ * Returns the ID of `symbol`, interning it unbound if it is new.  Returns
+ * `UINT32_MAX` setting `errno` on failure.
+ */
+uint32_t
+symbol_table_intern(SymbolTable *st, const char *symbol);
+
+/*
+ * Returns the address bound to `symbol`, or the `ERROR` macro while unbound,
+ * interning it if it is new.  Its ID is stored in `id`, `UINT32_MAX` setting
+ * `errno` on failure.  It stands for `symbol_table_contains()`,
+ * `symbol_table_get_addr()` and then `symbol_table_intern()`, hashing at most
+ * once.
+ */
+uint16_t
+symbol_table_lookup_or_insert(SymbolTable *st, const char *symbol,
+                              uint32_t *id);
+
+/*
+ * Binds the symbol `id` to `addr`, as a symbol of `kind`.  Sets `errno` if it
+ * is already bound.
+ */
+void
+symbol_table_bind(SymbolTable *st, uint32_t id, uint16_t addr, SymbolKind kind);
+
+/*
+ * Returns the address bound to the symbol `id`.  The `ERROR` macro if it isn't
+ * bound yet.
+ */
+uint16_t
+symbol_table_address(const SymbolTable *st, uint32_t id);
+
+/*
+ * Number of IDs handed out, predefined symbols included.  The IDs from zero up
+ * to it, excluded, are valid for the accessors below.
+ */
+uint32_t
+symbol_table_count(const SymbolTable *st);
 
 /*
- * Returns true if the table contains the given `symbol`.
+ * The name of the symbol `id`, valid until the table is destroyed.
+ */
+const char *
+symbol_table_name(const SymbolTable *st, uint32_t id);
+
+/*
+ * The kind the symbol `id` was bound as.  Meaningless while unbound.
+ */
+SymbolKind
+symbol_table_kind(const SymbolTable *st, uint32_t id);
+
+/*
+ * Returns true if the table binds an address to the given `symbol`.
  */
 bool 
-symbol_table_contains(const char *symbol);
+symbol_table_contains(SymbolTable *st, const char *symbol);
 
 /*
  * Returns the address associated with the string `symbol`.  The `ERROR` macro
- * if the symbol is not in the table.  
+ * if the symbol is not in the table.  Doesn't touch the hot cache, so several
+ * threads can look up at once, as long as none interns.
  */
 uint16_t 
-symbol_table_get_addr(const char *symbol);
+symbol_table_get_addr(SymbolTable *st, const char *symbol);
+
+/*
+ * Freezes the symbols interned so far into a read-only perfect hash, looked up
+ * before the hash table, which is emptied.  Symbols can still be interned and
+ * bound afterwards, into the hash table.  Freezing again rebuilds the perfect
+ * hash out of every symbol.  If the perfect hash can't be built, should two
+ * names hash alike, the table is left as it was.  Returns `false` setting
+ * `errno` on failure.
+ */
+bool
+symbol_table_freeze(SymbolTable *st);
+
+/*
+ * Number of symbols in the perfect hash, zero until frozen.
+ */
+uint32_t
+symbol_table_frozen(const SymbolTable *st);
+
+/*
+ * Stores the number of hits and misses of the hot cache in `hits` and
+ * `misses`.  Predefined symbols count as neither.
+ */
+void
+symbol_table_cache_stats(const SymbolTable *st, unsigned long *hits,
+                         unsigned long *misses);
+
+/*
+ * Fills `stats` with the shape and search counters of the underlying hash
+ * table.  Once frozen, those of the side table.
+ */
+void
+symbol_table_stats(SymbolTable *st, HashTableStats *stats);
 
 /*
- * Deallocate table.
+ * Deallocate table.  Does nothing on a NULL table.
  */
 void 
-symbol_table_destroy(void);
+symbol_table_destroy(SymbolTable *st);
 
 #endif /* SYMBOLTABLE_H */
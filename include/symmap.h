@@ -0,0 +1,99 @@
+/*
+ * Brief: Part of the Hack Assembler from Nand2Tetris.
+ *
+ * Symbol map module interface.
+ *
+ * Once a program is assembled, its symbol table knows the address of every
+ * label and variable.  This module writes them out before they are thrown
+ * away, so profilers and debuggers can map addresses back to names without
+ * running the assembler again.  Labels are ROM addresses, variables and
+ * predefined symbols RAM addresses.  Both outputs are sorted by address
+ * space, then address, then name:
+ *
+ *  + A text map, one symbol per line:
+ *
+ *        ROM 0000 label      sys.init
+ *        RAM 0000 predefined R0
+ *        RAM 0010 variable   i
+ *
+ *  + A binary snapshot, meant to be `mmap()`ed and binary searched as it is.
+ *    A `SymMapHeader` is followed by `count` `SymMapEntry`, then by the names,
+ *    null-terminated.  Integers are in host byte order: the snapshot is for the
+ *    machine that wrote it, `symmap_open()` rejects anything else.
+ *
+ * An open snapshot lives in an opaque `SymMap` object.
+ */
+#ifndef SYMMAP_H
+#define SYMMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "symboltable.h"
+
+#define SYMMAP_MAGIC "HSYM"
+#define SYMMAP_VERSION 1
+
+typedef enum SymMapSpace {
+    SYMMAP_ROM,
+    SYMMAP_RAM
+} SymMapSpace;
+
+typedef struct SymMapHeader {
+    char magic[4];                  /* `SYMMAP_MAGIC`, not null-terminated */
+    uint32_t version;               /* `SYMMAP_VERSION` */
+    uint32_t count;                 /* Entries */
+    uint32_t names;                 /* Offset of the names in the file */
+} SymMapHeader;
+
+typedef struct SymMapEntry {
+    uint16_t address;
+    uint8_t space;                  /* A `SymMapSpace` */
+    uint8_t kind;                   /* A `SymbolKind` */
+    uint32_t name;                  /* Offset of the name past `names` */
+} SymMapEntry;
+
+typedef struct symmap_type SymMap;
+
+/*
+ * Writes the text map of the symbols bound in `st` to `out`.  Returns `false`
+ * setting `errno` on failure.
+ */
+bool
+symmap_write_text(const SymbolTable *st, FILE *out);
+
+/*
+ * Writes the binary snapshot of the symbols bound in `st` to the file `path`.
+ * Returns `false` setting `errno` on failure.
+ */
+bool
+symmap_write_snapshot(const SymbolTable *st, const char *path);
+
+/*
+ * Maps the snapshot at `path` into memory.  Returns `NULL` setting `errno` on
+ * failure, `EINVAL` if the file is not a valid snapshot.
+ */
+SymMap *
+symmap_open(const char *path);
+
+/*
+ * Number of symbols in the snapshot.
+ */
+uint32_t
+symmap_count(const SymMap *map);
+
+/*
+ * The name of the first symbol, by name, bound to `address` in `space`, or
+ * `NULL` if there is none.  A binary search.
+ */
+const char *
+symmap_find(const SymMap *map, SymMapSpace space, uint16_t address);
+
+/*
+ * Unmaps the snapshot.  Does nothing on a NULL map.
+ */
+void
+symmap_close(SymMap *map);
+
+#endif /* SYMMAP_H */
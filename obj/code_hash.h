@@ -0,0 +1,105 @@
+/*
+ * Generated by tools/gencode.c from common/mnemonics.h, do not edit.
+ */
+#ifndef CODE_HASH_H
+#define CODE_HASH_H
+
+#define DEST_MULTIPLIER 0x7BEE45EFU
+#define DEST_SHIFT 29
+
+static const Slot DestSlots[8] = {
+    {0x00000000U, 0x0000},   /* "" */
+    {0x00004D41U, 0x0028},   /* "AM" */
+    {0x0000004DU, 0x0008},   /* "M" */
+    {0x00000041U, 0x0020},   /* "A" */
+    {0x0000444DU, 0x0018},   /* "MD" */
+    {0x00444D41U, 0x0038},   /* "AMD" */
+    {0x00004441U, 0x0030},   /* "AD" */
+    {0x00000044U, 0x0010},   /* "D" */
+};
+
+#define COMP_MULTIPLIER 0x45BDE379U
+#define COMP_SHIFT 26
+
+static const Slot CompSlots[64] = {
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0x00000030U, 0x0A80},   /* "0" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x00004D21U, 0x1C40},   /* "!M" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x004D2644U, 0x1000},   /* "D&M" */
+    {0x00312B41U, 0x0DC0},   /* "A+1" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x00412B44U, 0x0080},   /* "D+A" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x00004121U, 0x0C40},   /* "!A" */
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0x00417C44U, 0x0540},   /* "D|A" */
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0x004D2D44U, 0x14C0},   /* "D-M" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x00000031U, 0x0FC0},   /* "1" */
+    {0x00004D2DU, 0x1CC0},   /* "-M" */
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0x00312B4DU, 0x1DC0},   /* "M+1" */
+    {0x00004421U, 0x0340},   /* "!D" */
+    {0x00312D44U, 0x0380},   /* "D-1" */
+    {0x00412644U, 0x0000},   /* "D&A" */
+    {0x0000412DU, 0x0CC0},   /* "-A" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x00442D41U, 0x01C0},   /* "A-D" */
+    {0x00000044U, 0x0300},   /* "D" */
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0x0000312DU, 0x0E80},   /* "-1" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x00312D41U, 0x0C80},   /* "A-1" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x00412D44U, 0x04C0},   /* "D-A" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x0000442DU, 0x03C0},   /* "-D" */
+    {0x00000041U, 0x0C00},   /* "A" */
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0x00442D4DU, 0x11C0},   /* "M-D" */
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0x004D2B44U, 0x1080},   /* "D+M" */
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0xFFFFFFFFU, 0x8000},
+    {0x00312D4DU, 0x1C80},   /* "M-1" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x004D7C44U, 0x1540},   /* "D|M" */
+    {0xFFFFFFFFU, 0x8000},
+    {0x00312B44U, 0x07C0},   /* "D+1" */
+    {0x0000004DU, 0x1C00},   /* "M" */
+    {0xFFFFFFFFU, 0x8000},
+};
+
+#define JUMP_MULTIPLIER 0x41166B6DU
+#define JUMP_SHIFT 29
+
+static const Slot JumpSlots[8] = {
+    {0x00000000U, 0x0000},   /* "" */
+    {0x00504D4AU, 0x0007},   /* "JMP" */
+    {0x0054474AU, 0x0001},   /* "JGT" */
+    {0x00454C4AU, 0x0006},   /* "JLE" */
+    {0x00454E4AU, 0x0005},   /* "JNE" */
+    {0x00544C4AU, 0x0004},   /* "JLT" */
+    {0x0051454AU, 0x0002},   /* "JEQ" */
+    {0x0045474AU, 0x0003},   /* "JGE" */
+};
+
+#endif /* CODE_HASH_H */
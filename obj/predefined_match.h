@@ -0,0 +1,81 @@
+/*
+ * Generated by tools/gensymbols.c from common/predefined.h, do not edit.
+ */
+#ifndef PREDEFINED_MATCH_H
+#define PREDEFINED_MATCH_H
+
+/*
+ * Returns the index in `PredefinedSymbols` of the `len` bytes `s`, or
+ * `UINT32_MAX` if they aren't a predefined symbol.
+ */
+static inline uint32_t
+predefined_index(const char *s, size_t len)
+{
+    switch (len) {
+    case 2:
+        switch ((uint32_t)(uint8_t)s[0] << 8 | (uint8_t)s[1]) {
+        case 0x5230:   /* "R0" */
+            return 0;
+        case 0x5350:   /* "SP" */
+            return 1;
+        case 0x5231:   /* "R1" */
+            return 2;
+        case 0x5232:   /* "R2" */
+            return 4;
+        case 0x5233:   /* "R3" */
+            return 6;
+        case 0x5234:   /* "R4" */
+            return 8;
+        case 0x5235:   /* "R5" */
+            return 10;
+        case 0x5236:   /* "R6" */
+            return 11;
+        case 0x5237:   /* "R7" */
+            return 12;
+        case 0x5238:   /* "R8" */
+            return 13;
+        case 0x5239:   /* "R9" */
+            return 14;
+        }
+        break;
+    case 3:
+        switch ((uint32_t)(uint8_t)s[0] << 8 | (uint8_t)s[2]) {
+        case 0x4C4C:   /* "LCL" */
+            return memcmp(s + 1, "C", 1) == 0 ? 3 : UINT32_MAX;
+        case 0x4147:   /* "ARG" */
+            return memcmp(s + 1, "R", 1) == 0 ? 5 : UINT32_MAX;
+        case 0x5230:   /* "R10" */
+            return memcmp(s + 1, "1", 1) == 0 ? 15 : UINT32_MAX;
+        case 0x5231:   /* "R11" */
+            return memcmp(s + 1, "1", 1) == 0 ? 16 : UINT32_MAX;
+        case 0x5232:   /* "R12" */
+            return memcmp(s + 1, "1", 1) == 0 ? 17 : UINT32_MAX;
+        case 0x5233:   /* "R13" */
+            return memcmp(s + 1, "1", 1) == 0 ? 18 : UINT32_MAX;
+        case 0x5234:   /* "R14" */
+            return memcmp(s + 1, "1", 1) == 0 ? 19 : UINT32_MAX;
+        case 0x5235:   /* "R15" */
+            return memcmp(s + 1, "1", 1) == 0 ? 20 : UINT32_MAX;
+        case 0x4B44:   /* "KBD" */
+            return memcmp(s + 1, "B", 1) == 0 ? 22 : UINT32_MAX;
+        }
+        break;
+    case 4:
+        switch ((uint32_t)(uint8_t)s[0] << 8 | (uint8_t)s[3]) {
+        case 0x5453:   /* "THIS" */
+            return memcmp(s + 1, "HI", 2) == 0 ? 7 : UINT32_MAX;
+        case 0x5454:   /* "THAT" */
+            return memcmp(s + 1, "HA", 2) == 0 ? 9 : UINT32_MAX;
+        }
+        break;
+    case 6:
+        switch ((uint32_t)(uint8_t)s[0] << 8 | (uint8_t)s[5]) {
+        case 0x534E:   /* "SCREEN" */
+            return memcmp(s + 1, "CREE", 4) == 0 ? 21 : UINT32_MAX;
+        }
+        break;
+    }
+    return UINT32_MAX;
+}
+
+#endif /* PREDEFINED_MATCH_H */
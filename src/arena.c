@@ -0,0 +1,160 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+#define DEFAULT_BLOCK_SIZE (64 * 1024)
+
+#define ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+
+/*********************************************************** Data Definitions */
+
+/*
+ * Blocks are linked from the most recent one.  The memory handed out starts
+ * at `HEADER_SIZE` bytes past the block.
+ */
+typedef struct block {
+    struct block *next;             /* Previous block */
+    size_t size;                    /* Usable bytes */
+    size_t used;                    /* Bytes handed out */
+} Block;
+
+#define HEADER_SIZE ALIGN_UP(sizeof(Block))
+
+/*
+ * Datatype completion for `Arena`:
+ */
+struct arena_type {
+    Block *head;                    /* Block being bumped through */
+    size_t block_size;              /* Usable bytes of a new block */
+    size_t used;                    /* Bytes handed out, over every block */
+};
+
+
+/******************************************************* Private Declarations */
+
+static Block *new_block(size_t);
+static void *allocator_alloc(void *, size_t);
+static void allocator_release(void *, void *);
+
+
+/***************************************************** Public Implementations */
+
+Arena *
+arena_init(size_t block_size)
+{
+    Arena *arena;
+
+    if ((arena = calloc(1, sizeof(Arena))) == NULL) {
+        perror("arena_init calloc");
+        errno = ENOMEM;
+        return NULL;
+    }
+    arena->block_size = block_size ? ALIGN_UP(block_size) : DEFAULT_BLOCK_SIZE;
+    return arena;
+}
+
+/*
+ * Bumps through the head block.  A large request gets a block of its own,
+ * linked behind the head so that the head keeps serving small ones.
+ */
+void *
+arena_alloc(Arena *arena, size_t size)
+{
+    Block *b;
+
+    size = ALIGN_UP(size ? size : 1);
+
+    if (size > arena->block_size / 4) {
+        if ((b = new_block(size)) == NULL) {
+            return NULL;
+        }
+        if (arena->head != NULL) {
+            b->next = arena->head->next;
+            arena->head->next = b;
+        } else {
+            arena->head = b;
+        }
+    } else if (arena->head == NULL ||
+               arena->head->size - arena->head->used < size) {
+        if ((b = new_block(arena->block_size)) == NULL) {
+            return NULL;
+        }
+        b->next = arena->head;
+        arena->head = b;
+    } else {
+        b = arena->head;
+    }
+
+    b->used += size;
+    arena->used += size;
+    return (char *)b + HEADER_SIZE + b->used - size;
+}
+
+Allocator
+arena_allocator(Arena *arena)
+{
+    Allocator a = {allocator_alloc, allocator_release, arena};
+
+    return a;
+}
+
+size_t
+arena_used(const Arena *arena)
+{
+    return arena->used;
+}
+
+void
+arena_destroy(Arena *arena)
+{
+    Block *b, *next;
+
+    if (arena == NULL) {
+        return;
+    }
+    for (b = arena->head; b != NULL; b = next) {
+        next = b->next;
+        free(b);
+    }
+    free(arena);
+}
+
+
+/**************************************************** Private implementations */
+
+/*
+ * Allocates a block with `size` usable bytes.  Returns `NULL` setting `errno`
+ * on failure.
+ */
+static Block *
+new_block(size_t size)
+{
+    Block *b;
+
+    if ((b = malloc(HEADER_SIZE + size)) == NULL) {
+        perror("arena_alloc malloc");
+        errno = ENOMEM;
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+static void *
+allocator_alloc(void *ctx, size_t size)
+{
+    return arena_alloc(ctx, size);
+}
+
+static void
+allocator_release(void *ctx, void *ptr)
+{
+    (void)ctx;
+    (void)ptr;
+}
@@ -2,137 +2,93 @@
 #include <string.h>
 
 #include "code.h"
-
-#define MAX_SYMBOL_LEN 4        /* Max length of a mnemonic string */
+#include "common/mnemonics.h"
 
 
 /********************************************************** Data Declarations */
 
 /*
- * These arrays pair the most significant bits of a mnemonic field with its
- * corresponding string, as the tables in section 6.2.2
+ * A slot of the perfect hash tables, generated at build time from the tables
+ * of `common/mnemonics.h` into `code_hash.h`.  `bits` are already shifted into
+ * their position in the instruction.
  */
-static const SymbolAddressPair Destinations[] = {
-                   /* ddd */
-    {0x0,    ""},  /* 000 */
-    {0x1,   "M"},  /* 001 */
-    {0x2,   "D"},  /* 010 */
-    {0x3,  "MD"},  /* 011 */
-    {0x4,   "A"},  /* 100 */
-    {0x5,  "AM"},  /* 101 */
-    {0x6,  "AD"},  /* 110 */
-    {0x7, "AMD"},  /* 111 */
-};
-
-static const SymbolAddressPair Computations[] = {
-                     /* acc cccc */
-    {0x2A,     "0"}, /* 010 1010 */
-    {0x3F,     "1"}, /* 011 1111 */
-    {0x3A,    "-1"}, /* 011 1010 */
-    {0x0C,     "D"},                       /* adding 0x40 toggles the `a` bit */
-    {0x30,     "A"}, {0x30 + 0x40,  "M"},  /* 011 0000, 111 0000 */
-    {0x0D,    "!D"},
-    {0x31,    "!A"}, {0x31 + 0x40,  "!M"}, /* 011 0001, 111 0001 */
-    {0x0F,    "-D"},
-    {0x33,    "-A"}, {0x33 + 0x40,  "-M"},
-    {0x1F,   "D+1"},
-    {0x37,   "A+1"}, {0x37 + 0x40, "M+1"},
-    {0x0E,   "D-1"},
-    {0x32,   "A-1"}, {0x32 + 0x40, "M-1"},
-    {0x02,   "D+A"}, {0x02 + 0x40, "D+M"},
-    {0x13,   "D-A"}, {0x13 + 0x40, "D-M"},
-    {0x07,   "A-D"}, {0x07 + 0x40, "M-D"},
-    {0x00,   "D&A"}, {0x00 + 0x40, "D&M"},
-    {0x15,   "D|A"}, {0x15 + 0x40, "D|M"} 
-};
-
-static const SymbolAddressPair Jumps[] = {
-    {0x00,    ""},
-    {0x01, "JGT"},
-    {0x02, "JEQ"},
-    {0x03, "JGE"},
-    {0x04, "JLT"},
-    {0x05, "JNE"},
-    {0x06, "JLE"},
-    {0x07, "JMP"}
-};
-
-static const uint8_t DestSize  = ARRAY_SIZE(Destinations);
-static const uint8_t CompSize  = ARRAY_SIZE(Computations);
+typedef struct Slot {
+    uint32_t key;               /* See `mnemonic_key()` */
+    uint16_t bits;
+} Slot;
+
+#include "code_hash.h"
 
 
 /******************************************************* Private Declarations */
 
-static inline uint16_t lookup(const char *, const SymbolAddressPair [], 
-                              const uint8_t);
+static inline uint16_t lookup(uint32_t, const Slot [], uint32_t, unsigned);
 
 
 /***************************************************** Public Implementations */
 
-/*
- * If found, bit shifts the destination number and sets it in its proper
- * position then returns it.
- */
 uint16_t 
 code_dest(const char *mnemonic)
 {
-    uint16_t dest;
-
     assert(mnemonic != NULL);
-    dest = lookup(mnemonic, Destinations, DestSize);
-
-    if (dest == ERROR){
-        return ERROR;
-    }
-    return (uint16_t)(dest << 3);
+    return lookup(mnemonic_key(mnemonic, (uint32_t)strlen(mnemonic)),
+                  DestSlots, DEST_MULTIPLIER, DEST_SHIFT);
 }
 
-/*
- * If found, bit shifts the computation value then returns it.
- */
 uint16_t 
 code_comp(const char *mnemonic)
 {
-    uint16_t comp;
-
     assert(mnemonic != NULL);
-    comp = lookup(mnemonic, Computations, CompSize);
+    return lookup(mnemonic_key(mnemonic, (uint32_t)strlen(mnemonic)),
+                  CompSlots, COMP_MULTIPLIER, COMP_SHIFT);
+}
 
-    if (comp == ERROR){
-        return ERROR;
-    }
-    return (uint16_t)(comp << 6);
+uint16_t 
+code_jump(const char *mnemonic)
+{
+    assert(mnemonic != NULL);
+    return lookup(mnemonic_key(mnemonic, (uint32_t)strlen(mnemonic)),
+                  JumpSlots, JUMP_MULTIPLIER, JUMP_SHIFT);
 }
 
 /*
- * Returns the lookup result because no bit shift is needed, jump bits are LSBs.
+ * Looks the three fields up and ORs them together with the C-instruction
+ * prefix.  `ERROR` has none of the field bits set, so one test on the ORed
+ * result catches an invalid field.
  */
-uint16_t 
-code_jump(const char *mnemonic)
+uint16_t
+code_c_instruction(Field dest, Field comp, Field jump)
 {
+    uint16_t word;
 
-    assert(mnemonic != NULL);
-    return lookup(mnemonic, Jumps, CompSize);
+    word = lookup(mnemonic_key(dest.str, dest.len), DestSlots,
+                  DEST_MULTIPLIER, DEST_SHIFT);
+    word |= lookup(mnemonic_key(comp.str, comp.len), CompSlots,
+                   COMP_MULTIPLIER, COMP_SHIFT);
+    word |= lookup(mnemonic_key(jump.str, jump.len), JumpSlots,
+                   JUMP_MULTIPLIER, JUMP_SHIFT);
 
+    if (word & ERROR) {
+        return ERROR;
+    }
+    return (uint16_t)(0xE000 | word);
 }
 
 
 /**************************************************** Private implementations */
 
 /* 
- * The three routines of this module use this helper function which returns
- * either the corresponding code for a mnemonic in the array of pairs or the
- * `ERROR` macro.
+ * The routines of this module use this helper function, which returns either
+ * the code stored for `key` or the `ERROR` macro.  The key picks a single slot,
+ * the one holding it if any: a multiplication, a shift and a comparison.  The
+ * impossible key of an overlong mnemonic never matches, and empty slots hold
+ * `ERROR` anyway.
  */
 static inline uint16_t 
-lookup(const char *s, const SymbolAddressPair arr[], const uint8_t n)
+lookup(uint32_t key, const Slot slots[], uint32_t multiplier, unsigned shift)
 {
-    uint8_t i;
+    const Slot *slot;
 
-    for (i = 0; i < n; i++) {
-        if (strncmp(arr[i].symbol, s, MAX_SYMBOL_LEN) == 0) {
-            return arr[i].bits ;
-        }
-    }
-    return ERROR;
+    slot = &slots[(uint32_t)(key * multiplier) >> shift];
+    return slot->key == key ? slot->bits : ERROR;
 }
@@ -0,0 +1,353 @@
+#define _POSIX_C_SOURCE 200809L     /* write() */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "emitter.h"
+
+#define IHEX_RECORD 8               /* Words of a full data record */
+#define IHEX_WIDTH 16               /* Bytes of a record of a single word */
+
+
+/*********************************************************** Data Definitions */
+
+/*
+ * Datatype completion for `Emitter`:
+ */
+struct emitter_type {
+    int fd;
+    int error;                      /* `errno` of the first failed write */
+    EmitterFormat format;
+    uint32_t address;               /* Words formatted so far */
+    size_t len;                     /* Bytes buffered */
+    size_t npending;                /* Words not formatted yet */
+    uint16_t pending[EMITTER_BATCH];
+    char buffer[EMITTER_BUFFER_SIZE];
+};
+
+
+/*
+ * A formatter writes `n` words, the first at `address`, returning the bytes
+ * written.
+ */
+typedef size_t Formatter(uint32_t, const uint16_t *, size_t, char *);
+
+typedef struct format {
+    const char *name;
+    const char *extension;
+    size_t width;                   /* Most bytes a word takes */
+    const char *trailer;
+    Formatter *format;
+} Format;
+
+
+/******************************************************* Private Declarations */
+
+static Formatter format_hack, format_bin_le, format_bin_be, format_ihex,
+                 format_readmemh;
+static char *hex_byte(char *, unsigned);
+static void format_words(Emitter *, const uint16_t *, size_t);
+static void format_pending(Emitter *);
+static void append(Emitter *, const char *, size_t);
+static void write_out(Emitter *, const char *, size_t);
+
+
+/********************************************************** Data declarations */
+
+static const Format Formats[EMITTER_FORMATS] = {
+    [EMITTER_HACK] = {"hack", ".hack", HACKTEXT_LINE, "", format_hack},
+    [EMITTER_BIN_LE] = {"bin", ".bin", 2, "", format_bin_le},
+    [EMITTER_BIN_BE] = {"binbe", ".be.bin", 2, "", format_bin_be},
+    [EMITTER_IHEX] = {"ihex", ".hex", IHEX_WIDTH, ":00000001FF\n",
+                      format_ihex},
+    [EMITTER_READMEMH] = {"readmemh", ".mem", 5, "", format_readmemh},
+};
+
+static const char Hex[] = "0123456789ABCDEF";
+
+
+/***************************************************** Public Implementations */
+
+Emitter *
+emitter_init(int fd, EmitterFormat format)
+{
+    Emitter *em;
+
+    if ((em = malloc(sizeof(Emitter))) == NULL) {
+        perror("emitter_init malloc");
+        errno = ENOMEM;
+        return NULL;
+    }
+    em->fd = fd;
+    em->error = 0;
+    em->format = format;
+    em->address = 0;
+    em->len = 0;
+    em->npending = 0;
+    return em;
+}
+
+void
+emitter_word(Emitter *em, uint16_t word)
+{
+    em->pending[em->npending++] = word;
+    if (em->npending == EMITTER_BATCH) {
+        format_pending(em);
+    }
+}
+
+/*
+ * Tops up the pending words, then formats whole batches, as many as fit in the
+ * room left, writes the buffer out, and so on.  The last words are left
+ * pending.  So the output doesn't depend on how the words were split between
+ * calls.
+ */
+void
+emitter_words(Emitter *em, const uint16_t *words, size_t n)
+{
+    size_t room;
+
+    while (em->npending > 0 && n > 0) {
+        emitter_word(em, *words++);
+        n--;
+    }
+    while (n >= EMITTER_BATCH) {
+        room = (EMITTER_BUFFER_SIZE - em->len) / Formats[em->format].width;
+        room -= room % EMITTER_BATCH;
+        if (room == 0) {
+            write_out(em, em->buffer, em->len);
+            em->len = 0;
+            continue;
+        }
+        room = room < n ? room : n - n % EMITTER_BATCH;
+        format_words(em, words, room);
+        words += room;
+        n -= room;
+    }
+    while (n > 0) {
+        emitter_word(em, *words++);
+        n--;
+    }
+}
+
+bool
+emitter_finish(Emitter *em)
+{
+    const char *trailer = Formats[em->format].trailer;
+
+    format_pending(em);
+    append(em, trailer, strlen(trailer));
+    return emitter_flush(em);
+}
+
+bool
+emitter_flush(Emitter *em)
+{
+    format_pending(em);
+    write_out(em, em->buffer, em->len);
+    em->len = 0;
+    if (em->error != 0) {
+        errno = em->error;
+        return false;
+    }
+    return true;
+}
+
+void
+emitter_destroy(Emitter *em)
+{
+    free(em);
+}
+
+EmitterFormat
+emitter_format(const char *name)
+{
+    int i;
+
+    for (i = 0; i < EMITTER_FORMATS; i++) {
+        if (strcmp(name, Formats[i].name) == 0) {
+            return (EmitterFormat)i;
+        }
+    }
+    return EMITTER_FORMATS;
+}
+
+const char *
+emitter_format_name(EmitterFormat format)
+{
+    return Formats[format].name;
+}
+
+const char *
+emitter_format_extension(EmitterFormat format)
+{
+    return Formats[format].extension;
+}
+
+
+/**************************************************** Private implementations */
+
+static size_t
+format_hack(uint32_t address, const uint16_t *words, size_t n, char *out)
+{
+    (void) address;
+
+    hacktext_format(words, n, out);
+    return n * HACKTEXT_LINE;
+}
+
+static size_t
+format_bin_le(uint32_t address, const uint16_t *words, size_t n, char *out)
+{
+    size_t i;
+
+    (void) address;
+
+    for (i = 0; i < n; i++) {
+        out[2 * i] = (char)(words[i] & 0xFF);
+        out[2 * i + 1] = (char)(words[i] >> 8);
+    }
+    return 2 * n;
+}
+
+static size_t
+format_bin_be(uint32_t address, const uint16_t *words, size_t n, char *out)
+{
+    size_t i;
+
+    (void) address;
+
+    for (i = 0; i < n; i++) {
+        out[2 * i] = (char)(words[i] >> 8);
+        out[2 * i + 1] = (char)(words[i] & 0xFF);
+    }
+    return 2 * n;
+}
+
+/*
+ * Records start at multiples of `IHEX_RECORD` words, however the words are
+ * batched, so the image doesn't depend on when the buffer was flushed.  The
+ * checksum is the two's complement of the sum of the bytes of the record.
+ */
+static size_t
+format_ihex(uint32_t address, const uint16_t *words, size_t n, char *out)
+{
+    char *p = out;
+    unsigned sum, offset;
+    size_t run, i;
+
+    while (n > 0) {
+        run = IHEX_RECORD - address % IHEX_RECORD;
+        run = run < n ? run : n;
+        offset = (unsigned)(address * 2) & 0xFFFF;
+        sum = (unsigned)run * 2 + (offset >> 8) + (offset & 0xFF);
+        *p++ = ':';
+        p = hex_byte(p, (unsigned)run * 2);
+        p = hex_byte(p, offset >> 8);
+        p = hex_byte(p, offset & 0xFF);
+        p = hex_byte(p, 0x00);      /* Data record */
+        for (i = 0; i < run; i++) {
+            sum += (unsigned)(words[i] >> 8) + (words[i] & 0xFFu);
+            p = hex_byte(p, (unsigned)words[i] >> 8);
+            p = hex_byte(p, words[i] & 0xFFu);
+        }
+        p = hex_byte(p, (0x100 - (sum & 0xFF)) & 0xFF);
+        *p++ = '\n';
+        address += (uint32_t)run;
+        words += run;
+        n -= run;
+    }
+    return (size_t)(p - out);
+}
+
+static size_t
+format_readmemh(uint32_t address, const uint16_t *words, size_t n, char *out)
+{
+    size_t i;
+
+    (void) address;
+
+    for (i = 0; i < n; i++) {
+        out = hex_byte(out, (unsigned)words[i] >> 8);
+        out = hex_byte(out, words[i] & 0xFFu);
+        *out++ = '\n';
+    }
+    return 5 * n;
+}
+
+/*
+ * Writes the two hexadecimal digits of `byte` at `p`, returning the end.
+ */
+static char *
+hex_byte(char *p, unsigned byte)
+{
+    p[0] = Hex[byte >> 4];
+    p[1] = Hex[byte & 0xF];
+    return p + 2;
+}
+
+/*
+ * Formats `n` words at the end of the buffer, which has room for them.
+ */
+static void
+format_words(Emitter *em, const uint16_t *words, size_t n)
+{
+    em->len += Formats[em->format].format(em->address, words, n,
+                                          em->buffer + em->len);
+    em->address += (uint32_t)n;
+}
+
+/*
+ * Formats the pending words at the end of the buffer, written out first if
+ * they don't fit.
+ */
+static void
+format_pending(Emitter *em)
+{
+    if (em->len + em->npending * Formats[em->format].width >
+        EMITTER_BUFFER_SIZE) {
+        write_out(em, em->buffer, em->len);
+        em->len = 0;
+    }
+    format_words(em, em->pending, em->npending);
+    em->npending = 0;
+}
+
+/*
+ * Copies the `size` bytes of `text` at the end of the buffer, written out
+ * first if they don't fit.
+ */
+static void
+append(Emitter *em, const char *text, size_t size)
+{
+    if (em->len + size > EMITTER_BUFFER_SIZE) {
+        write_out(em, em->buffer, em->len);
+        em->len = 0;
+    }
+    memcpy(em->buffer + em->len, text, size);
+    em->len += size;
+}
+
+/*
+ * Writes the `size` bytes of `text` to the file descriptor, retrying short and
+ * interrupted writes.  Once a write failed, nothing else is written.
+ */
+static void
+write_out(Emitter *em, const char *text, size_t size)
+{
+    ssize_t n;
+
+    while (size > 0 && em->error == 0) {
+        if ((n = write(em->fd, text, size)) == -1) {
+            if (errno != EINTR) {
+                em->error = errno;
+                perror("emitter write");
+            }
+            continue;
+        }
+        text += n;
+        size -= (size_t)n;
+    }
+}
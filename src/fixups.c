@@ -0,0 +1,196 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashfuncs.h"
+#include "hashtable_adt.h"
+#include "fixups.h"
+
+#define FIXUP_BUCKETS 1024          /* Forward references are few */
+
+
+/*********************************************************** Data Definitions */
+
+/*
+ * A symbol referenced ahead of its definition.  The name is allocated along
+ * with the struct, the hash table only holds pointers to these.
+ */
+typedef struct pending {
+    uint16_t head;                  /* Latest use, `ERROR` once taken */
+    char symbol[];                  /* Null-terminated symbol name */
+} Pending;
+
+/*
+ * Datatype completion for `Fixups`:
+ */
+struct fixups_type {
+    HashTableADT *table;            /* Pending symbols by name */
+    Pending **pending;              /* Pending symbols in order of first use */
+    size_t count;                   /* Entries in `pending` */
+    size_t capacity;                /* Entries allocated */
+    size_t next;                    /* Cursor of `fixups_next_pending()` */
+};
+
+
+/******************************************************* Private Declarations */
+
+static Pending *new_pending(Fixups *, const char *);
+
+
+/***************************************************** Public Implementations */
+
+Fixups *
+fixups_init(void)
+{
+    Fixups *fx;
+
+    if ((fx = calloc(1, sizeof(Fixups))) == NULL) {
+        perror("fixups_init calloc");
+        errno = ENOMEM;
+        return NULL;
+    }
+    fx->table = cadthashtable_new(FIXUP_BUCKETS, hash_select(NULL), NULL);
+    if (fx->table == NULL) {
+        perror("fixups_init cadthashtable_new");
+        free(fx);
+        return NULL;
+    }
+    return fx;
+}
+
+/*
+ * The first use of a symbol creates its `Pending` record, later uses only move
+ * the head of the chain forward.
+ */
+uint16_t
+fixups_add(Fixups *fx, const char *symbol, uint16_t index)
+{
+    Pending *p;
+    uint16_t prev;
+
+    assert(symbol != NULL);
+    assert(index != ERROR);
+
+    p = cadthashtable_lookup(fx->table, symbol, strlen(symbol)+1);
+    if (p == NULL && (p = new_pending(fx, symbol)) == NULL) {
+        return ERROR;
+    }
+
+    prev = p->head;
+    p->head = index;
+    return prev;
+}
+
+/*
+ * The record is left in place, pointing nowhere, so later uses of a bound
+ * label never reach this module anyway.
+ */
+uint16_t
+fixups_take(Fixups *fx, const char *symbol)
+{
+    Pending *p;
+    uint16_t head;
+
+    assert(symbol != NULL);
+
+    if ((p = cadthashtable_lookup(fx->table, symbol, 
+                                  strlen(symbol)+1)) == NULL) {
+        return ERROR;
+    }
+
+    head = p->head;
+    p->head = ERROR;
+    return head;
+}
+
+const char *
+fixups_next_pending(Fixups *fx, uint16_t *head)
+{
+    Pending *p;
+
+    assert(head != NULL);
+
+    while (fx->next < fx->count) {
+        p = fx->pending[fx->next++];
+        if (p->head != ERROR) {
+            *head = p->head;
+            p->head = ERROR;
+            return p->symbol;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Every record is deleted from the hash table before being released, the ADT
+ * does not own its entries.  Does nothing on a NULL list.
+ */
+void
+fixups_destroy(Fixups *fx)
+{
+    size_t i;
+
+    if (fx == NULL) {
+        return;
+    }
+
+    for (i = 0; i < fx->count; i++) {
+        errno = 0;
+        cadthashtable_delete(fx->table, fx->pending[i]->symbol,
+                             strlen(fx->pending[i]->symbol)+1,
+                             fx->pending[i]);
+        free(fx->pending[i]);
+    }
+    free(fx->pending);
+    cadthashtable_destroy(fx->table);
+    free(fx);
+}
+
+
+/**************************************************** Private implementations */
+
+/*
+ * Allocates the record of a first use, appends it to `pending` (growing the
+ * array by doubling) and indexes it by name.  Returns `NULL` setting `errno`
+ * on failure.
+ */
+static Pending *
+new_pending(Fixups *fx, const char *symbol)
+{
+    Pending *p, **grown;
+    size_t len, capacity;
+
+    if (fx->count == fx->capacity) {
+        capacity = fx->capacity ? fx->capacity * 2 : 64;
+        grown = realloc(fx->pending, capacity * sizeof(Pending *));
+        if (grown == NULL) {
+            perror("fixups_add realloc");
+            errno = ENOTRECOVERABLE;
+            return NULL;
+        }
+        fx->pending = grown;
+        fx->capacity = capacity;
+    }
+
+    len = strlen(symbol) + 1;
+    if ((p = malloc(sizeof(Pending) + len)) == NULL) {
+        perror("fixups_add malloc");
+        errno = ENOTRECOVERABLE;
+        return NULL;
+    }
+    memcpy(p->symbol, symbol, len);
+    p->head = ERROR;
+
+    errno = 0;
+    if (cadthashtable_insert(fx->table, p->symbol, len, p) == NULL) {
+        fprintf(stderr, "fixups_add cadthashtable_insert");
+        free(p);
+        errno = ENOTRECOVERABLE;
+        return NULL;
+    }
+
+    fx->pending[fx->count++] = p;
+    return p;
+}
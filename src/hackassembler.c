@@ -3,34 +3,138 @@
  * Computing Systems: Building a Modern Computer from First Principles" by Noam
  * Nisan and Shimon Shocken.
  */
+#define _POSIX_C_SOURCE 200809L     /* getopt(), pthreads */
 #include <errno.h>
-#include <ctype.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "code.h"
 #include "common/shared_defs.h"
+#include "emitter.h"
+#include "fixups.h"
+#include "instcache.h"
+#include "ir.h"
 #include "parser.h"
 #include "symboltable.h"
+#include "symmap.h"
 
-#define WORD_WIDTH 16               /* Bits per instruction */
+#define MAX_THREADS 256
+#define MAX_ADDRESS 0x7FFF          /* Last address an A-instruction loads */
+
+#ifndef CHUNK_LINES
+#define CHUNK_LINES 4096            /* Fewest commands worth a chunk */
+#endif
+#define CHUNKS_PER_THREAD 4         /* Evens out the load of the pool */
 
 
 /********************************************************** Data Declarations */
 
-static FILE *OutputStream;
-static uint16_t BaseAddress, Instruction, InstructionNumber;
+/*
+ * A label bound inside a chunk, before the instruction at `index` of the
+ * chunk.  The name points into the input, where the parser terminated it.
+ */
+typedef struct Label {
+    const char *name;
+    uint16_t index;
+} Label;
+
+/*
+ * A run of consecutive commands of the input, translated on its own by the
+ * parallel mode.  Its addresses start at 0 until `base` is known.
+ */
+typedef struct Chunk {
+    Parser *parser;                 /* Slice of the input */
+    Ir *ir;
+    InstCache *cache;               /* Private to the thread of the chunk */
+    Label *labels;                  /* In order of definition */
+    size_t nlabels;
+    size_t labels_capacity;
+    uint16_t base;                  /* Address of the first instruction */
+    uint16_t *words;                /* Output of the chunk */
+} Chunk;
+
+/*
+ * All the state of one assembly.  Nothing is kept at file scope, so several
+ * assemblies can run at once, on different threads, each with its own context.
+ */
+typedef struct Assembler {
+    Parser *parser;
+    SymbolTable *symbols;
+    Fixups *fixups;                 /* Single-pass mode only */
+    Ir *ir;                         /* Two-passes mode only */
+    InstCache *cache;               /* Sequential modes only */
+    unsigned long cache_hits;       /* Totals of every cache released */
+    unsigned long cache_misses;
+    FILE *outputs[EMITTER_FORMATS]; /* One per format */
+    Emitter *emitters[EMITTER_FORMATS]; /* Write to `outputs` */
+    uint16_t base_address;          /* Last address allocated to a variable */
+    uint16_t instruction;           /* Word being translated */
+    uint16_t instruction_number;
+    uint16_t *program;              /* Words held back in single-pass mode */
+    size_t program_capacity;
+    bool single_pass;               /* Set by the `-s` option */
+    char *output_name;              /* Set by the `-o` option */
+    EmitterFormat formats[EMITTER_FORMATS]; /* Set by the `-f` option */
+    size_t nformats;
+    unsigned threads;               /* Set by the `-j` option */
+    bool verbose;                   /* Set by the `-v` option */
+    char *map_name;                 /* Set by the `-m` option */
+    Chunk *chunks;                  /* Parallel mode only */
+    size_t nchunks;
+    bool input_read;                /* Errors no longer point at a line */
+} Assembler;
+
+typedef void Phase(Assembler *, Chunk *);
+
+/*
+ * Work queue of a parallel phase.  Every thread of the pool, the calling one
+ * included, takes the next chunk until none is left.
+ */
+typedef struct Pool {
+    Assembler *as;
+    Phase *phase;
+    size_t next;                    /* Next chunk to take */
+    size_t failed;                  /* First chunk failed, `nchunks` if none */
+    int error;                      /* Its `errno` */
+    pthread_mutex_t lock;
+} Pool;
 
 
 /******************************************************* Private Declarations */
 
-void process_l_instructions(void);
-void process_a_or_c_instruction(void);
-void open_output_stream(char *);
-uint16_t num_to_address(const char *);
-void write_to_binary_stream(void);
-void die(void);
+void two_passes(Assembler *);
+void parallel_passes(Assembler *);
+void single_pass(Assembler *);
+void process_first_pass(Assembler *);
+bool lex_command(Parser *, InstCache *, Command *, uint16_t *);
+void add_to_ir(Ir *, const Command *, uint16_t);
+bool split_chunks(Assembler *);
+size_t run_phase(Assembler *, Phase *);
+void *worker(void *);
+Phase lex_chunk, resolve_chunk, narrow_chunk;
+void add_label(Chunk *, const char *);
+void free_chunks(Assembler *);
+void release_cache(Assembler *, InstCache *);
+void die_in_chunk(Assembler *, size_t);
+uint16_t symbol_to_address(Assembler *, const char *);
+uint16_t id_to_address(Assembler *, uint32_t);
+uint16_t encode_c_instruction(const Command *);
+void process_instruction(Assembler *);
+void hold_instruction(Assembler *);
+bool rom_full(Assembler *);
+void backpatch(Assembler *, uint16_t, uint16_t);
+void usage(const char *);
+void print_stats(Assembler *);
+void write_symbol_maps(Assembler *);
+void add_format(Assembler *, const char *, const char *);
+void open_output_stream(Assembler *, char *, size_t);
+void write_to_binary_stream(Assembler *);
+void write_words(Assembler *, const uint16_t *, size_t);
+void die(Assembler *);
 
 
 /**************************************************** Private Implementations */
@@ -38,228 +142,1101 @@ void die(void);
 
 /*
  * Main routine implemented as described in section 6.3.5 "Assembler for
- * Programs with Symbols", following a two passes approach. 
+ * Programs with Symbols", following a two passes approach.  The `-s` option
+ * selects a single pass with backpatching instead.  Neither of them reads the
+ * input twice, so it can be a pipe.  The `-j` option runs the two passes on a
+ * pool of threads.  Every format selected with `-f` is written at once, from
+ * the same words.
  */
 
 #ifndef MINUNIT_MINUNIT_H
 int 
 main(int argc, char *argv[])
 {
+    Assembler as = {0};
+    char *end;
+    long n;
+    int opt;
+    size_t i;
 
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <input.asm>\n", argv[0]);
-        exit(EXIT_FAILURE);
+    as.threads = 1;
+    while ((opt = getopt(argc, argv, "so:j:vm:f:")) != -1) {
+        switch (opt) {
+        case 's':
+            as.single_pass = true;
+            break;
+        case 'v':
+            as.verbose = true;
+            break;
+        case 'o':
+            as.output_name = optarg;
+            break;
+        case 'm':
+            as.map_name = optarg;
+            break;
+        case 'f':
+            add_format(&as, optarg, argv[0]);
+            break;
+        case 'j':
+            n = strtol(optarg, &end, 10);
+            if (*end != '\0' || n < 1 || n > MAX_THREADS) {
+                usage(argv[0]);
+            }
+            as.threads = (unsigned)n;
+            break;
+        default:
+            usage(argv[0]);
+        }
     }
-    if (parser_init(argv[1]) == NULL) {
+    if (as.nformats == 0) {
+        as.formats[as.nformats++] = EMITTER_HACK;
+    }
+    if (optind != argc - 1 ||
+        (as.nformats > 1 && strcmp(as.output_name != NULL ? as.output_name
+                                   : argv[optind], "-") == 0)) {
+        usage(argv[0]);
+    }
+    if ((as.parser = parser_init(argv[optind])) == NULL) {
         exit(EXIT_FAILURE);
     }
     
+    for (i = 0; i < as.nformats; i++) {     /* Set up output streams */
+        open_output_stream(&as, argv[optind], i);
+    }
+    errno = 0;
+    if ((as.symbols = symbol_table_init()) == NULL ||
+        (as.cache = instcache_init()) == NULL) {
+        die(&as);
+    }
+    for (i = 0; i < as.nformats; i++) {
+        as.emitters[i] = emitter_init(fileno(as.outputs[i]), as.formats[i]);
+        if (as.emitters[i] == NULL) {
+            die(&as);
+        }
+    }
+
+    if (as.single_pass) {
+        single_pass(&as);
+    } else if (as.threads > 1) {
+        parallel_passes(&as);
+    } else {
+        two_passes(&as);
+    }
+
+    for (i = 0; i < as.nformats; i++) {
+        if (!emitter_finish(as.emitters[i])) {
+            die(&as);
+        }
+    }
+    release_cache(&as, as.cache);
+    as.cache = NULL;
+    if (as.verbose) {
+        print_stats(&as);
+    }
+    if (as.map_name != NULL) {
+        write_symbol_maps(&as);
+    }
+
+    symbol_table_destroy(as.symbols);
+    parser_destroy(as.parser);
+    for (i = 0; i < as.nformats; i++) {
+        emitter_destroy(as.emitters[i]);
+        fclose(as.outputs[i]);
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif /* MINUNIT_MINUNIT_H */
+
+/*
+ * The two passes of section 6.3.5.  The first one builds the symbol table out
+ * of the labels and translates every other instruction into the IR, interning
+ * the symbols of A-instructions.  The symbol table is then frozen.  The second
+ * one resolves them by ID and writes the output, it doesn't read the input
+ * again.
+ */
+void two_passes(Assembler *as)
+{
+    const Ir *ir;
+    uint16_t i;
+
     /* 
      * First pass:
      */
-    open_output_stream(argv[1]);      /* Set up output stream and environment */
-    InstructionNumber = 0;
     errno = 0;
-    symbol_table_init();
-    if (errno != 0) {
-        die();
+    if ((as->ir = ir_init()) == NULL) {
+        die(as);
     }
-
+    as->instruction_number = 0;
     for ( ; ; ) {
-        parser_advance();
+        parser_advance(as->parser);
         if (errno != 0) {
-            die();
+            die(as);
         }
-        if (parser_has_more_commands() && errno == 0){
-            process_l_instructions();
+        if (parser_has_more_commands(as->parser) && errno == 0){
+            process_first_pass(as);
             if (errno != 0) {
-                die();
+                die(as);
             }
         } else {
             break;
         }
 
     }
+    as->input_read = true;
 
-    if (errno != 0) {
-        die();
+    if (errno != 0 || !symbol_table_freeze(as->symbols)) {
+        die(as);
     }
 
 
     /* 
      * Second pass:
      */
-    parser_rewind();                       /* Set environment for second pass */
-    InstructionNumber = 0;
-    BaseAddress = 15;
+    ir = as->ir;
+    as->instruction_number = 0;
+    as->base_address = 15;
+
+    for (i = 0; i < ir->count; i++) {
+        if (ir->kind[i] == IR_ID) {
+            as->instruction = id_to_address(as, ir->operand[i]);
+        } else if (ir->kind[i] == IR_SYMBOL) {
+            as->instruction = symbol_to_address(as, ir->names + ir->operand[i]);
+        } else {
+            as->instruction = (uint16_t)ir->operand[i];
+        }
+        if (as->instruction == ERROR) {
+            die(as);
+        }
+        write_to_binary_stream(as);
+    }
+
+    ir_destroy(as->ir);
+    as->ir = NULL;
+}
+
+/*
+ * The two passes on a pool of `threads` threads.  The input is split into
+ * chunks of consecutive commands, then:
+ *
+ * 1. Every chunk is translated into its own IR, collecting its labels with
+ *    addresses relative to the chunk.  (Parallel)
+ * 2. A prefix sum of the instruction counts gives the base address of every
+ *    chunk, and the labels are added to the symbol table, then frozen.
+ *    (Serial)
+ * 3. Every chunk resolves the symbols already in the table, which is only read
+ *    from now on.  (Parallel)
+ * 4. The symbols left are variables.  They are allocated walking the chunks in
+ *    order, so they get the same addresses as in the sequential mode.  (Serial)
+ * 5. Every chunk narrows its words, which are then written in order.
+ *    (Parallel)
+ *
+ * Inputs too short to split take the sequential path.
+ */
+void parallel_passes(Assembler *as)
+{
+    Chunk *c;
+    size_t i, j, total;
+    const char *symbol;
+    uint16_t addr;
+
+    errno = 0;
+    if (!split_chunks(as)) {
+        die(as);
+    }
+    if (as->nchunks == 1) {
+        free_chunks(as);
+        two_passes(as);
+        return;
+    }
+
+    if ((i = run_phase(as, lex_chunk)) != as->nchunks) {
+        die_in_chunk(as, i);
+    }
+    as->input_read = true;
+
+    total = 0;
+    for (i = 0; i < as->nchunks; i++) {
+        c = &as->chunks[i];
+        c->base = (uint16_t)total;
+        total += c->ir->count;
+        if (total > ERROR) {
+            fprintf(stderr, "Program exceeds the ROM size.\n");
+            as->instruction_number = ERROR;
+            errno = EFBIG;
+            die(as);
+        }
+        for (j = 0; j < c->nlabels; j++) {
+            as->instruction_number = (uint16_t)(c->base + c->labels[j].index);
+            symbol_table_add_entry(as->symbols, c->labels[j].name,
+                                   as->instruction_number);
+            if (errno != 0) {
+                die(as);
+            }
+        }
+    }
+    if (!symbol_table_freeze(as->symbols)) {
+        die(as);
+    }
+
+    if ((i = run_phase(as, resolve_chunk)) != as->nchunks) {
+        die_in_chunk(as, i);
+    }
+
+    as->base_address = 15;
+    for (i = 0; i < as->nchunks; i++) {
+        c = &as->chunks[i];
+        for (j = 0; j < c->ir->count; j++) {
+            if (c->ir->kind[j] != IR_SYMBOL) {
+                continue;
+            }
+            symbol = c->ir->names + c->ir->operand[j];
+            if ((addr = symbol_to_address(as, symbol)) == ERROR) {
+                as->instruction_number = (uint16_t)(c->base + j);
+                die(as);
+            }
+            ir_set_word(c->ir, (uint16_t)j, addr);
+        }
+    }
+
+    if ((i = run_phase(as, narrow_chunk)) != as->nchunks) {
+        die_in_chunk(as, i);
+    }
+
+    for (i = 0; i < as->nchunks; i++) {
+        c = &as->chunks[i];
+        write_words(as, c->words, c->ir->count);
+    }
+
+    free_chunks(as);
+}
+
+/*
+ * Splits the input into slices of at least `CHUNK_LINES` commands, a few of
+ * them per thread.  Returns `false` setting `errno` on failure.
+ */
+bool split_chunks(Assembler *as)
+{
+    size_t n, i, first, size;
+    Chunk *c;
+
+    n = parser_length(as->parser);
+    as->nchunks = as->threads * CHUNKS_PER_THREAD;
+    if (as->nchunks > n / CHUNK_LINES) {
+        as->nchunks = n / CHUNK_LINES;
+    }
+    if (as->nchunks == 0) {
+        as->nchunks = 1;
+    }
+    size = (n + as->nchunks - 1) / as->nchunks;
+
+    if ((as->chunks = calloc(as->nchunks, sizeof(Chunk))) == NULL) {
+        perror("split_chunks calloc");
+        errno = ENOMEM;
+        return false;
+    }
+
+    for (i = 0, first = 0; i < as->nchunks; i++, first += size) {
+        c = &as->chunks[i];
+        if (first + size > n) {
+            size = n - first;
+        }
+        if ((c->parser = parser_slice(as->parser, first, size)) == NULL ||
+            (c->ir = ir_init()) == NULL ||
+            (c->cache = instcache_init()) == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Runs `phase` over every chunk on the thread pool, and waits for it to be
+ * done.  A thread that fails to start just leaves more chunks to the others.
+ * Returns the first chunk that failed, with `errno` set to its error, or
+ * `nchunks` if none did.
+ */
+size_t run_phase(Assembler *as, Phase *phase)
+{
+    pthread_t threads[MAX_THREADS];
+    Pool pool;
+    unsigned i, n;
+
+    pool.as = as;
+    pool.phase = phase;
+    pool.next = 0;
+    pool.failed = as->nchunks;
+    pool.error = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+
+    for (n = 0; n + 1 < as->threads && n + 1 < as->nchunks; n++) {
+        if (pthread_create(&threads[n], NULL, worker, &pool) != 0) {
+            break;
+        }
+    }
+    worker(&pool);
+    for (i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool.lock);
+    errno = pool.error;
+    return pool.failed;
+}
+
+/*
+ * Takes chunks from the pool until none is left.  Once a chunk fails, the
+ * rest are skipped.  `errno` is private to every thread.
+ */
+void *worker(void *arg)
+{
+    Pool *pool = arg;
+    size_t i;
+    int error;
+
+    for ( ; ; ) {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->failed != pool->as->nchunks) {
+            pool->next = pool->as->nchunks;
+        }
+        i = pool->next < pool->as->nchunks ? pool->next++ : pool->as->nchunks;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i == pool->as->nchunks) {
+            return NULL;
+        }
+
+        errno = 0;
+        pool->phase(pool->as, &pool->as->chunks[i]);
+
+        if ((error = errno) != 0) {
+            pthread_mutex_lock(&pool->lock);
+            if (i < pool->failed) {
+                pool->failed = i;
+                pool->error = error;
+            }
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+}
+
+/*
+ * First phase: the first pass over the commands of the chunk.  Labels are only
+ * collected, the symbol table is left alone.
+ */
+void lex_chunk(Assembler *as, Chunk *c)
+{
+    Command cmd;
+    uint16_t word;
+
+    (void) as;
+
+    for ( ; ; ) {
+        parser_advance(c->parser);
+        if (errno != 0 || !parser_has_more_commands(c->parser)) {
+            return;
+        }
+        if (!lex_command(c->parser, c->cache, &cmd, &word)) {
+            return;
+        }
+        if (cmd.type == L_COMMAND) {
+            add_label(c, cmd.symbol.str);
+        } else {
+            add_to_ir(c->ir, &cmd, word);
+        }
+        if (errno != 0) {
+            return;
+        }
+    }
+}
+
+/*
+ * Third phase: resolves the symbols of the chunk found in the symbol table,
+ * labels and predefined symbols.  Variables are left as they are.
+ */
+void resolve_chunk(Assembler *as, Chunk *c)
+{
+    uint16_t i, addr;
+
+    for (i = 0; i < c->ir->count; i++) {
+        if (c->ir->kind[i] != IR_SYMBOL) {
+            continue;
+        }
+        addr = symbol_table_get_addr(as->symbols,
+                                     c->ir->names + c->ir->operand[i]);
+        if (addr != ERROR) {
+            ir_set_word(c->ir, i, addr);
+        }
+    }
+}
+
+/*
+ * Fifth phase: narrows the instructions of the chunk to words for the
+ * emitters.  The operands of the IR are 32 bits wide.
+ */
+void narrow_chunk(Assembler *as, Chunk *c)
+{
+    size_t i;
+
+    (void) as;
+
+    c->words = malloc(((size_t)c->ir->count + 1) * sizeof(uint16_t));
+    if (c->words == NULL) {
+        perror("narrow_chunk malloc");
+        errno = ENOMEM;
+        return;
+    }
+    for (i = 0; i < c->ir->count; i++) {
+        c->words[i] = (uint16_t)c->ir->operand[i];
+    }
+}
+
+/*
+ * Records the label `name` before the next instruction of the chunk, growing
+ * `labels` by doubling.  Sets `errno` on failure.
+ */
+void add_label(Chunk *c, const char *name)
+{
+    Label *grown;
+    size_t capacity;
+
+    if (c->nlabels == c->labels_capacity) {
+        capacity = c->labels_capacity ? c->labels_capacity * 2 : 64;
+        grown = realloc(c->labels, capacity * sizeof(Label));
+        if (grown == NULL) {
+            perror("add_label realloc");
+            errno = ENOTRECOVERABLE;
+            return;
+        }
+        c->labels = grown;
+        c->labels_capacity = capacity;
+    }
+    c->labels[c->nlabels].name = name;
+    c->labels[c->nlabels].index = c->ir->count;
+    c->nlabels++;
+}
+
+/*
+ * Releases every chunk.  Does nothing if there are none.  `errno` is cleared
+ * while the slices are destroyed, they have no error of their own to report.
+ */
+void free_chunks(Assembler *as)
+{
+    size_t i;
+    int error;
+
+    error = errno;
+    errno = 0;
+    for (i = 0; as->chunks != NULL && i < as->nchunks; i++) {
+        parser_destroy(as->chunks[i].parser);
+        ir_destroy(as->chunks[i].ir);
+        release_cache(as, as->chunks[i].cache);
+        free(as->chunks[i].labels);
+        free(as->chunks[i].words);
+    }
+    free(as->chunks);
+    as->chunks = NULL;
+    as->nchunks = 0;
+    errno = error;
+}
+
+/*
+ * Adds the counters of `cache` to the totals, and destroys it.  Does nothing on
+ * a NULL cache.
+ */
+void release_cache(Assembler *as, InstCache *cache)
+{
+    unsigned long hits, misses;
+
+    if (cache == NULL) {
+        return;
+    }
+    instcache_stats(cache, &hits, &misses);
+    as->cache_hits += hits;
+    as->cache_misses += misses;
+    instcache_destroy(cache);
+}
+
+/*
+ * Aborts on the failure of a parallel phase in chunk `failed`.  Its slice takes
+ * the place of the main parser, so the message of a failed lexing shows the
+ * line it stopped at.
+ */
+void die_in_chunk(Assembler *as, size_t failed)
+{
+    Parser *slice;
+    size_t i;
+    int error;
+
+    error = errno;
+    as->instruction_number = 0;
+    for (i = 0; i <= failed; i++) {
+        as->instruction_number += as->chunks[i].ir->count;
+    }
+
+    slice = as->chunks[failed].parser;
+    as->chunks[failed].parser = NULL;
+    free_chunks(as);
+
+    errno = 0;
+    parser_destroy(as->parser);
+    as->parser = slice;
+    errno = error;
+    die(as);
+}
+
+/*
+ * Translates the whole input in a single pass.  Instructions are held back in
+ * `program`, since forward references are only resolved once their label
+ * shows up.  Symbols still pending at the end of the input are variables,
+ * allocated in order of first use just as the second pass would, so the output
+ * is the same.
+ */
+void single_pass(Assembler *as)
+{
+    const char *symbol;
+    uint16_t head, addr;
+    uint32_t id;
+
+    errno = 0;
+    if ((as->fixups = fixups_init()) == NULL) {
+        die(as);
+    }
+    as->instruction_number = 0;
 
-    for ( ; errno == 0 && Instruction != ERROR; ) {
-        parser_advance();
+    for ( ; ; ) {
+        parser_advance(as->parser);
         if (errno != 0) {
-            die();
+            die(as);
         }
-        if (parser_has_more_commands() && errno == 0){
-            process_a_or_c_instruction();
+        if (parser_has_more_commands(as->parser) && errno == 0){
+            process_instruction(as);
+            if (errno != 0) {
+                die(as);
+            }
         } else {
             break;
         }
     }
 
-    if (Instruction == ERROR || errno != 0) {
-        die();
+    if (errno != 0) {
+        die(as);
     }
-    symbol_table_destroy();
-    parser_destroy();
-    fclose(OutputStream);
-    return EXIT_SUCCESS;
+    as->input_read = true;
+
+    as->base_address = 15;
+    while ((symbol = fixups_next_pending(as->fixups, &head)) != NULL) {
+        errno = 0;
+        if ((id = symbol_table_intern(as->symbols, symbol)) == UINT32_MAX ||
+            (addr = id_to_address(as, id)) == ERROR) {
+            die(as);
+        }
+        backpatch(as, head, addr);
+    }
+
+    write_words(as, as->program, as->instruction_number);
+
+    fixups_destroy(as->fixups);
+    as->fixups = NULL;
+    free(as->program);
+    as->program = NULL;
+    as->program_capacity = 0;
 }
 
-#endif /* MINUNIT_MINUNIT_H */
+/*
+ * Handles labels, generating the symbol table, and translates A and C
+ * instructions into the IR.  Only symbols are left for the second pass to
+ * resolve, interned so that it never hashes them.  In case an error occurs,
+ * leaves `errno` set at returning.  The controlling loop can then halt the
+ * translation process immediately.
+ */
+void process_first_pass(Assembler *as)
+{
+    Command cmd;
+    uint16_t word;
+    uint32_t id;
+
+    if (!lex_command(as->parser, as->cache, &cmd, &word)) {
+        return;
+    }
+
+    if (cmd.type == L_COMMAND) {
+        symbol_table_add_entry(as->symbols, cmd.symbol.str,
+                               as->instruction_number);
+        return;
+    }
+
+    if (cmd.type == A_COMMAND && cmd.symbol.len != 0) {
+        id = symbol_table_intern(as->symbols, cmd.symbol.str);
+        if (id == UINT32_MAX) {
+            return;
+        }
+        ir_add_id(as->ir, id);
+    } else {
+        add_to_ir(as->ir, &cmd, word);
+    }
+    if (errno == 0) {
+        as->instruction_number++;
+    }
+}
+
+/*
+ * Lexes the current command of `ps` into `cmd`, and encodes a C-instruction
+ * into `word`.  A C-instruction seen before is found in `cache` by its text,
+ * skipping the lexer and the encoder altogether: only its type is set in
+ * `cmd`.  Returns `false` setting `errno` on error.
+ */
+bool lex_command(Parser *ps, InstCache *cache, Command *cmd, uint16_t *word)
+{
+    const char *line;
+    size_t len;
+
+    line = parser_line(ps, &len);
+    if (*line != '@' && *line != '(') {
+        if ((*word = instcache_lookup(cache, line, len)) != ERROR) {
+            cmd->type = C_COMMAND;
+            return true;
+        }
+    }
+
+    if (!parser_command(ps, cmd)) {
+        return false;
+    }
+    if (cmd->type == C_COMMAND) {
+        if ((*word = encode_c_instruction(cmd)) == ERROR) {
+            return false;
+        }
+        instcache_insert(cache, line, len, *word);
+    }
+    return true;
+}
 
 /*
- * Handles labels, generating the symbol table.  In case an error occurs while
- * adding a symbol, leaves `errno` set at returning.  The controlling loop can
- * then halt the translation process immediately.
+ * Appends the A instruction `cmd`, or the C-instruction encoded as `word`, to
+ * `ir`.  The symbol of an `@SYMBOL` is left unresolved.  Leaves `errno` set on
+ * error.
  */
-void process_l_instructions(void)
+void add_to_ir(Ir *ir, const Command *cmd, uint16_t word)
 {
-    if (parser_get_command_type() == L_COMMAND) {
-        symbol_table_add_entry(parser_symbol(), InstructionNumber);
+    if (cmd->type == A_COMMAND && cmd->symbol.len != 0) {
+        ir_add_symbol(ir, cmd->symbol.str);
+    } else if (cmd->type == A_COMMAND) {
+        ir_add_word(ir, cmd->value);
     } else {
-        InstructionNumber++;
+        ir_add_word(ir, word);
+    }
+}
+
+/*
+ * Returns the address bound to `symbol`.  A symbol missing from the table is a
+ * variable, allocated at the next free address from `base_address`.  Returns
+ * the `ERROR` macro if it can't be added.
+ */
+uint16_t symbol_to_address(Assembler *as, const char *symbol)
+{
+    uint16_t addr;
+    uint32_t id;
+
+    errno = 0;
+    addr = symbol_table_lookup_or_insert(as->symbols, symbol, &id);
+    if (addr != ERROR || id == UINT32_MAX) {
+        return addr;
+    }
+    return id_to_address(as, id);
+}
+
+/*
+ * Returns the address bound to the symbol `id`, a single load.  An unbound
+ * symbol is a variable, bound to the next free address from `base_address`.
+ * Returns the `ERROR` macro setting `errno` once past the last address an
+ * A-instruction can load.
+ */
+uint16_t id_to_address(Assembler *as, uint32_t id)
+{
+    uint16_t addr;
+
+    if ((addr = symbol_table_address(as->symbols, id)) != ERROR) {
+        return addr;
+    }
+
+    if (as->base_address == MAX_ADDRESS) {
+        fprintf(stderr, "Variables exceed the addressable memory.\n");
+        errno = EFBIG;
+        return ERROR;
+    }
+    errno = 0;
+    symbol_table_bind(as->symbols, id, ++as->base_address, SYMBOL_VARIABLE);
+    return errno == 0 ? as->base_address : ERROR;
+}
+
+/*
+ * Encodes the fields of the C-instruction `cmd`.  Returns the `ERROR` macro
+ * setting `errno` if a mnemonic is invalid.
+ */
+uint16_t encode_c_instruction(const Command *cmd)
+{
+    uint16_t word;
+
+    if ((word = code_c_instruction(cmd->dest, cmd->comp, cmd->jump)) == ERROR) {
+        errno = EINVAL;
     }
+    return word;
 }
 
 /*
- * Handles A and C instructions according to the specifications.  
- * It resets the `Instruction` variable to 0x0 at each call. After the routine
- * completes, it writes an `Instruction` to the stream, even if the `ERROR`
- * macro was returned or an error occurred in the translation process.  
- * This behavior allows the controlling loop to halt translation upon an error.
+ * Handles every kind of instruction in single-pass mode.  A label binds its
+ * address and patches the uses that came ahead of it.  An `@SYMBOL` not yet in
+ * the table is held as a placeholder threaded into the symbol's fixup chain.
+ * Leaves `errno` set on error, so the controlling loop can halt.
  */
-void process_a_or_c_instruction(void)
+void process_instruction(Assembler *as)
 {
+    Command cmd;
     const char *tkn;
-    bool num, sym;
+    uint16_t word;
+    uint32_t id;
 
-    Instruction = 0x0;
+    as->instruction = 0x0;
+
+    if (!lex_command(as->parser, as->cache, &cmd, &word)) {
+        return;
+    }
+
+    switch (cmd.type) {
+    case L_COMMAND:
+        tkn = cmd.symbol.str;
+        symbol_table_add_entry(as->symbols, tkn, as->instruction_number);
+        if (errno == 0) {
+            backpatch(as, fixups_take(as->fixups, tkn),
+                      as->instruction_number);
+        }
+        return;
 
-    switch (parser_get_command_type()) {
     case A_COMMAND:
-        tkn = parser_symbol();
-        sym = isalpha(*tkn);
-        num = isdigit(*tkn);
-        
-        if (sym && !num) {
-            if (symbol_table_contains(tkn)) {
-                Instruction = symbol_table_get_addr(tkn);
-            } else {
-                symbol_table_add_entry(tkn, ++BaseAddress);
-                if (errno != 0) {
-                    Instruction = ERROR;
-                } else {
-                    Instruction = BaseAddress;
-                }
+        tkn = cmd.symbol.str;
+
+        if (cmd.symbol.len == 0) {
+            as->instruction = cmd.value;
+        } else if ((word = symbol_table_lookup_or_insert(as->symbols, tkn, &id))
+                   != ERROR) {
+            as->instruction = word;
+        } else if (id == UINT32_MAX || rom_full(as)) {
+            return;
+        } else {
+            errno = 0;
+            as->instruction = fixups_add(as->fixups, tkn,
+                                         as->instruction_number);
+            if (errno != 0) {
+                return;
             }
-        } else { 
-            Instruction = num_to_address(tkn);
         }
-        write_to_binary_stream();
         break;
 
     case C_COMMAND:
-        Instruction |= code_dest(parser_dest());
-        Instruction |= code_comp(parser_comp());
-        Instruction |= code_jump(parser_jump());
-        Instruction |= 0xE000;
-        write_to_binary_stream();
+        as->instruction = word;
         break;
 
     default:
-        break;
+        return;
     }
+
+    hold_instruction(as);
 }
 
 /*
- * Opens a file stream for writing after setting an appropriate filename.
+ * Appends `instruction` to `program`, growing it by doubling.  Indices must
+ * stay below `ERROR`, which ends the fixup chains, the size of the Hack ROM
+ * anyway.
  */
-void open_output_stream(char *dotasm)
+void hold_instruction(Assembler *as)
 {
-    char *dothack, *ext;
-    char *newext; 
-    
-    newext = ".hack";
-    ext = strrchr(dotasm, '.');
-    *ext = '\0';
+    uint16_t *grown;
+    size_t capacity;
+
+    if (rom_full(as)) {
+        return;
+    }
+
+    if (as->instruction_number == as->program_capacity) {
+        capacity = as->program_capacity ? as->program_capacity * 2 : 1024;
+        grown = realloc(as->program, capacity * sizeof(*as->program));
+        if (grown == NULL) {
+            perror("hold_instruction realloc");
+            errno = ENOTRECOVERABLE;
+            return;
+        }
+        as->program = grown;
+        as->program_capacity = capacity;
+    }
+
+    as->program[as->instruction_number++] = as->instruction;
+}
+
+/*
+ * Whether the ROM is full, so the next instruction can't be held nor be the use
+ * of a fixup.  Sets `errno` if so.
+ */
+bool rom_full(Assembler *as)
+{
+    if (as->instruction_number == ERROR) {
+        fprintf(stderr, "Program exceeds the ROM size.\n");
+        errno = EFBIG;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Walks the fixup chain starting at `head`, overwriting each placeholder with
+ * `addr`.  Every placeholder holds the index of the previous use.
+ */
+void backpatch(Assembler *as, uint16_t head, uint16_t addr)
+{
+    uint16_t next;
+
+    while (head != ERROR) {
+        next = as->program[head];
+        as->program[head] = addr;
+        head = next;
+    }
+}
+
+/*
+ * Selects the format named `name` with `-f`, once, or exits printing the usage
+ * of `progname` if there is none.
+ */
+void add_format(Assembler *as, const char *name, const char *progname)
+{
+    EmitterFormat format;
+    size_t i;
+
+    if ((format = emitter_format(name)) == EMITTER_FORMATS) {
+        usage(progname);
+    }
+    for (i = 0; i < as->nformats; i++) {
+        if (as->formats[i] == format) {
+            return;
+        }
+    }
+    as->formats[as->nformats++] = format;
+}
+
+/*
+ * Opens a file stream for writing the `i`-th format after setting an
+ * appropriate filename: the input's with the extension of the format, unless
+ * one was given with `-o`.  With several formats, the name given with `-o`
+ * gets the extension of each.  The name "-" stands for the standard output,
+ * which is also the default when reading from the standard input.
+ */
+void open_output_stream(Assembler *as, char *dotasm, size_t i)
+{
+    const char *base, *ext, *newext;
+    char *name;
+    int baselen;
+
+    if (as->output_name == NULL && strcmp(dotasm, "-") == 0) {
+        as->output_name = "-";
+    }
+    if (as->output_name != NULL && strcmp(as->output_name, "-") == 0) {
+        as->outputs[i] = stdout;
+        return;
+    }
+    if (as->output_name != NULL && as->nformats == 1) {
+        if ((as->outputs[i] = fopen(as->output_name, "w")) == NULL) {
+            perror("open_output_stream");
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    newext = emitter_format_extension(as->formats[i]);
+    base = as->output_name != NULL ? as->output_name : dotasm;
+    baselen = (int)strlen(base);
+    if (as->output_name == NULL && (ext = strrchr(base, '.')) != NULL &&
+        strchr(ext, '/') == NULL) {
+        baselen = (int)(ext - base);
+    }
 
-    if ((dothack = malloc(strlen(dotasm) + sizeof(newext))) == NULL) {
-        perror("malloc dothack");
+    if ((name = malloc((size_t)baselen + strlen(newext) + 1)) == NULL) {
+        perror("malloc output name");
         exit(EXIT_FAILURE);
     }
-    sprintf(dothack, "%s%s", dotasm, newext);
+    sprintf(name, "%.*s%s", baselen, base, newext);
 
-    OutputStream = fopen(dothack , "w");
-    free(dothack);
-    if (OutputStream == NULL) {
-        perror("open_OutputStream");
+    as->outputs[i] = fopen(name, "w");
+    free(name);
+    if (as->outputs[i] == NULL) {
+        perror("open_output_stream");
         exit(EXIT_FAILURE);
     }
 }
 
 /*
- * Converts a string to an unsigned 16 bit, integer. It returns `ERROR` on
- * overflow or underflow.
+ * Writes the codified binary `instruction` to every output stream, through the
+ * buffers of the emitters, and increments the instruction counter
+ * `instruction_number`.
  */
-uint16_t num_to_address(const char *s)
+void write_to_binary_stream(Assembler *as)
 {
-    long val;
-    char *endptr;
+    size_t i;
 
-    errno = 0;
-    val = strtol(s, &endptr, 10);
-    if (errno != 0) {
-        perror("strtol");
-        return ERROR;
+    for (i = 0; i < as->nformats; i++) {
+        emitter_word(as->emitters[i], as->instruction);
     }
-    if (endptr == s || val < 0 || val >= ERROR) {
-        return ERROR;
+    as->instruction_number++;
+}
+
+/*
+ * Writes the `n` words of `words` to every output stream.
+ */
+void write_words(Assembler *as, const uint16_t *words, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < as->nformats; i++) {
+        emitter_words(as->emitters[i], words, n);
     }
-    return (uint16_t)val;
 }
 
 /*
- * Writes the codified binary `Instruction` to `OutputStream` and increments the
- * instruction counter `InstructionNumber`.
+ * Prints the command line synopsis and exits.
  */
-void write_to_binary_stream(void)
+void usage(const char *progname)
 {
-    uint16_t mask; 
-    uint8_t i;
-    
-    mask = 0x8000;
+    EmitterFormat f;
+
+    fprintf(stderr, "Usage: %s [-s | -j threads] [-v] [-m map] "
+            "[-f format]... [-o output] <input.asm | ->\n", progname);
+    fprintf(stderr, "  -s  single pass, backpatching forward references\n");
+    fprintf(stderr, "  -j  two passes on a pool of threads, up to %d\n",
+            MAX_THREADS);
+    fprintf(stderr, "  -v  print statistics to the standard error\n");
+    fprintf(stderr, "  -m  write the symbols to map.sym and map.symtab\n");
+    fprintf(stderr, "  -f  output format, repeatable, hack by default:\n     ");
+    for (f = EMITTER_HACK; f < EMITTER_FORMATS; f++) {
+        fprintf(stderr, " %s (%s)", emitter_format_name(f),
+                emitter_format_extension(f));
+    }
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -o  output file, - for the standard output, or the "
+            "base name of several\n");
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Prints the counters of the instruction caches, summed over every thread, and
+ * of the hot symbol cache, then the shape and search counters of the symbol
+ * table, of its side table once frozen, and the kernel formatting the output.
+ */
+void print_stats(Assembler *as)
+{
+    HashTableStats st;
+    unsigned long lookups, hits, misses;
+    uint32_t frozen;
+    size_t i;
+
+    lookups = as->cache_hits + as->cache_misses;
+    fprintf(stderr, "Instruction cache: %lu hits, %lu misses (%.1f%% hits)\n",
+            as->cache_hits, as->cache_misses,
+            lookups ? 100.0 * (double)as->cache_hits / (double)lookups : 0.0);
+
+    symbol_table_cache_stats(as->symbols, &hits, &misses);
+    fprintf(stderr, "Hot symbol cache: %lu hits, %lu misses (%.1f%% hits)\n",
+            hits, misses,
+            hits + misses ? 100.0 * (double)hits / (double)(hits + misses)
+                          : 0.0);
+
+    if ((frozen = symbol_table_frozen(as->symbols)) != 0) {
+        fprintf(stderr, "Frozen symbols: %u, in a minimal perfect hash\n",
+                frozen);
+    }
+    symbol_table_stats(as->symbols, &st);
+    fprintf(stderr, "%s: %zu symbols in %zu slots (load %.2f), "
+            "%zu tombstones\n", frozen ? "Side table" : "Symbol table",
+            st.nelems, st.nbuckets, st.load_factor, st.tombstones);
+    fprintf(stderr, "  chain length: max %zu, mean %.2f slots\n",
+            st.max_chain, st.mean_chain);
+    for (i = 0; i < HT_HISTOGRAM_SIZE; i++) {
+        if (st.histogram[i] != 0) {
+            fprintf(stderr, "  %s%zu: %zu\n",
+                    i == HT_HISTOGRAM_SIZE - 1 ? ">=" : "", i + 1,
+                    st.histogram[i]);
+        }
+    }
+    fprintf(stderr, "  %lu lookups, %lu probes, %lu compares "
+            "(%.2f probes, %.2f compares per lookup)\n",
+            st.lookups, st.probes, st.compares,
+            st.lookups ? (double)st.probes / (double)st.lookups : 0.0,
+            st.lookups ? (double)st.compares / (double)st.lookups : 0.0);
+    fprintf(stderr, "Text kernel: %s\n",
+            hacktext_kernel_name(hacktext_kernel()));
+}
+
+/*
+ * Writes the text map of the symbols to `map_name` with a `.sym` extension,
+ * and their binary snapshot with a `.symtab` one.
+ */
+void write_symbol_maps(Assembler *as)
+{
+    FILE *out;
+    char *path;
+    bool ok;
 
-    for (i = 0; i < WORD_WIDTH; i++) {
-        fputc((Instruction & mask) ? '1' : '0', OutputStream);
-        mask >>= 1;
+    if ((path = malloc(strlen(as->map_name) + sizeof(".symtab"))) == NULL) {
+        perror("malloc map path");
+        die(as);
+    }
+
+    sprintf(path, "%s.sym", as->map_name);
+    if ((out = fopen(path, "w")) == NULL) {
+        perror("write_symbol_maps");
+        free(path);
+        die(as);
+    }
+    ok = symmap_write_text(as->symbols, out);
+    if (fclose(out) != 0 || !ok) {
+        free(path);
+        die(as);
+    }
+
+    sprintf(path, "%s.symtab", as->map_name);
+    ok = symmap_write_snapshot(as->symbols, path);
+    free(path);
+    if (!ok) {
+        die(as);
     }
-    fputc('\n', OutputStream);
-    InstructionNumber++;
 }
 
 /*
  * Releases resources allocated by the program on abnormal termination. By
  * setting `errno` before calling `parser_destroy()`, the routine prints a
- * message with the current line being parsed.
+ * message with the current line being parsed.  Once the whole input was read,
+ * that line is the last one, whatever failed, so only the message is printed.
  */
-void die(void)
+void die(Assembler *as)
 {
+    size_t i;
 
-    fprintf(stderr, "Instruction %d.\n", InstructionNumber);
-    symbol_table_destroy();
+    fprintf(stderr, "Instruction %d.\n", as->instruction_number);
+    fixups_destroy(as->fixups);
+    free(as->program);
+    ir_destroy(as->ir);
+    instcache_destroy(as->cache);
+    free_chunks(as);
+    symbol_table_destroy(as->symbols);
+    for (i = 0; i < as->nformats; i++) {
+        emitter_destroy(as->emitters[i]);
+    }
     errno = ENOTRECOVERABLE;
-    parser_destroy();
-    if (fclose(OutputStream) == EOF) {
-        perror("die");
+    if (as->input_read) {
+        perror("Aborted translation");
+        errno = 0;
+    }
+    parser_destroy(as->parser);
+    for (i = 0; i < as->nformats; i++) {
+        if (as->outputs[i] != NULL && fclose(as->outputs[i]) == EOF) {
+            perror("die");
+        }
     }
     exit(EXIT_FAILURE);
 }
@@ -0,0 +1,330 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hacktext.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HACKTEXT_X86
+#include <immintrin.h>
+#endif
+
+#define DIGITS(b) { \
+    '0' + ((b) >> 7 & 1), '0' + ((b) >> 6 & 1), '0' + ((b) >> 5 & 1), \
+    '0' + ((b) >> 4 & 1), '0' + ((b) >> 3 & 1), '0' + ((b) >> 2 & 1), \
+    '0' + ((b) >> 1 & 1), '0' + ((b) & 1) }
+#define DIGITS4(b) DIGITS(b), DIGITS((b) + 1), DIGITS((b) + 2), DIGITS((b) + 3)
+#define DIGITS16(b) \
+    DIGITS4(b), DIGITS4((b) + 4), DIGITS4((b) + 8), DIGITS4((b) + 12)
+#define DIGITS64(b) \
+    DIGITS16(b), DIGITS16((b) + 16), DIGITS16((b) + 32), DIGITS16((b) + 48)
+
+#define NO_KERNEL (-1)
+
+
+/*********************************************************** Data Definitions */
+
+/*
+ * A kernel formats `n` words, and parses `nlines` lines returning how many were
+ * well formed before the first one that isn't.
+ */
+typedef void FormatKernel(const uint16_t *, size_t, char *);
+typedef size_t ParseKernel(const char *, size_t, uint16_t *);
+
+typedef struct kernel {
+    const char *name;
+    FormatKernel *format;
+    ParseKernel *parse;
+} Kernel;
+
+
+/******************************************************* Private Declarations */
+
+static FormatKernel format_scalar;
+static ParseKernel parse_scalar;
+#ifdef HACKTEXT_X86
+static FormatKernel format_sse2;
+static ParseKernel parse_sse2, parse_avx2;
+#endif
+static bool supported(HackTextKernel);
+static const Kernel *kernel_in_use(void);
+
+
+/********************************************************** Data declarations */
+
+/*
+ * The 8 digits of every byte, most significant first.
+ */
+static const char Digits[256][8] = {
+    DIGITS64(0), DIGITS64(64), DIGITS64(128), DIGITS64(192)
+};
+
+static const Kernel Kernels[] = {
+    [HACKTEXT_SCALAR] = {"scalar", format_scalar, parse_scalar},
+#ifdef HACKTEXT_X86
+    [HACKTEXT_SSE2] = {"sse2", format_sse2, parse_sse2},
+    [HACKTEXT_AVX2] = {"avx2", format_sse2, parse_avx2},
+#else
+    [HACKTEXT_SSE2] = {"sse2", format_scalar, parse_scalar},
+    [HACKTEXT_AVX2] = {"avx2", format_scalar, parse_scalar},
+#endif
+};
+
+/* `NO_KERNEL` until the first conversion, or `hacktext_select()` */
+static int Selected = NO_KERNEL;
+
+
+/***************************************************** Public Implementations */
+
+void
+hacktext_line(uint16_t word, char *line)
+{
+    memcpy(line, Digits[word >> 8], 8);
+    memcpy(line + 8, Digits[word & 0xFF], 8);
+    line[16] = '\n';
+}
+
+void
+hacktext_format(const uint16_t *words, size_t n, char *text)
+{
+    kernel_in_use()->format(words, n, text);
+}
+
+/*
+ * A trailing partial line is malformed, as is any line the kernel stops at.
+ */
+bool
+hacktext_parse(const char *text, size_t size, uint16_t *words, size_t *n)
+{
+    size_t nlines;
+
+    nlines = size / HACKTEXT_LINE;
+    *n = kernel_in_use()->parse(text, nlines, words);
+    if (*n != nlines || size % HACKTEXT_LINE != 0) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+bool
+hacktext_select(HackTextKernel kernel)
+{
+    if (!supported(kernel)) {
+        return false;
+    }
+    __atomic_store_n(&Selected, (int)kernel, __ATOMIC_RELAXED);
+    return true;
+}
+
+HackTextKernel
+hacktext_kernel(void)
+{
+    return (HackTextKernel)(kernel_in_use() - Kernels);
+}
+
+const char *
+hacktext_kernel_name(HackTextKernel kernel)
+{
+    return Kernels[kernel].name;
+}
+
+
+/**************************************************** Private implementations */
+
+static void
+format_scalar(const uint16_t *words, size_t n, char *text)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        hacktext_line(words[i], text + i * HACKTEXT_LINE);
+    }
+}
+
+static size_t
+parse_scalar(const char *text, size_t nlines, uint16_t *words)
+{
+    const char *line;
+    unsigned digit;
+    uint16_t word;
+    size_t i, j;
+
+    for (i = 0; i < nlines; i++) {
+        line = text + i * HACKTEXT_LINE;
+        for (word = 0, j = 0; j < 16; j++) {
+            if ((digit = (unsigned)(line[j] - '0')) > 1) {
+                return i;
+            }
+            word = (uint16_t)((unsigned)word << 1 | digit);
+        }
+        if (line[16] != '\n') {
+            return i;
+        }
+        words[i] = word;
+    }
+    return i;
+}
+
+#ifdef HACKTEXT_X86
+
+/*
+ * The single-bit masks of the digits of a line, most significant first, for
+ * the high byte then for the low byte.
+ */
+#define BIT_MASKS 1, 2, 4, 8, 16, 32, 64, (char)128, \
+                  1, 2, 4, 8, 16, 32, 64, (char)128
+
+/*
+ * Turns 16 copies of the bytes of a word, high byte first, into its digits.
+ */
+__attribute__((target("sse2")))
+static inline __m128i
+digits_sse2(__m128i bytes)
+{
+    const __m128i masks = _mm_set_epi8(BIT_MASKS);
+
+    return _mm_sub_epi8(_mm_set1_epi8('0'),
+                        _mm_cmpeq_epi8(_mm_and_si128(bytes, masks), masks));
+}
+
+__attribute__((target("sse2")))
+static inline void
+store_sse2(__m128i bytes, char *line)
+{
+    _mm_storeu_si128((__m128i *)line, digits_sse2(bytes));
+    line[16] = '\n';
+}
+
+/*
+ * The bytes of every word are swapped, high byte first, then unpacked with
+ * themselves three times over: 8 words, 4 pairs of them, 8 vectors of the 8
+ * copies of both bytes of a word.
+ */
+__attribute__((target("sse2")))
+static void
+format_sse2(const uint16_t *words, size_t n, char *text)
+{
+    __m128i x, lo, hi, q;
+    size_t i, k;
+
+    for (i = 0; i + 8 <= n; i += 8, text += 8 * HACKTEXT_LINE) {
+        x = _mm_loadu_si128((const __m128i *)(words + i));
+        x = _mm_or_si128(_mm_srli_epi16(x, 8), _mm_slli_epi16(x, 8));
+        lo = _mm_unpacklo_epi8(x, x);
+        hi = _mm_unpackhi_epi8(x, x);
+        for (k = 0; k < 4; k++) {
+            x = k < 2 ? lo : hi;
+            q = k % 2 ? _mm_unpackhi_epi16(x, x) : _mm_unpacklo_epi16(x, x);
+            store_sse2(_mm_unpacklo_epi32(q, q), text + 2 * k * HACKTEXT_LINE);
+            store_sse2(_mm_unpackhi_epi32(q, q),
+                       text + (2 * k + 1) * HACKTEXT_LINE);
+        }
+    }
+    format_scalar(words + i, n - i, text);
+}
+
+/*
+ * A well-formed line is all '0' and '1'.  Its bytes are reversed, first the
+ * two halves, then the 16-bit words within each, then the bytes within each
+ * word, so the move mask of the '1' puts the first digit in the top bit.
+ */
+__attribute__((target("sse2")))
+static size_t
+parse_sse2(const char *text, size_t nlines, uint16_t *words)
+{
+    __m128i x, ones;
+    const char *line;
+    size_t i;
+
+    for (i = 0; i < nlines; i++) {
+        line = text + i * HACKTEXT_LINE;
+        x = _mm_loadu_si128((const __m128i *)line);
+        ones = _mm_cmpeq_epi8(x, _mm_set1_epi8('1'));
+        if (_mm_movemask_epi8(_mm_or_si128(ones,
+                _mm_cmpeq_epi8(x, _mm_set1_epi8('0')))) != 0xFFFF ||
+            line[16] != '\n') {
+            return i;
+        }
+        ones = _mm_shuffle_epi32(ones, 0x4E);
+        ones = _mm_shufflelo_epi16(ones, 0x1B);
+        ones = _mm_shufflehi_epi16(ones, 0x1B);
+        ones = _mm_or_si128(_mm_srli_epi16(ones, 8), _mm_slli_epi16(ones, 8));
+        words[i] = (uint16_t)_mm_movemask_epi8(ones);
+    }
+    return i;
+}
+
+/*
+ * Two lines per iteration, one per lane.  A byte shuffle reverses each lane at
+ * once, and the move mask yields both words.
+ */
+__attribute__((target("avx2")))
+static size_t
+parse_avx2(const char *text, size_t nlines, uint16_t *words)
+{
+    const __m256i reverse = _mm256_set_epi8(
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m256i x, ones;
+    const char *line;
+    uint32_t bits;
+    size_t i;
+
+    for (i = 0; i + 2 <= nlines; i += 2) {
+        line = text + i * HACKTEXT_LINE;
+        x = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)line)),
+                _mm_loadu_si128((const __m128i *)(line + HACKTEXT_LINE)), 1);
+        ones = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('1'));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(ones,
+                _mm256_cmpeq_epi8(x, _mm256_set1_epi8('0')))) != 0xFFFFFFFF ||
+            line[16] != '\n' || line[HACKTEXT_LINE + 16] != '\n') {
+            break;
+        }
+        bits = (uint32_t)_mm256_movemask_epi8(_mm256_shuffle_epi8(ones,
+                                                                  reverse));
+        words[i] = (uint16_t)bits;
+        words[i + 1] = (uint16_t)(bits >> 16);
+    }
+    return i + parse_sse2(text + i * HACKTEXT_LINE, nlines - i, words + i);
+}
+
+#endif /* HACKTEXT_X86 */
+
+static bool
+supported(HackTextKernel kernel)
+{
+#ifdef HACKTEXT_X86
+    __builtin_cpu_init();
+    switch (kernel) {
+    case HACKTEXT_SCALAR:
+        return true;
+    case HACKTEXT_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case HACKTEXT_AVX2:
+        return __builtin_cpu_supports("avx2");
+    }
+    return false;
+#else
+    return kernel == HACKTEXT_SCALAR;
+#endif
+}
+
+/*
+ * Picks the widest kernel supported on first use, which is also the fastest:
+ * the AVX2 one only differs in parsing.  Threads racing to do it all pick the
+ * same.
+ */
+static const Kernel *
+kernel_in_use(void)
+{
+    int k;
+
+    if ((k = __atomic_load_n(&Selected, __ATOMIC_RELAXED)) == NO_KERNEL) {
+        for (k = HACKTEXT_AVX2; !supported((HackTextKernel)k); k--)
+            ;
+        __atomic_store_n(&Selected, k, __ATOMIC_RELAXED);
+    }
+    return &Kernels[k];
+}
@@ -0,0 +1,252 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hashfuncs.h"
+
+/*
+ * The CRC32C kernel is written with GCC/Clang intrinsics and target
+ * attributes.  Elsewhere, only the bytewise version is built.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_SSE42 1
+#include <immintrin.h>
+#endif
+
+#define DEFAULT_HASH "wyhash"       /* See `make bench` */
+
+#define CRC32C_POLY 0x82F63B78U     /* Castagnoli, reflected */
+
+#define WY_SECRET0 0xa0761d6478bd642fULL
+#define WY_SECRET1 0xe7037ed1a0b428dbULL
+
+
+/********************************************************** Data declarations */
+
+static HashFunction djb2, fnv1a, crc32c_bytewise;
+#ifdef HAVE_SSE42
+static HashFunction crc32c_sse42;
+#endif
+
+typedef struct Named {
+    const char *name;
+    HashFunction *fn;
+} Named;
+
+static const Named Suite[] = {
+    {"djb2",   djb2},
+    {"fnv1a",  fnv1a},
+    {"wyhash", hash_wyhash},
+    {"crc32c", crc32c_bytewise},    /* Swapped for the SSE4.2 kernel */
+};
+
+
+/******************************************************* Private Declarations */
+
+static inline uint64_t read64(const unsigned char *);
+static inline uint64_t read32(const unsigned char *);
+static inline uint64_t mum(uint64_t, uint64_t);
+
+
+/***************************************************** Public Implementations */
+
+HashFunction *
+hash_select(const char *name)
+{
+    size_t i;
+
+    if (name == NULL) {
+        name = DEFAULT_HASH;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(Suite); i++) {
+        if (strcmp(name, Suite[i].name) != 0) {
+            continue;
+        }
+#ifdef HAVE_SSE42
+        if (Suite[i].fn == crc32c_bytewise) {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("sse4.2")) {
+                return crc32c_sse42;
+            }
+        }
+#endif
+        return Suite[i].fn;
+    }
+
+    errno = EINVAL;
+    return NULL;
+}
+
+const char *
+hash_name(size_t i)
+{
+    return i < ARRAY_SIZE(Suite) ? Suite[i].name : NULL;
+}
+
+/*
+ * A reduced wyhash: keys are consumed 16 bytes per round, and the last 16
+ * bytes, or the whole key when shorter, are read as two overlapping words.
+ * Symbols are short, most keys take a single round.
+ * https://github.com/wangyi-fudan/wyhash
+ */
+size_t
+hash_wyhash(const void *key, size_t size)
+{
+    const unsigned char *p = key;
+    uint64_t seed, a, b;
+    size_t i;
+
+    seed = mum(WY_SECRET0, WY_SECRET1);
+
+    if (size <= 16) {
+        if (size >= 4) {
+            a = read32(p) << 32 | read32(p + ((size >> 3) << 2));
+            b = read32(p + size - 4) << 32 |
+                read32(p + size - 4 - ((size >> 3) << 2));
+        } else if (size > 0) {
+            a = (uint64_t)p[0] << 16 | (uint64_t)p[size >> 1] << 8 |
+                p[size - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        for (i = size; i > 16; i -= 16, p += 16) {
+            seed = mum(read64(p) ^ WY_SECRET1, read64(p + 8) ^ seed);
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    return (size_t)mum(WY_SECRET1 ^ size, mum(a ^ WY_SECRET1, b ^ seed));
+}
+
+
+/**************************************************** Private implementations */
+
+/*
+ * http://www.cse.yorku.ca/~oz/hash.html
+ */
+static size_t
+djb2(const void *key, size_t size)
+{
+    const unsigned char *p = key;
+    uint64_t hash = 5381;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash = ((hash << 5) + hash) + p[i]; /* hash * 33 + c */
+    }
+    return (size_t)hash;
+}
+
+/*
+ * http://www.isthe.com/chongo/tech/comp/fnv/
+ */
+static size_t
+fnv1a(const void *key, size_t size)
+{
+    const unsigned char *p = key;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return (size_t)hash;
+}
+
+/*
+ * CRC32C, one byte at a time.
+ */
+static size_t
+crc32c_bytewise(const void *key, size_t size)
+{
+    const unsigned char *p = key;
+    uint32_t crc = 0xFFFFFFFFU;
+    size_t i;
+    int k;
+
+    for (i = 0; i < size; i++) {
+        crc ^= p[i];
+        for (k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0U - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+#ifdef HAVE_SSE42
+/*
+ * CRC32C, eight bytes at a time, then the remaining bytes one by one.  The
+ * same value as `crc32c_bytewise()`.
+ */
+__attribute__((target("sse4.2"))) static size_t
+crc32c_sse42(const void *key, size_t size)
+{
+    const unsigned char *p = key;
+    uint32_t crc = 0xFFFFFFFFU;
+    size_t i = 0;
+
+#ifdef __x86_64__
+    for ( ; i + 8 <= size; i += 8) {
+        crc = (uint32_t)_mm_crc32_u64(crc, read64(p + i));
+    }
+#endif
+    for ( ; i < size; i++) {
+        crc = _mm_crc32_u8(crc, p[i]);
+    }
+    return ~crc;
+}
+#endif
+
+/*
+ * Unaligned little-endian reads.  `memcpy()` compiles down to a single load.
+ */
+static inline uint64_t
+read64(const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t
+read32(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * Multiplies into 128 bits and folds the halves together.  Without a 128-bit
+ * type, as on 32-bit targets, the product is put together from the four
+ * products of the 32-bit halves.
+ */
+static inline uint64_t
+mum(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint128;
+    uint128 r = (uint128)a * b;
+
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+    uint64_t ll, lh, hl, hh, mid, lo, hi;
+
+    ll = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    lh = (a & 0xFFFFFFFF) * (b >> 32);
+    hl = (a >> 32) * (b & 0xFFFFFFFF);
+    hh = (a >> 32) * (b >> 32);
+    mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+    lo = (mid << 32) | (ll & 0xFFFFFFFF);
+    hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+
+    return lo ^ hi;
+#endif
+}
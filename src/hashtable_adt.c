@@ -1,131 +1,244 @@
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "hashtable_adt.h"
 
+#define GROUP_WIDTH 16          /* Control bytes probed at once */
+#define MIN_CAPACITY 16         /* One group */
+#define MAX_LOAD_NUM 7          /* Maximum load factor of 7/8 */
+#define MAX_LOAD_DEN 8
+#define KEY_BLOCK_SIZE 4096     /* Bytes of a block of key copies */
+#define MIGRATE_STEP 64         /* Old slots migrated per insertion */
+
+/*
+ * Counters are bumped with relaxed atomic loads and stores rather than atomic
+ * increments: no data race when lookups run on several threads, at the price
+ * of an increment lost now and then.  They are statistics, not bookkeeping.
+ */
+#define COUNT(counter, n) \
+    __atomic_store_n(&(counter), \
+                     __atomic_load_n(&(counter), __ATOMIC_RELAXED) + (n), \
+                     __ATOMIC_RELAXED)
+
+/*
+ * Control byte values.  A full slot holds the low 7 bits of its hash, so the
+ * top bit tells free slots apart.
+ */
+#define CTRL_EMPTY   0x80       /* Never used, ends a probe sequence */
+#define CTRL_DELETED 0xFE       /* Tombstone, probing goes on past it */
+
 
 /*********************************************************** Data Definitions */
 
 /*
- * A hash table `Entry` is a list in which each element is:
+ * A hash table `Slot` holds:
  */
-typedef struct entry {
+typedef struct slot {
+    size_t hash;              /* Mixed hash of the key, kept for rehashing */
+    const char *key;          /* Copy of the key the client used at insertion */
     size_t key_size;          /* Key size */
-    char *key;                /* Copy of the key the client used at insertion */
     void *item;               /* A void pointer to the item held */
-    struct entry *next;       /* A self-referential pointer */
-} Entry;
+} Slot;
+
+/*
+ * The slots are a single flat array split into groups of `GROUP_WIDTH`.  The
+ * control byte `ctrl[i]` describes `slots[i]`, so a whole group can be matched
+ * against a 7-bit hash fragment with one vector compare, and only the slots
+ * whose fragment matches are ever touched.
+ */
+typedef struct slot_array {
+    size_t capacity;        /* Number of slots, a power of two */
+    size_t growth_left;     /* Empty slots that can be used before rehashing */
+    uint8_t *ctrl;          /* Control byte of every slot */
+    Slot *slots;            /* Dynamically allocated array of `Slot` */
+} SlotArray;
+
+/*
+ * Keys are copied back to back into blocks that never move, so slots can point
+ * to them.  A key larger than a block gets one of its own.
+ */
+typedef struct key_block {
+    struct key_block *next;   /* Previous block */
+    size_t size;              /* Usable bytes */
+    size_t used;              /* Bytes holding keys */
+    char data[];
+} KeyBlock;
+
+/*
+ * Cumulative counters of the searches of the table.
+ */
+typedef struct counters {
+    unsigned long lookups;    /* Searches for a key */
+    unsigned long probes;     /* Groups visited */
+    unsigned long compares;   /* Keys compared */
+} Counters;
 
 /*
  * Datatype completion for `HashTableADT`:
+ *
+ * Once `cur` reaches the maximum load, it becomes `old` and new elements go to
+ * a fresh `cur`, twice as large.  Every insertion then moves `MIGRATE_STEP`
+ * old slots across, so the rehash is spread over many insertions instead of
+ * stalling a single one.  Until `old` is empty both arrays are searched.
  */
 struct hash_table_type {
-    size_t curr_buckets;    /* Current number of buckets */
-    size_t init_buckets;    /* Initial number of buckets */
+    Allocator mem;          /* Where every block of the table comes from */
+    SlotArray cur;          /* Slots new elements go to */
+    SlotArray old;          /* Slots being migrated, no capacity if none */
+    size_t migrated;        /* Old slots migrated so far */
     size_t nelems;          /* Number of elements */
     HashFunction *hash;     /* Pointer to function of type `HashFunction` */
-    Entry **entries;        /* Dynamically allocated array of `Entry` */
+    KeyBlock *keys;         /* Block the next key is copied to */
+    Counters counters;
 };
 
 
-/******************************************************* Private Declarations */ 
+/******************************************************* Private Declarations */
 
 static inline size_t calculate_key_hash(HashTableADT *, const void *, size_t);
-static inline bool is_prime(size_t);
-static inline size_t get_next_prime(size_t);
+static inline uint32_t match_byte(const uint8_t *, uint8_t);
+static inline uint32_t match_free(const uint8_t *);
+static long find_slot(HashTableADT *, const SlotArray *, const void *, size_t,
+                      size_t);
+static size_t probe_length(const SlotArray *, size_t);
+static void array_stats(const SlotArray *, HashTableStats *, size_t *);
+static size_t find_insert_slot(const SlotArray *, size_t);
+static bool alloc_slots(HashTableADT *, SlotArray *, size_t);
+static void release_slots(HashTableADT *, SlotArray *);
+static bool start_rehash(HashTableADT *);
+static void migrate(HashTableADT *, size_t);
+static const char *store_key(HashTableADT *, const void *, size_t);
+static inline size_t max_load(size_t);
+static void *heap_alloc(void *, size_t);
+static void heap_release(void *, void *);
+
+
+/********************************************************** Data declarations */
+
+static const Allocator Heap = {heap_alloc, heap_release, NULL};
 
 
 /***************************************************** Public Implementations */
 
 /*
- * Create a hash table 
+ * Create a hash table
  */
 HashTableADT *
-cadthashtable_new(size_t nbuckets, HashFunction *fp)
+cadthashtable_new(size_t nbuckets, HashFunction *fp, const Allocator *mem)
 {
     HashTableADT *new;
+    size_t capacity;
 
     if (nbuckets == 0 || fp == NULL) {
         errno = EINVAL;
         return NULL;
     }
-    
-    if ((new = malloc(sizeof(struct hash_table_type))) == NULL) { 
-        perror("cadthashtable_new malloc failed allocating struct hash_table_type");
-        errno = ENOMEM;
-        return NULL;
+    if (mem == NULL) {
+        mem = &Heap;
     }
-    
-    if ((new->entries = calloc(nbuckets, sizeof(Entry*))) == NULL) {
-        perror("cadthashtable_new calloc failed allocating entry array");
-        free(new);
+
+    if ((new = mem->alloc(mem->ctx, sizeof(struct hash_table_type))) == NULL) {
+        perror("cadthashtable_new failed allocating struct hash_table_type");
         errno = ENOMEM;
         return NULL;
     }
+    memset(new, 0, sizeof(struct hash_table_type));
+    new->mem = *mem;
 
-    nbuckets = get_next_prime(nbuckets);
+    for (capacity = MIN_CAPACITY; max_load(capacity) < nbuckets; capacity *= 2)
+        ;
 
-    new->curr_buckets = nbuckets;
-    new->init_buckets = nbuckets;
-    new->nelems = 0;
+    if (!alloc_slots(new, &new->cur, capacity)) {
+        perror("cadthashtable_new failed allocating slot array");
+        mem->release(mem->ctx, new);
+        errno = ENOMEM;
+        return NULL;
+    }
     new->hash = fp;
 
     return new;
 }
-    
+
 /*
  * Destroy hash table
  */
-void 
-cadthashtable_destroy(HashTableADT *ht) 
+void
+cadthashtable_destroy(HashTableADT *ht)
 {
-    free(ht->entries);
-    free(ht);
+    KeyBlock *b, *next;
+
+    if (ht == NULL) {
+        return;
+    }
+    for (b = ht->keys; b != NULL; b = next) {
+        next = b->next;
+        ht->mem.release(ht->mem.ctx, b);
+    }
+    release_slots(ht, &ht->old);
+    release_slots(ht, &ht->cur);
+    ht->mem.release(ht->mem.ctx, ht);
     return;
 }
 
 /*
- * Insert operation
+ * Insert operation.  Once the maximum load is reached, a rehash into twice as
+ * many slots starts, or into as many if half the used ones are tombstones.
  */
 void *
-cadthashtable_insert(HashTableADT *ht, const void *key, size_t key_size, void *e) 
+cadthashtable_insert(HashTableADT *ht, const void *key, size_t key_size,
+                     void *e)
 {
-    size_t index;
-    Entry* new;
+    size_t hash, index;
+    const char *copy;
 
     if (ht == NULL || key == NULL || key_size == 0 || e == NULL) {
         errno = EINVAL;
         return NULL;
     }
 
-    if (cadthashtable_lookup(ht, key, key_size) != NULL) {
+    hash = calculate_key_hash(ht, key, key_size);
+    COUNT(ht->counters.lookups, 1);
+    if (find_slot(ht, &ht->cur, key, key_size, hash) >= 0 ||
+        find_slot(ht, &ht->old, key, key_size, hash) >= 0) {
         errno = EEXIST;
         return NULL;
     }
 
-    if ((new = malloc(sizeof(Entry))) == NULL) { 
-        perror("cadthashtable_insert malloc failed allocating struct entry");
-        errno = ENOMEM;
-        return NULL;
+    migrate(ht, MIGRATE_STEP);
+
+    index = find_insert_slot(&ht->cur, hash);
+    if (ht->cur.growth_left == 0 && ht->cur.ctrl[index] == CTRL_EMPTY) {
+        if (!start_rehash(ht)) {
+            perror("cadthashtable_insert failed growing slot array");
+            errno = ENOMEM;
+            return NULL;
+        }
+        migrate(ht, MIGRATE_STEP);
+        index = find_insert_slot(&ht->cur, hash);
     }
-    if ((new->key = malloc(key_size)) == NULL) {
-        perror("cadthashtable_insert malloc failed allocating new->key");
-        free(new);
+
+    if ((copy = store_key(ht, key, key_size)) == NULL) {
+        perror("cadthashtable_insert failed allocating key block");
         errno = ENOMEM;
         return NULL;
     }
 
-    index = calculate_key_hash(ht, key, key_size);
-    memcpy(new->key, key, key_size);
-    new->key_size = key_size; 
-    new->item = e; 
-
-    /* Insert entry */
-    new->next = ht->entries[index];
-    ht->entries[index] = new;
+    if (ht->cur.ctrl[index] == CTRL_EMPTY) {
+        ht->cur.growth_left--;
+    }
+    ht->cur.ctrl[index] = (uint8_t)(hash & 0x7F);
+    ht->cur.slots[index].hash = hash;
+    ht->cur.slots[index].key = copy;
+    ht->cur.slots[index].key_size = key_size;
+    ht->cur.slots[index].item = e;
     ht->nelems++;
 
     return e;
@@ -137,121 +250,425 @@ cadthashtable_insert(HashTableADT *ht, const void *key, size_t key_size, void *e
 void *
 cadthashtable_lookup(HashTableADT *ht, const void *key, size_t key_size)
 {
-    size_t index;
-    Entry *e;
+    size_t hash;
+    long index;
 
     if (ht == NULL || key == NULL || key_size == 0) {
         errno = EINVAL;
         return NULL;
     }
 
-    index = calculate_key_hash(ht, key, key_size);
-    e = ht->entries[index];
+    hash = calculate_key_hash(ht, key, key_size);
+    COUNT(ht->counters.lookups, 1);
+
+    if ((index = find_slot(ht, &ht->cur, key, key_size, hash)) >= 0) {
+        return ht->cur.slots[index].item;
+    }
+    if ((index = find_slot(ht, &ht->old, key, key_size, hash)) >= 0) {
+        return ht->old.slots[index].item;
+    }
+    return NULL;
+}
+
+/*
+ * Removes an entry from the slot arrays returning the entry's item on success.
+ * A probe sequence only stops at a group with an empty slot, so the slot can
+ * go back to empty if its group already has one, and becomes a tombstone
+ * otherwise.  The copy of the key is only released with the table.
+ */
+void *
+cadthashtable_delete(HashTableADT *ht, void *key, size_t key_size, void *e)
+{
+    SlotArray *a;
+    size_t hash, group;
+    long index;
 
-    if (e == NULL) {
+    if (ht == NULL || key == NULL || key_size == 0 || e == NULL) {
+        errno = EINVAL;
         return NULL;
     }
 
-    while (e != NULL) {
-        if (e->key_size == key_size && memcmp(e->key, key, key_size) == 0) {
-            break;
+    hash = calculate_key_hash(ht, key, key_size);
+    COUNT(ht->counters.lookups, 1);
+
+    a = &ht->cur;
+    if ((index = find_slot(ht, a, key, key_size, hash)) < 0) {
+        a = &ht->old;
+        if ((index = find_slot(ht, a, key, key_size, hash)) < 0) {
+            return NULL;
         }
-        e = e->next;
     }
 
-    if (e == NULL) {
-        return NULL;
-    }
-    else {
-        return e->item;
+    group = (size_t)index & ~(size_t)(GROUP_WIDTH - 1);
+    if (match_byte(&a->ctrl[group], CTRL_EMPTY) != 0) {
+        a->ctrl[index] = CTRL_EMPTY;
+        a->growth_left++;
+    } else {
+        a->ctrl[index] = CTRL_DELETED;
     }
+    ht->nelems--;
+
+    return a->slots[index].item;
 }
 
 /*
- * Removes a (possible chained) entry from the entries array returning the
- * entry's item on success.
+ * The structure is measured on the spot, walking the slots.  Only the counters
+ * are kept along the way.
  */
-void *
-cadthashtable_delete(HashTableADT *ht, void *key, size_t key_size, void *e)
+void
+cadthashtable_stats(HashTableADT *ht, HashTableStats *stats)
 {
-	size_t index;
-    Entry **pp;
-    void *deleted_item;
+    size_t total;
 
-    if (ht == NULL || key == NULL || key_size == 0 || e == NULL) {
+    memset(stats, 0, sizeof(HashTableStats));
+    if (ht == NULL) {
         errno = EINVAL;
-        return NULL;
+        return;
     }
 
-    index = calculate_key_hash(ht, key, key_size);
-    pp = &(ht->entries[index]);
+    total = 0;
+    array_stats(&ht->cur, stats, &total);
+    array_stats(&ht->old, stats, &total);
+
+    stats->nelems = ht->nelems;
+    stats->nbuckets = ht->cur.capacity + ht->old.capacity;
+    stats->load_factor = (double)ht->nelems / (double)stats->nbuckets;
+    stats->mean_chain = ht->nelems ? (double)total / (double)ht->nelems : 0.0;
+    stats->lookups = __atomic_load_n(&ht->counters.lookups, __ATOMIC_RELAXED);
+    stats->probes = __atomic_load_n(&ht->counters.probes, __ATOMIC_RELAXED);
+    stats->compares = __atomic_load_n(&ht->counters.compares, __ATOMIC_RELAXED);
+}
+
+/**************************************************** Private Implementations */
+
+/*
+ * Returns the hash of a given key using the hash function specified by the
+ * client when creating the hash table.  The result is multiplied by the golden
+ * ratio so that both the low bits, stored in the control bytes, and the high
+ * bits, choosing the group, depend on the whole key.
+ */
+static inline size_t
+calculate_key_hash(HashTableADT *ht, const void *key, size_t key_size)
+{
+    uint64_t hash;
+
+    hash = (uint64_t)ht->hash(key, key_size) * 0x9E3779B97F4A7C15ULL;
 
-	while (*pp) {
-        if ((*pp)->key_size == key_size && memcmp((*pp)->key, key, key_size) == 0) {
-            Entry *temp = *pp;
-            *pp = temp->next;
-            deleted_item = temp->item;
+    return (size_t)(hash ^ hash >> 32);
+}
 
-            free(temp->key);
-            free(temp);
-            ht->nelems--;
+/*
+ * Returns a bit mask with bit `i` set if the control byte `group[i]` equals
+ * `byte`, for the `GROUP_WIDTH` bytes at `group`.
+ */
+static inline uint32_t
+match_byte(const uint8_t *group, uint8_t byte)
+{
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl,
+                                            _mm_set1_epi8((char)byte)));
+#else
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(group[i] == byte) << i;
+    }
+    return mask;
+#endif
+}
+
+/*
+ * As `match_byte()`, for empty and deleted slots: the ones whose control byte
+ * has the top bit set.
+ */
+static inline uint32_t
+match_free(const uint8_t *group)
+{
+#ifdef __SSE2__
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(group[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
 
-            return deleted_item;
+/*
+ * Returns the index of the slot of `a` holding `key`, or -1 if it isn't there.
+ *
+ * The high bits of the hash choose the first group, and the next groups are
+ * visited at triangular offsets, which cover every group of a power of two
+ * array.  Within a group only the slots matching the 7-bit fragment have their
+ * keys compared, and the first group with an empty slot ends the search.
+ */
+static long
+find_slot(HashTableADT *ht, const SlotArray *a, const void *key,
+          size_t key_size, size_t hash)
+{
+    size_t ngroups, group, step, index;
+    unsigned long compares = 0;
+    const uint8_t *ctrl;
+    const Slot *slot;
+    uint32_t match;
+    long found = -1;
+
+    ngroups = a->capacity / GROUP_WIDTH;
+    group = (hash >> 7) & (ngroups - 1);
+
+    for (step = 1; step <= ngroups && found < 0; step++) {
+        ctrl = &a->ctrl[group * GROUP_WIDTH];
+
+        for (match = match_byte(ctrl, (uint8_t)(hash & 0x7F)); match != 0;
+             match &= match - 1) {
+            index = group * GROUP_WIDTH + (size_t)__builtin_ctz(match);
+            slot = &a->slots[index];
+            compares++;
+            if (slot->hash == hash && slot->key_size == key_size &&
+                memcmp(slot->key, key, key_size) == 0) {
+                found = (long)index;
+                break;
+            }
         }
-        pp = &((*pp)->next);
+        if (match_byte(ctrl, CTRL_EMPTY) != 0) {
+            step++;
+            break;
+        }
+        group = (group + step) & (ngroups - 1);
     }
 
-	return NULL;
+    if (ngroups != 0) {
+        COUNT(ht->counters.probes, step - 1);
+        COUNT(ht->counters.compares, compares);
+    }
+    return found;
 }
 
-/**************************************************** Private Implementations */ 
+/*
+ * Number of groups the probe sequence of the element at `index` visits to
+ * reach it: the open addressing counterpart of the length of its chain.
+ */
+static size_t
+probe_length(const SlotArray *a, size_t index)
+{
+    size_t ngroups, group, step;
+
+    ngroups = a->capacity / GROUP_WIDTH;
+    group = (a->slots[index].hash >> 7) & (ngroups - 1);
+
+    for (step = 1; group != index / GROUP_WIDTH; step++) {
+        group = (group + step) & (ngroups - 1);
+    }
+    return step;
+}
 
 /*
- * Returns the hash index for a given key using the hash function specified by
- * the client when creating the hash table.
+ * Adds the probe lengths of the elements of `a` to the histogram, maximum and
+ * `total` of `stats`, and counts its tombstones.
  */
-static inline size_t 
-calculate_key_hash(HashTableADT *ht, const void *key, size_t key_size)
+static void
+array_stats(const SlotArray *a, HashTableStats *stats, size_t *total)
+{
+    size_t i, length;
+
+    for (i = 0; i < a->capacity; i++) {
+        if (a->ctrl[i] == CTRL_DELETED) {
+            stats->tombstones++;
+        }
+        if (a->ctrl[i] & 0x80) {
+            continue;
+        }
+        length = probe_length(a, i);
+        *total += length;
+        if (length > stats->max_chain) {
+            stats->max_chain = length;
+        }
+        if (length > HT_HISTOGRAM_SIZE) {
+            length = HT_HISTOGRAM_SIZE;
+        }
+        stats->histogram[length - 1]++;
+    }
+}
+
+/*
+ * Returns the first empty or deleted slot of the probe sequence of `hash`.
+ * There always is one: the maximum load keeps some slots empty.
+ */
+static size_t
+find_insert_slot(const SlotArray *a, size_t hash)
 {
-    size_t index;
+    size_t ngroups, group, step;
+    uint32_t match;
 
-    index = (ht->hash(key, key_size)) % ht->curr_buckets;
+    ngroups = a->capacity / GROUP_WIDTH;
+    group = (hash >> 7) & (ngroups - 1);
 
-    return index;
+    for (step = 1; ; step++) {
+        if ((match = match_free(&a->ctrl[group * GROUP_WIDTH])) != 0) {
+            return group * GROUP_WIDTH + (size_t)__builtin_ctz(match);
+        }
+        group = (group + step) & (ngroups - 1);
+    }
 }
 
 /*
- * Primality test
+ * Allocates `capacity` empty slots into `a`.  Returns `false` on failure,
+ * leaving `a` untouched.
  */
-static inline bool 
-is_prime(size_t n)
+static bool
+alloc_slots(HashTableADT *ht, SlotArray *a, size_t capacity)
 {
-    size_t i; 
+    uint8_t *ctrl;
+    Slot *slots;
+
+    if ((ctrl = ht->mem.alloc(ht->mem.ctx, capacity)) == NULL) {
+        return false;
+    }
+    if ((slots = ht->mem.alloc(ht->mem.ctx, capacity * sizeof(Slot))) == NULL) {
+        ht->mem.release(ht->mem.ctx, ctrl);
+        return false;
+    }
+    memset(ctrl, CTRL_EMPTY, capacity);
+
+    a->ctrl = ctrl;
+    a->slots = slots;
+    a->capacity = capacity;
+    a->growth_left = max_load(capacity);
+    return true;
+}
 
-    if (n == 2 || n == 3) {
-        return true;
+static void
+release_slots(HashTableADT *ht, SlotArray *a)
+{
+    if (a->capacity == 0) {
+        return;
     }
+    ht->mem.release(ht->mem.ctx, a->ctrl);
+    ht->mem.release(ht->mem.ctx, a->slots);
+    memset(a, 0, sizeof(SlotArray));
+}
+
+/*
+ * Turns the full `cur` into `old` and allocates a fresh `cur`: twice as large,
+ * or as large if the elements fill less than half the maximum load, the rest
+ * being tombstones.  The growth left in `cur` always outlasts the previous
+ * migration, but it is finished first in any case.  Returns `false` on
+ * failure, leaving the table untouched.
+ */
+static bool
+start_rehash(HashTableADT *ht)
+{
+    SlotArray fresh;
+    size_t capacity;
+
+    migrate(ht, ht->old.capacity);
 
-    if (n <= 1 || n % 2 == 0 || n % 3 == 0) {
+    capacity = ht->cur.capacity;
+    if (ht->nelems >= max_load(capacity) / 2) {
+        capacity *= 2;
+    }
+    if (!alloc_slots(ht, &fresh, capacity)) {
         return false;
     }
+    ht->old = ht->cur;
+    ht->cur = fresh;
+    ht->migrated = 0;
+    return true;
+}
+
+/*
+ * Moves the elements of the next `count` old slots into `cur`, leaving
+ * tombstones behind so that lookups still probe past them.  Releases the old
+ * slots once they are all migrated.
+ */
+static void
+migrate(HashTableADT *ht, size_t count)
+{
+    size_t end, index;
+
+    if (ht->old.capacity == 0) {
+        return;
+    }
+
+    end = ht->migrated + count;
+    if (end > ht->old.capacity) {
+        end = ht->old.capacity;
+    }
 
-    for (i = 5; i * i <= n; i += 6) {
-        if (n % i == 0 || n % (i + 2) == 0) {
-            return false;
+    for ( ; ht->migrated < end; ht->migrated++) {
+        if (ht->old.ctrl[ht->migrated] & 0x80) {
+            continue;
         }
+        index = find_insert_slot(&ht->cur, ht->old.slots[ht->migrated].hash);
+        if (ht->cur.ctrl[index] == CTRL_EMPTY) {
+            ht->cur.growth_left--;
+        }
+        ht->cur.ctrl[index] = ht->old.ctrl[ht->migrated];
+        ht->cur.slots[index] = ht->old.slots[ht->migrated];
+        ht->old.ctrl[ht->migrated] = CTRL_DELETED;
+    }
+
+    if (ht->migrated == ht->old.capacity) {
+        release_slots(ht, &ht->old);
     }
-    return true;
 }
 
 /*
- * Returns the closest prime greater than or equal to `n`.
+ * Appends a copy of the key to the current key block, or to a new one if it
+ * doesn't fit.  Returns `NULL` on failure.
  */
-static inline size_t 
-get_next_prime(size_t n)
+static const char *
+store_key(HashTableADT *ht, const void *key, size_t key_size)
 {
-    while (is_prime(n) == false) {
-        n++;
+    KeyBlock *b = ht->keys;
+    size_t size;
+    char *copy;
+
+    if (b == NULL || b->size - b->used < key_size) {
+        size = key_size > KEY_BLOCK_SIZE ? key_size : KEY_BLOCK_SIZE;
+        if ((b = ht->mem.alloc(ht->mem.ctx, sizeof(KeyBlock) + size)) == NULL) {
+            return NULL;
+        }
+        b->next = ht->keys;
+        b->size = size;
+        b->used = 0;
+        ht->keys = b;
     }
-    return n;
+
+    copy = b->data + b->used;
+    memcpy(copy, key, key_size);
+    b->used += key_size;
+    return copy;
+}
+
+/*
+ * Number of elements an array of `capacity` slots holds before rehashing.
+ */
+static inline size_t
+max_load(size_t capacity)
+{
+    return capacity / MAX_LOAD_DEN * MAX_LOAD_NUM;
+}
+
+/*
+ * The default allocator, when the client passes none.
+ */
+static void *
+heap_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+static void
+heap_release(void *ctx, void *ptr)
+{
+    (void)ctx;
+    free(ptr);
 }
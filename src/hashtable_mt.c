@@ -0,0 +1,318 @@
+#define _POSIX_C_SOURCE 200809L     /* posix_memalign(), pthreads */
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "hashtable_mt.h"
+
+#define STRIPE_BITS 6           /* log2(HT_MT_STRIPES) */
+#define MIN_CAPACITY 8          /* Slots of a stripe, a power of two */
+#define MAX_LOAD_NUM 3          /* Maximum load factor of 3/4 */
+#define MAX_LOAD_DEN 4
+#define STRIPE_ARENA_BLOCK 4096 /* Keys are short, most stripes stay small */
+#define CACHE_LINE 64
+
+
+/*********************************************************** Data Definitions */
+
+/*
+ * A slot is empty while `key` is `NULL`.  `key` is the last field written, with
+ * a release store, and the first one read, with an acquire load: a reader that
+ * sees it sees the rest of the slot.  None of them changes afterwards.
+ */
+typedef struct slot {
+    const char *key;          /* Copy of the key, published last */
+    uint64_t hash;            /* Mixed hash of the key */
+    size_t key_size;          /* Key size */
+    void *item;               /* A void pointer to the item held */
+} Slot;
+
+/*
+ * Linearly probed slots of a stripe.  Replaced, never resized in place.
+ */
+typedef struct slot_array {
+    size_t mask;              /* Number of slots minus one */
+    Slot slots[];
+} SlotArray;
+
+/*
+ * A stripe owns its slots, and an arena its key copies and every array it ever
+ * published come from.  Stripes are aligned to cache lines, so threads
+ * inserting into different ones don't bounce each other's lock.
+ */
+typedef struct stripe {
+    pthread_mutex_t lock;     /* Held by insertions */
+    SlotArray *array;         /* Published with a release store */
+    size_t count;             /* Elements, written under `lock` */
+    Arena *arena;             /* Keys and arrays, released at destroy */
+} __attribute__((aligned(CACHE_LINE))) Stripe;
+
+/*
+ * Datatype completion for `HashTableMT`:
+ */
+struct hash_table_mt_type {
+    Stripe stripes[HT_MT_STRIPES];
+    HashFunction *hash;       /* Pointer to function of type `HashFunction` */
+};
+
+
+/******************************************************* Private Declarations */
+
+static inline uint64_t calculate_key_hash(HashTableMT *, const void *, size_t);
+static inline Stripe *stripe_of(HashTableMT *, uint64_t);
+static const Slot *find(const SlotArray *, const void *, size_t, uint64_t);
+static SlotArray *new_array(Stripe *, size_t);
+static bool grow(Stripe *);
+static inline size_t max_load(size_t);
+
+
+/***************************************************** Public Implementations */
+
+HashTableMT *
+cadthashtable_mt_new(size_t nbuckets, HashFunction *fp)
+{
+    HashTableMT *ht;
+    size_t capacity, i;
+    Stripe *s;
+
+    if (nbuckets == 0 || fp == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    /* `malloc()` only guarantees 16 bytes of alignment, stripes need more */
+    if (posix_memalign((void **)&ht, CACHE_LINE, sizeof(HashTableMT)) != 0) {
+        perror("cadthashtable_mt_new failed allocating struct "
+               "hash_table_mt_type");
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(ht, 0, sizeof(HashTableMT));
+    ht->hash = fp;
+
+    nbuckets = (nbuckets + HT_MT_STRIPES - 1) / HT_MT_STRIPES;
+    for (capacity = MIN_CAPACITY; max_load(capacity) < nbuckets; capacity *= 2)
+        ;
+
+    for (i = 0; i < HT_MT_STRIPES; i++) {
+        pthread_mutex_init(&ht->stripes[i].lock, NULL);
+    }
+    for (i = 0; i < HT_MT_STRIPES; i++) {
+        s = &ht->stripes[i];
+        if ((s->arena = arena_init(STRIPE_ARENA_BLOCK)) == NULL ||
+            (s->array = new_array(s, capacity)) == NULL) {
+            perror("cadthashtable_mt_new failed allocating a stripe");
+            cadthashtable_mt_destroy(ht);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    return ht;
+}
+
+void
+cadthashtable_mt_destroy(HashTableMT *ht)
+{
+    size_t i;
+
+    if (ht == NULL) {
+        return;
+    }
+    for (i = 0; i < HT_MT_STRIPES; i++) {
+        pthread_mutex_destroy(&ht->stripes[i].lock);
+        arena_destroy(ht->stripes[i].arena);
+    }
+    free(ht);
+}
+
+/*
+ * The duplicate check and the insertion run under the lock of the stripe, the
+ * only place its slots are written.
+ */
+void *
+cadthashtable_mt_insert(HashTableMT *ht, const void *key, size_t key_size,
+                        void *e)
+{
+    SlotArray *a;
+    uint64_t hash;
+    Stripe *s;
+    char *copy;
+    size_t i;
+    void *ret = NULL;
+
+    if (ht == NULL || key == NULL || key_size == 0 || e == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    hash = calculate_key_hash(ht, key, key_size);
+    s = stripe_of(ht, hash);
+
+    pthread_mutex_lock(&s->lock);
+
+    if (find(s->array, key, key_size, hash) != NULL) {
+        errno = EEXIST;
+        goto unlock;
+    }
+    if (s->count >= max_load(s->array->mask + 1) && !grow(s)) {
+        perror("cadthashtable_mt_insert failed growing a stripe");
+        errno = ENOMEM;
+        goto unlock;
+    }
+    if ((copy = arena_alloc(s->arena, key_size)) == NULL) {
+        perror("cadthashtable_mt_insert failed copying key");
+        errno = ENOMEM;
+        goto unlock;
+    }
+    memcpy(copy, key, key_size);
+
+    a = s->array;
+    for (i = hash & a->mask; a->slots[i].key != NULL; i = (i + 1) & a->mask)
+        ;
+    a->slots[i].hash = hash;
+    a->slots[i].key_size = key_size;
+    a->slots[i].item = e;
+    __atomic_store_n(&a->slots[i].key, copy, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&s->count, s->count + 1, __ATOMIC_RELAXED);
+    ret = e;
+
+unlock:
+    pthread_mutex_unlock(&s->lock);
+    return ret;
+}
+
+void *
+cadthashtable_mt_lookup(HashTableMT *ht, const void *key, size_t key_size)
+{
+    const SlotArray *a;
+    const Slot *slot;
+    uint64_t hash;
+
+    if (ht == NULL || key == NULL || key_size == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    hash = calculate_key_hash(ht, key, key_size);
+    a = __atomic_load_n(&stripe_of(ht, hash)->array, __ATOMIC_ACQUIRE);
+
+    slot = find(a, key, key_size, hash);
+    return slot != NULL ? slot->item : NULL;
+}
+
+size_t
+cadthashtable_mt_count(HashTableMT *ht)
+{
+    size_t i, count = 0;
+
+    for (i = 0; i < HT_MT_STRIPES; i++) {
+        count += __atomic_load_n(&ht->stripes[i].count, __ATOMIC_RELAXED);
+    }
+    return count;
+}
+
+
+/**************************************************** Private Implementations */
+
+/*
+ * Calls the client hash and mixes it as `HashTableADT` does.  The top bits
+ * pick the stripe, the low ones the slot.
+ */
+static inline uint64_t
+calculate_key_hash(HashTableMT *ht, const void *key, size_t key_size)
+{
+    uint64_t hash;
+
+    hash = (uint64_t)ht->hash(key, key_size) * 0x9E3779B97F4A7C15ULL;
+
+    return hash ^ hash >> 32;
+}
+
+static inline Stripe *
+stripe_of(HashTableMT *ht, uint64_t hash)
+{
+    return &ht->stripes[hash >> (64 - STRIPE_BITS)];
+}
+
+/*
+ * Probes `a` for `key` up to the first empty slot.  Lock free: a slot whose key
+ * isn't published yet looks empty, as it did before the insertion.
+ */
+static const Slot *
+find(const SlotArray *a, const void *key, size_t key_size, uint64_t hash)
+{
+    const Slot *slot;
+    const char *k;
+    size_t i;
+
+    for (i = hash & a->mask; ; i = (i + 1) & a->mask) {
+        slot = &a->slots[i];
+        if ((k = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE)) == NULL) {
+            return NULL;
+        }
+        if (slot->hash == hash && slot->key_size == key_size &&
+            memcmp(k, key, key_size) == 0) {
+            return slot;
+        }
+    }
+}
+
+/*
+ * An array of `capacity` empty slots from the arena of `s`.
+ */
+static SlotArray *
+new_array(Stripe *s, size_t capacity)
+{
+    SlotArray *a;
+    size_t size;
+
+    size = sizeof(SlotArray) + capacity * sizeof(Slot);
+    if ((a = arena_alloc(s->arena, size)) == NULL) {
+        return NULL;
+    }
+    memset(a, 0, size);
+    a->mask = capacity - 1;
+    return a;
+}
+
+/*
+ * Copies the slots of `s` into an array twice as large and publishes it.  The
+ * old one stays in the arena, readers that loaded it keep a valid snapshot.
+ * Called with the lock of `s` held.
+ */
+static bool
+grow(Stripe *s)
+{
+    SlotArray *a, *old = s->array;
+    size_t i, j;
+
+    if ((a = new_array(s, (old->mask + 1) * 2)) == NULL) {
+        return false;
+    }
+    for (i = 0; i <= old->mask; i++) {
+        if (old->slots[i].key == NULL) {
+            continue;
+        }
+        for (j = old->slots[i].hash & a->mask; a->slots[j].key != NULL;
+             j = (j + 1) & a->mask)
+            ;
+        a->slots[j] = old->slots[i];
+    }
+    __atomic_store_n(&s->array, a, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+ * Number of elements an array of `capacity` slots holds before growing.
+ */
+static inline size_t
+max_load(size_t capacity)
+{
+    return capacity / MAX_LOAD_DEN * MAX_LOAD_NUM;
+}
@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instcache.h"
+
+#define CACHE_SLOTS 512             /* Power of two */
+#define MAX_LINE_LEN 15             /* `AMD=D|M;JMP` is 11 bytes long */
+
+
+/*********************************************************** Data Definitions */
+
+typedef struct Slot {
+    uint8_t len;                    /* 0 while empty */
+    char text[MAX_LINE_LEN];        /* Not null-terminated */
+    uint16_t word;
+} Slot;
+
+/*
+ * Datatype completion for `InstCache`:
+ */
+struct instcache_type {
+    Slot slots[CACHE_SLOTS];
+    unsigned long hits;
+    unsigned long misses;
+};
+
+
+/******************************************************* Private Declarations */
+
+static inline size_t slot_index(const char *, size_t);
+
+
+/***************************************************** Public Implementations */
+
+InstCache *
+instcache_init(void)
+{
+    InstCache *ic;
+
+    if ((ic = calloc(1, sizeof(InstCache))) == NULL) {
+        perror("instcache_init calloc");
+        errno = ENOMEM;
+    }
+    return ic;
+}
+
+uint16_t
+instcache_lookup(InstCache *ic, const char *line, size_t len)
+{
+    const Slot *slot;
+
+    assert(line != NULL);
+
+    if (len == 0 || len > MAX_LINE_LEN) {
+        ic->misses++;
+        return ERROR;
+    }
+
+    slot = &ic->slots[slot_index(line, len)];
+    if (slot->len == len && memcmp(slot->text, line, len) == 0) {
+        ic->hits++;
+        return slot->word;
+    }
+    ic->misses++;
+    return ERROR;
+}
+
+void
+instcache_insert(InstCache *ic, const char *line, size_t len, uint16_t word)
+{
+    Slot *slot;
+
+    assert(line != NULL);
+
+    if (len == 0 || len > MAX_LINE_LEN) {
+        return;
+    }
+
+    slot = &ic->slots[slot_index(line, len)];
+    slot->len = (uint8_t)len;
+    memcpy(slot->text, line, len);
+    slot->word = word;
+}
+
+void
+instcache_stats(const InstCache *ic, unsigned long *hits,
+                unsigned long *misses)
+{
+    *hits = ic->hits;
+    *misses = ic->misses;
+}
+
+void
+instcache_destroy(InstCache *ic)
+{
+    free(ic);
+}
+
+
+/**************************************************** Private implementations */
+
+/*
+ * FNV-1a over the bytes of the line, folded into the slots.
+ * http://www.isthe.com/chongo/tech/comp/fnv/
+ */
+static inline size_t
+slot_index(const char *line, size_t len)
+{
+    uint32_t hash = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (uint8_t)line[i];
+        hash *= 16777619U;
+    }
+    return (hash ^ hash >> 16) & (CACHE_SLOTS - 1);
+}
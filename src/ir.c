@@ -0,0 +1,156 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/shared_defs.h"
+#include "ir.h"
+
+#define IR_INITIAL_SIZE     1024        /* Instructions */
+#define NAMES_INITIAL_SIZE  8192        /* Bytes */
+
+
+/******************************************************* Private Declarations */
+
+static bool reserve_instruction(Ir *);
+
+
+/***************************************************** Public Implementations */
+
+Ir *
+ir_init(void)
+{
+    Ir *ir;
+
+    if ((ir = calloc(1, sizeof(Ir))) == NULL) {
+        perror("ir_init calloc");
+        errno = ENOMEM;
+    }
+    return ir;
+}
+
+void
+ir_add_word(Ir *ir, uint16_t word)
+{
+    if (!reserve_instruction(ir)) {
+        return;
+    }
+    ir->kind[ir->count] = IR_WORD;
+    ir->operand[ir->count] = word;
+    ir->count++;
+}
+
+/*
+ * The symbol is appended to `names`, which grows by doubling.  Offsets stay
+ * valid across reallocations, unlike pointers.
+ */
+void
+ir_add_symbol(Ir *ir, const char *symbol)
+{
+    size_t len, capacity;
+    char *grown;
+
+    assert(symbol != NULL);
+
+    len = strlen(symbol) + 1;
+    if (ir->names_size + len > ir->names_capacity) {
+        capacity = ir->names_capacity ? ir->names_capacity : NAMES_INITIAL_SIZE;
+        while (ir->names_size + len > capacity) {
+            capacity *= 2;
+        }
+        if ((grown = realloc(ir->names, capacity)) == NULL) {
+            perror("ir_add_symbol realloc");
+            errno = ENOTRECOVERABLE;
+            return;
+        }
+        ir->names = grown;
+        ir->names_capacity = capacity;
+    }
+
+    if (!reserve_instruction(ir)) {
+        return;
+    }
+    memcpy(ir->names + ir->names_size, symbol, len);
+    ir->kind[ir->count] = IR_SYMBOL;
+    ir->operand[ir->count] = (uint32_t)ir->names_size;
+    ir->count++;
+    ir->names_size += len;
+}
+
+void
+ir_add_id(Ir *ir, uint32_t id)
+{
+    if (!reserve_instruction(ir)) {
+        return;
+    }
+    ir->kind[ir->count] = IR_ID;
+    ir->operand[ir->count] = id;
+    ir->count++;
+}
+
+void
+ir_set_word(Ir *ir, uint16_t index, uint16_t word)
+{
+    assert(index < ir->count);
+
+    ir->kind[index] = IR_WORD;
+    ir->operand[index] = word;
+}
+
+void
+ir_destroy(Ir *ir)
+{
+    if (ir == NULL) {
+        return;
+    }
+    free(ir->kind);
+    free(ir->operand);
+    free(ir->names);
+    free(ir);
+}
+
+
+/**************************************************** Private implementations */
+
+/*
+ * Makes room for one more instruction, growing every array by doubling.  The
+ * number of instructions is bounded by the Hack ROM, `ERROR` words.  Returns
+ * false setting `errno` on failure.
+ */
+static bool
+reserve_instruction(Ir *ir)
+{
+    uint8_t *kind;
+    uint32_t *operand;
+    size_t capacity;
+
+    if (ir->count == ERROR) {
+        fprintf(stderr, "Program exceeds the ROM size.\n");
+        errno = EFBIG;
+        return false;
+    }
+    if (ir->count < ir->capacity) {
+        return true;
+    }
+
+    capacity = ir->capacity ? ir->capacity * 2 : IR_INITIAL_SIZE;
+
+    if ((kind = realloc(ir->kind, capacity * sizeof(*kind))) == NULL) {
+        perror("ir realloc kind");
+        errno = ENOTRECOVERABLE;
+        return false;
+    }
+    ir->kind = kind;
+
+    if ((operand = realloc(ir->operand, capacity * sizeof(*operand))) == NULL) {
+        perror("ir realloc operand");
+        errno = ENOTRECOVERABLE;
+        return false;
+    }
+    ir->operand = operand;
+
+    ir->capacity = capacity;
+    return true;
+}
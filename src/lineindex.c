@@ -0,0 +1,345 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lineindex.h"
+
+/*
+ * The vectorized kernels are written with GCC/Clang intrinsics and target
+ * attributes.  Elsewhere, only the scalar kernels are built.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) \
+    && defined(__GNUC__)
+#define HAVE_SSE2 1
+#include <immintrin.h>
+#endif
+
+
+/********************************************************** Data declarations */
+
+/*
+ * Each kernel returns the index of the first byte at or after `i`, out of `n`,
+ * that matches its search.  Or `n` if there is none.
+ */
+typedef size_t Scan(const char *, size_t, size_t);
+
+typedef struct Kernels {
+    const char *isa;
+    Scan *skip_blanks;          /* First byte that isn't a blank */
+    Scan *find_newline;         /* First newline */
+    Scan *find_end;             /* First newline or `//` */
+} Kernels;
+
+static Scan scalar_skip_blanks, scalar_find_newline, scalar_find_end;
+
+static const Kernels Scalar = {
+    "scalar", scalar_skip_blanks, scalar_find_newline, scalar_find_end
+};
+
+#ifdef HAVE_SSE2
+static Scan sse2_skip_blanks, sse2_find_newline, sse2_find_end;
+static Scan avx2_skip_blanks, avx2_find_newline, avx2_find_end;
+
+static const Kernels Sse2 = {
+    "sse2", sse2_skip_blanks, sse2_find_newline, sse2_find_end
+};
+static const Kernels Avx2 = {
+    "avx2", avx2_skip_blanks, avx2_find_newline, avx2_find_end
+};
+#endif
+
+
+/******************************************************* Private Declarations */
+
+static const Kernels *select_kernels(void);
+static inline bool is_blank(char);
+
+
+/***************************************************** Public Implementations */
+
+/*
+ * Every iteration consumes one line of the input.  The array is sized from an
+ * estimate of one command every 16 bytes, and grows by doubling past it.
+ */
+Line *
+lineindex_build(const char *text, size_t size, size_t *nlines)
+{
+    const Kernels *k;
+    Line *lines, *grown;
+    size_t capacity, count;
+    size_t i, start, end, eol;
+    uint32_t number;
+
+    if (size > UINT32_MAX) {
+        fprintf(stderr, "lineindex_build input too large\n");
+        errno = EFBIG;
+        return NULL;
+    }
+
+    capacity = size / 16 + 16;
+    if ((lines = malloc(capacity * sizeof(Line))) == NULL) {
+        perror("lineindex_build malloc");
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    k = select_kernels();
+    count = 0;
+    number = 0;
+
+    for (i = 0; i < size; i = eol + 1) {
+        number++;
+        start = k->skip_blanks(text, i, size);
+
+        if (start == size) {
+            break;
+        }
+        if (text[start] == '\n') {                          /* Blank line */
+            eol = start;
+            continue;
+        }
+        if (text[start] == '/' && start + 1 < size && text[start + 1] == '/') {
+            eol = k->find_newline(text, start, size);      /* Comment line */
+            continue;
+        }
+
+        end = k->find_end(text, start, size);
+        if (end < size && text[end] != '\n') {
+            eol = k->find_newline(text, end, size);
+        } else {
+            eol = end;
+        }
+        while (is_blank(text[end - 1])) {
+            end--;
+        }
+
+        if (count == capacity) {
+            capacity *= 2;
+            if ((grown = realloc(lines, capacity * sizeof(Line))) == NULL) {
+                perror("lineindex_build realloc");
+                free(lines);
+                errno = ENOMEM;
+                return NULL;
+            }
+            lines = grown;
+        }
+        lines[count].offset = (uint32_t)start;
+        lines[count].length = (uint32_t)(end - start);
+        lines[count].number = number;
+        count++;
+    }
+
+    *nlines = count;
+    return lines;
+}
+
+const char *
+lineindex_isa(void)
+{
+    return select_kernels()->isa;
+}
+
+
+/**************************************************** Private implementations */
+
+/*
+ * Picks the widest kernels the CPU reports support for.  SSE2 is part of the
+ * x86-64 baseline.  The answer is not cached, so concurrent callers share no
+ * mutable state: the feature check is cheap next to a scan of the input.
+ */
+static const Kernels *
+select_kernels(void)
+{
+#ifdef HAVE_SSE2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &Avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return &Sse2;
+    }
+    return &Scalar;
+#else
+    return &Scalar;
+#endif
+}
+
+/*
+ * Same set as `isspace()` in the "C" locale, minus the newline.
+ */
+static inline bool
+is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/*
+ * Scalar kernels.  They also finish the last few bytes for the vectorized
+ * ones, which never load past `n`.
+ */
+static size_t
+scalar_skip_blanks(const char *p, size_t i, size_t n)
+{
+    while (i < n && is_blank(p[i])) {
+        i++;
+    }
+    return i;
+}
+
+static size_t
+scalar_find_newline(const char *p, size_t i, size_t n)
+{
+    while (i < n && p[i] != '\n') {
+        i++;
+    }
+    return i;
+}
+
+static size_t
+scalar_find_end(const char *p, size_t i, size_t n)
+{
+    for ( ; i < n; i++) {
+        if (p[i] == '\n' || (p[i] == '/' && i + 1 < n && p[i + 1] == '/')) {
+            break;
+        }
+    }
+    return i;
+}
+
+#ifdef HAVE_SSE2
+
+/*
+ * SSE2 kernels.  Each byte of a 16-byte block is compared against the targets,
+ * and the comparison masks are packed into the bits of an integer.  The lowest
+ * set bit is the first match.  A `//` is a slash whose next byte, read through
+ * a second load shifted by one, is also a slash.
+ */
+static size_t
+sse2_skip_blanks(const char *p, size_t i, size_t n)
+{
+    const __m128i sp = _mm_set1_epi8(' '), ht = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r'), vt = _mm_set1_epi8('\v');
+    const __m128i ff = _mm_set1_epi8('\f');
+    __m128i b, m;
+    unsigned mask;
+
+    for ( ; i + 16 <= n; i += 16) {
+        b = _mm_loadu_si128((const __m128i *)(p + i));
+        m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, sp),
+                                      _mm_cmpeq_epi8(b, ht)),
+                         _mm_or_si128(_mm_cmpeq_epi8(b, cr),
+                                      _mm_or_si128(_mm_cmpeq_epi8(b, vt),
+                                                   _mm_cmpeq_epi8(b, ff))));
+        mask = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return scalar_skip_blanks(p, i, n);
+}
+
+static size_t
+sse2_find_newline(const char *p, size_t i, size_t n)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    __m128i b;
+    unsigned mask;
+
+    for ( ; i + 16 <= n; i += 16) {
+        b = _mm_loadu_si128((const __m128i *)(p + i));
+        mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(b, nl));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return scalar_find_newline(p, i, n);
+}
+
+static size_t
+sse2_find_end(const char *p, size_t i, size_t n)
+{
+    const __m128i nl = _mm_set1_epi8('\n'), sl = _mm_set1_epi8('/');
+    __m128i b, c, m;
+    unsigned mask;
+
+    for ( ; i + 17 <= n; i += 16) {
+        b = _mm_loadu_si128((const __m128i *)(p + i));
+        c = _mm_loadu_si128((const __m128i *)(p + i + 1));
+        m = _mm_or_si128(_mm_cmpeq_epi8(b, nl),
+                         _mm_and_si128(_mm_cmpeq_epi8(b, sl),
+                                       _mm_cmpeq_epi8(c, sl)));
+        mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return scalar_find_end(p, i, n);
+}
+
+/*
+ * AVX2 kernels, the same searches over 32-byte blocks.
+ */
+__attribute__((target("avx2"))) static size_t
+avx2_skip_blanks(const char *p, size_t i, size_t n)
+{
+    const __m256i sp = _mm256_set1_epi8(' '), ht = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r'), vt = _mm256_set1_epi8('\v');
+    const __m256i ff = _mm256_set1_epi8('\f');
+    __m256i b, m;
+    uint32_t mask;
+
+    for ( ; i + 32 <= n; i += 32) {
+        b = _mm256_loadu_si256((const __m256i *)(p + i));
+        m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(b, sp),
+                                            _mm256_cmpeq_epi8(b, ht)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(b, cr),
+                                  _mm256_or_si256(_mm256_cmpeq_epi8(b, vt),
+                                                  _mm256_cmpeq_epi8(b, ff))));
+        mask = ~(uint32_t)_mm256_movemask_epi8(m);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return sse2_skip_blanks(p, i, n);
+}
+
+__attribute__((target("avx2"))) static size_t
+avx2_find_newline(const char *p, size_t i, size_t n)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    __m256i b;
+    uint32_t mask;
+
+    for ( ; i + 32 <= n; i += 32) {
+        b = _mm256_loadu_si256((const __m256i *)(p + i));
+        mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, nl));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return sse2_find_newline(p, i, n);
+}
+
+__attribute__((target("avx2"))) static size_t
+avx2_find_end(const char *p, size_t i, size_t n)
+{
+    const __m256i nl = _mm256_set1_epi8('\n'), sl = _mm256_set1_epi8('/');
+    __m256i b, c, m;
+    uint32_t mask;
+
+    for ( ; i + 33 <= n; i += 32) {
+        b = _mm256_loadu_si256((const __m256i *)(p + i));
+        c = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+        m = _mm256_or_si256(_mm256_cmpeq_epi8(b, nl),
+                            _mm256_and_si256(_mm256_cmpeq_epi8(b, sl),
+                                             _mm256_cmpeq_epi8(c, sl)));
+        mask = (uint32_t)_mm256_movemask_epi8(m);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return sse2_find_end(p, i, n);
+}
+
+#endif /* HAVE_SSE2 */
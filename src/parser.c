@@ -1,290 +1,437 @@
-#define _POSIX_C_SOURCE 200809L     /* getline() */
+#define _POSIX_C_SOURCE 200809L     /* mmap(), strndup() */
 #include <assert.h>
-#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "lineindex.h"
 #include "parser.h"
 
 
-/********************************************************** Data declarations */
+/*********************************************************** Data Definitions */
 
-static ssize_t line_len;               /* Buffer length */
-static CommandType command;            /* Current instruction type */
-static int line_num;                   /* Line number */
-static char *buffer;                   /* Pointer to the current buffer */
-static char *token;                    /* Pointer to the token being parsed */
-static FILE *fp;                       /* File stream */
+/*
+ * Datatype completion for `Parser`, the status of one parsing process:
+ */
+struct parser_type {
+    ssize_t line_len;           /* Buffer length */
+    int line_num;               /* Line number */
+    char *buffer;               /* Pointer to the current buffer */
+    int fd;                     /* Input file descriptor */
+    char *map;                  /* Private mapping of the input file */
+    size_t map_size;            /* Size of the mapping in bytes */
+    Line *lines;                /* Index of the command lines */
+    size_t nlines;              /* Number of lines in the index */
+    size_t next_line;           /* Index of the next unread line */
+    char *tail;                 /* Copy of an unterminated last line */
+    bool buffered;              /* Input read into the heap, unmapped */
+    bool slice;                 /* Borrows the input of another parser */
+};
+
+/*
+ * Character classes of the lexer.  Symbols are made of letters, digits and
+ * `_.$:`, not starting with a digit.  Fields of a C-instruction are made of
+ * letters, digits and operators.
+ */
+typedef enum {
+    CL_OTHER, CL_LETTER, CL_DIGIT, CL_SYMBOL, CL_OPERATOR,
+    CL_AT, CL_LPAREN, CL_RPAREN, CL_EQUALS, CL_SEMICOLON,
+    CLASSES
+} CharClass;
+
+#define O CL_OTHER
+#define L CL_LETTER
+#define D CL_DIGIT
+#define S CL_SYMBOL
+#define P CL_OPERATOR
+
+static const uint8_t Classes[256] = {
+/*         0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
+/* 0x00 */ O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+/* 0x10 */ O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+/* 0x20 */ O, P, O, O, S, O, P, O, CL_LPAREN, CL_RPAREN, O, P, O, P, S, O,
+/* 0x30 */ D, D, D, D, D, D, D, D, D, D, S, CL_SEMICOLON, O, CL_EQUALS, O, O,
+/* 0x40 */ CL_AT, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+/* 0x50 */ L, L, L, L, L, L, L, L, L, L, L, O, O, O, O, S,
+/* 0x60 */ O, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+/* 0x70 */ L, L, L, L, L, L, L, L, L, L, L, O, P, O, O, O,
+    /* 0x80 to 0xFF are all `CL_OTHER` */
+};
+
+#undef O
+#undef L
+#undef D
+#undef S
+#undef P
+
+/*
+ * States of the lexer.  `ST_ERROR` is zero, so every transition left out of
+ * the table below rejects the command.
+ */
+typedef enum {
+    ST_ERROR,
+    ST_START,
+    ST_AT,          /* @ */
+    ST_NUMBER,      /* @123 */
+    ST_ASYMBOL,     /* @sym */
+    ST_LPAREN,      /* ( */
+    ST_LSYMBOL,     /* (sym */
+    ST_LABEL,       /* (sym) */
+    ST_FIELD,       /* First field of a C-instruction, `dest` or `comp` */
+    ST_EQUALS,      /* dest= */
+    ST_COMP,        /* dest=comp */
+    ST_SEMICOLON,   /* comp; */
+    ST_JUMP,        /* comp;jump */
+    STATES
+} LexState;
+
+static const uint8_t Transitions[STATES][CLASSES] = {
+    [ST_START] = {
+        [CL_LETTER] = ST_FIELD, [CL_DIGIT] = ST_FIELD,
+        [CL_OPERATOR] = ST_FIELD, [CL_AT] = ST_AT, [CL_LPAREN] = ST_LPAREN
+    },
+    [ST_AT] = {
+        [CL_LETTER] = ST_ASYMBOL, [CL_SYMBOL] = ST_ASYMBOL,
+        [CL_DIGIT] = ST_NUMBER
+    },
+    [ST_NUMBER] = {
+        [CL_DIGIT] = ST_NUMBER
+    },
+    [ST_ASYMBOL] = {
+        [CL_LETTER] = ST_ASYMBOL, [CL_DIGIT] = ST_ASYMBOL,
+        [CL_SYMBOL] = ST_ASYMBOL
+    },
+    [ST_LPAREN] = {
+        [CL_LETTER] = ST_LSYMBOL, [CL_SYMBOL] = ST_LSYMBOL
+    },
+    [ST_LSYMBOL] = {
+        [CL_LETTER] = ST_LSYMBOL, [CL_DIGIT] = ST_LSYMBOL,
+        [CL_SYMBOL] = ST_LSYMBOL, [CL_RPAREN] = ST_LABEL
+    },
+    [ST_FIELD] = {
+        [CL_LETTER] = ST_FIELD, [CL_DIGIT] = ST_FIELD,
+        [CL_OPERATOR] = ST_FIELD, [CL_EQUALS] = ST_EQUALS,
+        [CL_SEMICOLON] = ST_SEMICOLON
+    },
+    [ST_EQUALS] = {
+        [CL_LETTER] = ST_COMP, [CL_DIGIT] = ST_COMP, [CL_OPERATOR] = ST_COMP
+    },
+    [ST_COMP] = {
+        [CL_LETTER] = ST_COMP, [CL_DIGIT] = ST_COMP, [CL_OPERATOR] = ST_COMP,
+        [CL_SEMICOLON] = ST_SEMICOLON
+    },
+    [ST_SEMICOLON] = {
+        [CL_LETTER] = ST_JUMP
+    },
+    [ST_JUMP] = {
+        [CL_LETTER] = ST_JUMP
+    },
+};
 
 
 /******************************************************* Private Declarations */
 
 static inline bool is_extension_asm (const char *);
-static inline void discard_leading_withe_spaces(void);
-static inline bool is_blank_line (void);
-static inline bool is_comment_line (void);
+static bool map_input(Parser *);
+static bool read_input(Parser *);
 
 
 /***************************************************** Public Implementations */
 
 /*
- * Initializes the parser to read from the stream `filename`, after checking the
- * file's extension. 
+ * Initializes the parser to read from the file `filename`, after checking the
+ * file's extension.  The whole file is mapped into memory once, both passes
+ * read their lines straight from the mapping.  The name "-" stands for the
+ * standard input, which carries no extension.
+ *
+ * The mapping is then indexed, see `lineindex.h`.  The offsets of the index
+ * remain valid across rewinds, only the mapping is renewed.
  */
-void *
+Parser *
 parser_init(char *filename)
 {
-    FILE *file;
+    Parser *ps;
 
     if (filename == NULL) {
         return NULL;
     }
-    if (!is_extension_asm(filename)) {
-        perror("parser_init invalid filetype");
+    if ((ps = calloc(1, sizeof(Parser))) == NULL) {
+        perror("parser_init calloc");
         return NULL;
     }
-    if ((file = fopen(filename , "r")) == NULL) {
+    if (strcmp(filename, "-") == 0) {
+        ps->fd = STDIN_FILENO;
+    } else if (!is_extension_asm(filename)) {
+        perror("parser_init invalid filetype");
+        free(ps);
+        return NULL;
+    } else if ((ps->fd = open(filename, O_RDONLY)) == -1) {
         perror("parser_init");
+        free(ps);
+        return NULL;
+    }
+    if (!map_input(ps)) {
+        if (ps->fd != STDIN_FILENO) {
+            close(ps->fd);
+        }
+        free(ps);
+        return NULL;
+    }
+    if ((ps->lines = lineindex_build(ps->map, ps->map_size, 
+                                     &ps->nlines)) == NULL) {
+        parser_destroy(ps);
         return NULL;
     }
 
-    line_len = 0;
-    line_num = 0;
-    command = -1;
-    buffer = NULL;
-    token = NULL;
-    fp = file;
-
-    return &line_len;
+    return ps;
 }
 
 /*
- * Frees any memory in use by the line buffer, setting it to NULL to avoid a
- * possible double free.  Reads the next line from the input. 
+ * Points the line buffer at the next indexed command, null-terminating it in
+ * place.  The byte right after a command is a newline, a blank or the start
+ * of a comment, none of them needed any more.  No bytes are copied, except for
+ * a command ending the input: there is no byte left in the mapping to
+ * terminate it, so it gets duplicated into `tail`.
  */
 void 
-parser_advance(void)
+parser_advance(Parser *ps)
 {
-    ssize_t len = 0;
-    size_t bufsize = 0;
-    char *line = NULL;
-
-    assert(line_len != -1);
-
-    if (feof(fp)) {
-        return;
-    }
-
-    if (ferror(fp)) {
-        perror("parser_advance");
-        errno = ENOTRECOVERABLE;
-        return;
-    }
+    const Line *l;
+    char *line;
+    size_t end;
 
-    free(buffer);
-    buffer = NULL;  /* Double free if there is an error reading the line */
+    assert(ps->line_len != -1);
 
-    if ((len = getline(&line, &bufsize, fp)) == -1 && ferror(fp)) {
-        free(line);
-        perror("parser_advance, getline()");
-        errno = ENOTRECOVERABLE;
+    if (ps->next_line == ps->nlines) {
+        ps->buffer = NULL;
+        ps->line_len = -1;
         return;
     }
 
-    buffer = token = line;
-    line_len = len;
-    line_num++;
-
-}
-
-/*
- * This routine advances us to the first non-white character of an uncommented
- * line.
- *
- * This function is *tightly coupled* with `discard_line_leading_white_spaces`,
- * `is_blank_line`, `is_comment_line`, and `parser_advance`. 
- *
- * Returns false at EOF or when an error occurs while reading the stream.
- * Returns true if there are commands in the input. The function calls itself
- * recursively on blank and comment lines, effectively skipping them.
- */
-bool 
-parser_has_more_commands(void)
-{
-
-    if (line_len == -1 && feof(fp)) {
-        return false;
-    }
+    l = &ps->lines[ps->next_line++];
+    line = ps->map + l->offset;
+    end = (size_t)l->offset + l->length;
 
-    discard_leading_withe_spaces();
-    if (is_blank_line() || is_comment_line()) {
-        errno = 0;
-        parser_advance();
-        if (errno != 0) {
+    if (end < ps->map_size) {
+        ps->map[end] = '\0';
+    } else {
+        if ((line = strndup(line, l->length)) == NULL) {
+            perror("parser_advance, strndup()");
             errno = ENOTRECOVERABLE;
-            return false;
+            return;
         }
-        parser_has_more_commands();
+        free(ps->tail);
+        ps->tail = line;
     }
 
-    return true;
+    ps->buffer = line;
+    ps->line_len = (ssize_t)l->length;
+    ps->line_num = (int)l->number;
 }
 
 /*
- * Returns the type of the current command. 
+ * Returns false at EOF.  Blank and comment lines never made it into the index,
+ * so any line the parser holds is a command.
  */
-CommandType 
-parser_get_command_type(void)
+bool 
+parser_has_more_commands(Parser *ps)
 {
-
-    assert(token != NULL);
-    assert(*token);
-
-    if (*token == '@') {
-        command = A_COMMAND;
-        return A_COMMAND;
-    } else if (*token == '(') {
-        command = L_COMMAND;
-        return L_COMMAND;
-    } else {
-        command = C_COMMAND;
-        return C_COMMAND;
-    }
+    return ps->line_len != -1;
 }
 
-/*
- * Returns a pointer to the Symbol or Decimal Xxx field of the current A or L
- * command.   @Xxx or (Xxx).  
- */
 const char *
-parser_symbol(void)
+parser_line(Parser *ps, size_t *len)
 {
-    char *p;
-
-    assert(command != C_COMMAND);
-    assert(token != NULL);
-    assert(*token);
-    p = NULL;
+    assert(ps->buffer != NULL);
 
-    if (command == A_COMMAND) {
-        p = strtok(token, "@ \t\n\v\f\r");
-    }
-    if (command == L_COMMAND) {
-        p = strtok(token, "()");
-    }
-    if (p) {
-        while (*(token)++); 
-        return p;
-    }
-
-    return token;
+    *len = (size_t)ps->line_len;
+    return ps->buffer;
 }
 
 /*
- * Returns a string to the C-instruction's `dest` field.  Called strictly first
- * in a C-instruction.
+ * Runs the line through the `Transitions` automaton, one byte at a time.  Field
+ * boundaries are recorded on entering the states that follow a delimiter, and
+ * decimals are accumulated digit by digit, so the line is read only once.
+ * The closing parenthesis of a label is the only byte written, to terminate
+ * its symbol.
  */
-const char *
-parser_dest(void)
+bool
+parser_command(Parser *ps, Command *cmd)
 {
-    char *p, *q;
-
-    assert(command == C_COMMAND);
-    assert(token != NULL);
-    assert(*token);
-
-    if ((p = strchr(token, '='))) {
-        *p = '\0';
-        q = token;
-        token = p + 1;
-        return q;
+    static const Field empty = {"", 0};
+    const char *line;
+    uint32_t i, len, start, value;
+    uint8_t state, c;
+
+    assert(ps->buffer != NULL);
+    assert(ps->line_len > 0);
+
+    line = ps->buffer;
+    len = (uint32_t)ps->line_len;
+    cmd->symbol = cmd->dest = cmd->comp = cmd->jump = empty;
+    cmd->value = 0;
+    state = ST_START;
+    start = value = 0;
+
+    for (i = 0; i < len && state != ST_ERROR; i++) {
+        c = (uint8_t)line[i];
+        state = Transitions[state][Classes[c]];
+
+        switch (state) {
+        case ST_NUMBER:
+            value = value * 10 + (uint32_t)(c - '0');
+            if (value >= ERROR) {
+                state = ST_ERROR;
+            }
+            break;
+        case ST_AT:
+        case ST_LPAREN:
+            start = i + 1;
+            break;
+        case ST_EQUALS:
+            cmd->dest = (Field){line + start, i - start};
+            start = i + 1;
+            break;
+        case ST_SEMICOLON:
+            cmd->comp = (Field){line + start, i - start};
+            start = i + 1;
+            break;
+        default:
+            break;
+        }
     }
 
-    return "";
+    switch (state) {
+    case ST_NUMBER:
+        cmd->type = A_COMMAND;
+        cmd->value = (uint16_t)value;
+        return true;
+    case ST_ASYMBOL:
+        cmd->type = A_COMMAND;
+        cmd->symbol = (Field){line + start, len - start};
+        return true;
+    case ST_LABEL:
+        ps->buffer[len - 1] = '\0';
+        cmd->type = L_COMMAND;
+        cmd->symbol = (Field){line + start, len - 1 - start};
+        return true;
+    case ST_FIELD:
+    case ST_COMP:
+        cmd->type = C_COMMAND;
+        cmd->comp = (Field){line + start, len - start};
+        return true;
+    case ST_JUMP:
+        cmd->type = C_COMMAND;
+        cmd->jump = (Field){line + start, len - start};
+        return true;
+    default:
+        errno = EINVAL;
+        return false;
+    }
 }
 
 /*
- * Returns a string to the C-instruction's `comp` field.  Called strictly after
- * `parser_dest()`
+ * The slice copies the input fields of `ps`, but owns none of them.  Its first
+ * command is counted from the next unread one of `ps`.  Lines are
+ * terminated in place by `parser_advance()` on the shared mapping: every line
+ * has its own terminator byte, so slices never write to the same bytes.
  */
-const char *
-parser_comp(void)
+Parser *
+parser_slice(Parser *ps, size_t first, size_t count)
 {
-    char *p, *q;
-    
-    assert(command == C_COMMAND);
-    assert(token != NULL);
-    assert(*token);
-
-    if ((p = strchr(token, ';'))) {
-        *p = '\0';
-        q = token;
-        token = p + 1;
-        return q;
-    } else {
-        p = strtok(token, " \t\n\v\f\r");
-    }
+    Parser *slice;
 
-    assert(p != NULL);
-    while (*(token)++) {
-        ;
-    }
+    assert(first + count <= ps->nlines - ps->next_line);
 
-    return p;
+    if ((slice = malloc(sizeof(Parser))) == NULL) {
+        perror("parser_slice malloc");
+        errno = ENOMEM;
+        return NULL;
+    }
+    *slice = *ps;
+    slice->buffer = NULL;
+    slice->tail = NULL;
+    slice->line_len = 0;
+    slice->line_num = 0;
+    slice->next_line = ps->next_line + first;
+    slice->nlines = slice->next_line + count;
+    slice->slice = true;
+
+    return slice;
 }
 
-/*
- * Return a string to the C-instruction's jump field. Called strictly after
- * `parser_comp()`.
- */
-const char *
-parser_jump(void)
+size_t
+parser_length(Parser *ps)
 {
-    char *p;
-
-    assert(command == C_COMMAND);
-    assert(token != NULL);
-
-    if ((p = strtok(token, " \t\n\v\f\r")) && *p == 'J') {
-        return p;
-    }
-    return "";
+    return ps->nlines - ps->next_line;
 }
 
 /*
- * Sets the parser for the second pass.
+ * Sets the parser for the second pass.  The file is mapped afresh, dropping the
+ * terminators written into the previous mapping.  A stream that had to be read
+ * into the heap can't be read again.
  */
 void 
-parser_rewind(void)
+parser_rewind(Parser *ps)
 {
 
-    rewind(fp);
-    buffer = NULL;
-    token = NULL;
-    line_len = 0;
-    line_num = 0;
-    command = -1;
+    if (ps->buffered) {
+        errno = ESPIPE;
+        return;
+    }
+    if (ps->slice) {
+        errno = EPERM;
+        return;
+    }
+    if (ps->map != NULL) {
+        munmap(ps->map, ps->map_size);
+    }
+    if (!map_input(ps)) {
+        errno = ENOTRECOVERABLE;
+    }
+    ps->buffer = NULL;
+    ps->next_line = 0;
+    ps->line_len = 0;
+    ps->line_num = 0;
 
 }
 
 /*
- * Releases memory and closes the stream associated with the parser.  
+ * Releases the mapping, closes the file and deallocates the parser.  A slice
+ * only releases what it allocated itself.  Does nothing on a NULL parser.
  */
 void 
-parser_destroy(void)
+parser_destroy(Parser *ps)
 {
 
+    if (ps == NULL) {
+        return;
+    }
     if (errno != 0) {
         perror("Aborted translation");
-        fprintf(stderr, "Parsing line %d.\n", line_num - 1); 
+        fprintf(stderr, "Parsing line %d.\n", ps->line_num); 
     }
 
-    free(buffer);
-    if (fclose(fp) == EOF) {
+    free(ps->tail);
+    if (ps->slice) {
+        free(ps);
+        return;
+    }
+    free(ps->lines);
+    if (ps->buffered) {
+        free(ps->map);
+    } else if (ps->map != NULL) {
+        munmap(ps->map, ps->map_size);
+    }
+    if (ps->fd != STDIN_FILENO && close(ps->fd) == -1) {
         perror("parser_destroy");
     }
+    free(ps);
 
 }
 
@@ -308,27 +455,79 @@ is_extension_asm(const char *filename)
 }
 
 /*
- * The `parser_has_more_commands` implementation strictly requires this three
- * functions to be called in the order in which they are declared.  The names 
- * are self-explanatory.
+ * Maps the whole input file `fd` privately and writable, so lines can be
+ * terminated in place without altering the file.  An empty file has nothing to
+ * map and is left with a NULL mapping.  Anything but a regular file, such as a
+ * pipe, can't be mapped and is read into the heap instead.
  */
-static inline void 
-discard_leading_withe_spaces(void)
+static bool 
+map_input(Parser *ps)
 {
-    while (token && isspace(*(token))) {
-        token++;
+    struct stat st;
+
+    if (fstat(ps->fd, &st) == -1) {
+        perror("map_input fstat");
+        return false;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return read_input(ps);
     }
-}
 
-static inline bool 
-is_blank_line(void)
-{
-    return strncmp(token, "", 1) == 0;
+    ps->map = NULL;
+    ps->map_size = (size_t)st.st_size;
+    ps->buffered = false;
+
+    if (ps->map_size == 0) {
+        return true;
+    }
+
+    ps->map = mmap(NULL, ps->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                   ps->fd, 0);
+    if (ps->map == MAP_FAILED) {
+        perror("map_input mmap");
+        ps->map = NULL;
+        return false;
+    }
+    return true;
 }
 
-static inline bool 
-is_comment_line(void)
+/*
+ * Reads `fd` up to end of file into a heap buffer standing in for the mapping,
+ * growing it by doubling.
+ */
+static bool 
+read_input(Parser *ps)
 {
-    assert(line_len >= 2);
-    return (*token) == '/' && (*(token + 1)) == '/';
+    size_t capacity;
+    ssize_t n;
+    char *grown;
+
+    ps->map = NULL;
+    ps->map_size = 0;
+    capacity = 0;
+    ps->buffered = true;
+
+    for ( ; ; ) {
+        if (ps->map_size == capacity) {
+            capacity = capacity ? capacity * 2 : 65536;
+            if ((grown = realloc(ps->map, capacity)) == NULL) {
+                perror("read_input realloc");
+                break;
+            }
+            ps->map = grown;
+        }
+        n = read(ps->fd, ps->map + ps->map_size, capacity - ps->map_size);
+        if (n > 0) {
+            ps->map_size += (size_t)n;
+        } else if (n == 0) {
+            return true;
+        } else if (errno != EINTR) {
+            perror("read_input read");
+            break;
+        }
+    }
+
+    free(ps->map);
+    ps->map = NULL;
+    return false;
 }
@@ -0,0 +1,350 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "perfecthash.h"
+
+#define MAX_SEEDS 16                /* Builds tried before giving up */
+#define MAX_D0 64                   /* Values of `d0` tried by a bucket */
+
+
+/*********************************************************** Data Definitions */
+
+typedef struct displacement {
+    uint32_t d0, d1;
+} Displacement;
+
+/*
+ * Datatype completion for `PerfectHash`:
+ */
+struct perfect_hash_type {
+    uint32_t nkeys;
+    uint32_t nbuckets;
+    uint64_t seed;                  /* Mixed into every hash */
+    Displacement displacements[];   /* By bucket */
+};
+
+/*
+ * A key as the build sees it, `f1` and `f2` reduced modulo the number of keys.
+ */
+typedef struct key {
+    uint32_t bucket;
+    uint32_t f1, f2;
+} Key;
+
+/*
+ * Scratch space of a build, reused from one seed to the next.
+ */
+typedef struct builder {
+    const size_t *hashes;
+    uint32_t n;
+    Key *keys;
+    uint32_t *members;              /* Keys grouped by bucket */
+    uint32_t *start;                /* Of each bucket in `members` */
+    uint32_t *order;                /* Buckets, largest first */
+    uint32_t *positions;            /* Of the bucket being placed, n + 1 */
+    bool *taken;                    /* By index */
+} Builder;
+
+
+/******************************************************* Private Declarations */
+
+static inline uint64_t mix(size_t, uint64_t);
+static inline uint32_t bucket_of(uint64_t, uint32_t);
+static inline uint32_t f1_of(uint64_t);
+static inline uint32_t f2_of(uint64_t);
+static bool try_seed(PerfectHash *, Builder *);
+static void group_buckets(PerfectHash *, Builder *);
+static bool separable(const Builder *, uint32_t);
+static bool place_bucket(PerfectHash *, Builder *, uint32_t);
+static void place_singletons(PerfectHash *, Builder *, uint32_t);
+
+
+/***************************************************** Public Implementations */
+
+/*
+ * A seed only fails if a bucket finds no displacement, most often because two
+ * of its keys can't be told apart modulo `n`.  The next one mixes the hashes
+ * differently.
+ */
+PerfectHash *
+perfecthash_build(const size_t *hashes, uint32_t n)
+{
+    PerfectHash *ph;
+    Builder b = {0};
+    uint32_t nbuckets, i;
+    bool ok = false;
+
+    if (n == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    nbuckets = (n + PH_BUCKET_SIZE - 1) / PH_BUCKET_SIZE;
+    ph = malloc(sizeof(PerfectHash) + nbuckets * sizeof(Displacement));
+    b.hashes = hashes;
+    b.n = n;
+    b.keys = malloc(n * sizeof(Key));
+    b.members = malloc(n * sizeof(uint32_t));
+    b.start = malloc((nbuckets + 1) * sizeof(uint32_t));
+    b.order = malloc(nbuckets * sizeof(uint32_t));
+    b.positions = malloc((n + 1) * sizeof(uint32_t));
+    b.taken = malloc(n * sizeof(bool));
+    if (ph == NULL || b.keys == NULL || b.members == NULL || b.start == NULL ||
+        b.order == NULL || b.positions == NULL || b.taken == NULL) {
+        perror("perfecthash_build malloc");
+        errno = ENOMEM;
+        goto done;
+    }
+    ph->nkeys = n;
+    ph->nbuckets = nbuckets;
+
+    errno = 0;
+    for (i = 0; i < MAX_SEEDS && !ok && errno == 0; i++) {
+        ph->seed = i * 0xD1B54A32D192ED03ULL;
+        ok = try_seed(ph, &b);
+    }
+    if (!ok && errno == 0) {
+        errno = EINVAL;
+    }
+
+done:
+    free(b.keys);
+    free(b.members);
+    free(b.start);
+    free(b.order);
+    free(b.positions);
+    free(b.taken);
+    if (!ok) {
+        free(ph);
+        return NULL;
+    }
+    return ph;
+}
+
+uint32_t
+perfecthash_index(const PerfectHash *ph, size_t hash)
+{
+    const Displacement *d;
+    uint64_t g;
+
+    g = mix(hash, ph->seed);
+    d = &ph->displacements[bucket_of(g, ph->nbuckets)];
+
+    return (uint32_t)(((uint64_t)f1_of(g) + (uint64_t)d->d0 * f2_of(g) +
+                       d->d1) % ph->nkeys);
+}
+
+size_t
+perfecthash_size(const PerfectHash *ph)
+{
+    return sizeof(PerfectHash) + ph->nbuckets * sizeof(Displacement);
+}
+
+void
+perfecthash_destroy(PerfectHash *ph)
+{
+    free(ph);
+}
+
+
+/**************************************************** Private implementations */
+
+static inline uint64_t
+mix(size_t hash, uint64_t seed)
+{
+    uint64_t g = ((uint64_t)hash ^ seed) * 0x9E3779B97F4A7C15ULL;
+
+    return g ^ g >> 29;
+}
+
+/*
+ * The high half of `g` scaled to `nbuckets`, without a division.
+ */
+static inline uint32_t
+bucket_of(uint64_t g, uint32_t nbuckets)
+{
+    return (uint32_t)(((g >> 32) * nbuckets) >> 32);
+}
+
+static inline uint32_t
+f1_of(uint64_t g)
+{
+    return (uint32_t)g;
+}
+
+static inline uint32_t
+f2_of(uint64_t g)
+{
+    return (uint32_t)((g * 0xBF58476D1CE4E5B9ULL) >> 32);
+}
+
+/*
+ * One build with the seed of `ph`.  The buckets of several keys are placed
+ * largest first, while most indexes are still free, then every bucket of a
+ * single key takes one of the indexes left.  Returns `false` if a bucket can't
+ * be placed, setting `errno` to `EINVAL` if no seed ever could.
+ */
+static bool
+try_seed(PerfectHash *ph, Builder *b)
+{
+    uint32_t i;
+
+    group_buckets(ph, b);
+    memset(b->taken, 0, b->n * sizeof(bool));
+    memset(ph->displacements, 0, ph->nbuckets * sizeof(Displacement));
+
+    for (i = 0; i < ph->nbuckets; i++) {
+        if (b->start[b->order[i] + 1] - b->start[b->order[i]] < 2) {
+            break;
+        }
+        if (!separable(b, b->order[i]) || !place_bucket(ph, b, b->order[i])) {
+            return false;
+        }
+    }
+    place_singletons(ph, b, i);
+    return true;
+}
+
+/*
+ * Derives the key of every hash, groups the keys by bucket in `members`, and
+ * sorts the buckets by size into `order`, largest first.
+ */
+static void
+group_buckets(PerfectHash *ph, Builder *b)
+{
+    uint32_t i, bucket, size, max_size, *count;
+    uint64_t g;
+
+    memset(b->start, 0, (ph->nbuckets + 1) * sizeof(uint32_t));
+    for (i = 0; i < b->n; i++) {
+        g = mix(b->hashes[i], ph->seed);
+        b->keys[i].bucket = bucket_of(g, ph->nbuckets);
+        b->keys[i].f1 = f1_of(g) % b->n;
+        b->keys[i].f2 = f2_of(g) % b->n;
+        b->start[b->keys[i].bucket + 1]++;
+    }
+    max_size = 0;
+    for (i = 0; i < ph->nbuckets; i++) {
+        if (b->start[i + 1] > max_size) {
+            max_size = b->start[i + 1];
+        }
+        b->start[i + 1] += b->start[i];
+    }
+
+    /* `positions` serves as the fill count of each bucket, then of each size */
+    count = b->positions;
+    memset(count, 0, ph->nbuckets * sizeof(uint32_t));
+    for (i = 0; i < b->n; i++) {
+        bucket = b->keys[i].bucket;
+        b->members[b->start[bucket] + count[bucket]++] = i;
+    }
+
+    memset(count, 0, (max_size + 1) * sizeof(uint32_t));
+    for (i = 0; i < ph->nbuckets; i++) {
+        count[max_size - (b->start[i + 1] - b->start[i])]++;
+    }
+    for (size = 0, i = 0; i <= max_size; i++) {
+        size += count[i];
+        count[i] = size - count[i];
+    }
+    for (i = 0; i < ph->nbuckets; i++) {
+        b->order[count[max_size - (b->start[i + 1] - b->start[i])]++] = i;
+    }
+}
+
+/*
+ * Whether some displacement can tell the keys of `bucket` apart.  Two keys
+ * whose `f1` and `f2` are both equal always land together, whatever `d0` and
+ * `d1`.  Sets `errno` to `EINVAL` if their hashes are equal: no seed would
+ * tell them apart either.
+ */
+static bool
+separable(const Builder *b, uint32_t bucket)
+{
+    const Key *x, *y;
+    uint32_t i, j;
+
+    for (i = b->start[bucket]; i < b->start[bucket + 1]; i++) {
+        for (j = b->start[bucket]; j < i; j++) {
+            x = &b->keys[b->members[i]];
+            y = &b->keys[b->members[j]];
+            if (x->f1 != y->f1 || x->f2 != y->f2) {
+                continue;
+            }
+            if (b->hashes[b->members[i]] == b->hashes[b->members[j]]) {
+                errno = EINVAL;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Searches displacements in order, `d1` first: the first one sending every key
+ * of `bucket` to a distinct free index is kept, and the indexes taken.
+ */
+static bool
+place_bucket(PerfectHash *ph, Builder *b, uint32_t bucket)
+{
+    uint32_t first, size, d0, d1, i, j, p;
+    const Key *k;
+
+    first = b->start[bucket];
+    size = b->start[bucket + 1] - first;
+    for (d0 = 0; d0 < MAX_D0; d0++) {
+        for (d1 = 0; d1 < b->n; d1++) {
+            for (i = 0; i < size; i++) {
+                k = &b->keys[b->members[first + i]];
+                p = (uint32_t)(((uint64_t)k->f1 + (uint64_t)d0 * k->f2 + d1) %
+                               b->n);
+                if (b->taken[p]) {
+                    break;
+                }
+                for (j = 0; j < i && b->positions[j] != p; j++)
+                    ;
+                if (j < i) {
+                    break;
+                }
+                b->positions[i] = p;
+            }
+            if (i == size) {
+                for (i = 0; i < size; i++) {
+                    b->taken[b->positions[i]] = true;
+                }
+                ph->displacements[bucket].d0 = d0;
+                ph->displacements[bucket].d1 = d1;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+ * Places the buckets from `order[from]` on, of one key at most, each onto the
+ * next free index: `d1` alone moves a single key anywhere.  Empty buckets keep
+ * a null displacement.
+ */
+static void
+place_singletons(PerfectHash *ph, Builder *b, uint32_t from)
+{
+    uint32_t i, p, bucket;
+    const Key *k;
+
+    for (i = from, p = 0; i < ph->nbuckets; i++) {
+        bucket = b->order[i];
+        if (b->start[bucket + 1] == b->start[bucket]) {
+            break;
+        }
+        while (b->taken[p]) {
+            p++;
+        }
+        k = &b->keys[b->members[b->start[bucket]]];
+        ph->displacements[bucket].d1 = (p + b->n - k->f1) % b->n;
+        b->taken[p] = true;
+    }
+}
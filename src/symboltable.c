@@ -1,232 +1,553 @@
-#define _POSIX_C_SOURCE 200809L     /* strdup() */
 #include <assert.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "arena.h"
+#include "common/predefined.h"
 #include "common/shared_defs.h"
-#include "hashtable_adt.h"
+#include "hashfuncs.h"
+#include "hashtable_tmpl.h"
+#include "perfecthash.h"
 #include "symboltable.h"
 
+/* Generated at build time, `predefined_index()` */
+#include "predefined_match.h"
+
 /*
- * Rationale behind the manifest constant `MAX_SYMBOL` that defines the
- * permissible environment of SymbolAddressPairs.
+ * Rationale behind the manifest constant `INITIAL_SYMBOLS`.
  *
- * In addition to determining the initial size of the hash table to allocate,
- * it imposes an upper bound on the number of symbol-value pairs that the
- * compilation process can introduce at runtime.
- * 
- * This constant simplifies the task of monitoring environment symbols, which is
- * crucial for the proper deallocation of the abstract data type (ADT). 
+ * It only determines the initial size of the hash table to allocate, the table
+ * grows as needed.  It is not a limit on the number of symbols.
  * 
  * The choice of the value is influenced by reference.  The file `Pong.asm` 
  * declares approximately 900 distinct identifiers.  Determined by the 
  * command `cat Pong.asm | grep ^\( | sort | uniq | wc --lines`
  */
-#define MAX_SYMBOL 2048    
-
-
-/********************************************************** Data declarations */
-
-static HashTableADT *Table = NULL;
-
-static SymbolAddressPair ProgramSymbols[MAX_SYMBOL];  /* Runtime environment */
-static uint16_t SymbolCount = 0;
-
-static const SymbolAddressPair PredefinedSymbols[] = {
-    {0x0000, "R0"},     {0x0000, "SP"},  
-    {0x0001, "R1"},     {0x0001, "LCL"}, 
-    {0x0002, "R2"},     {0x0002, "ARG"},
-    {0x0003, "R3"},     {0x0003, "THIS"},
-    {0x0004, "R4"},     {0x0004, "THAT"},
-    {0x0005, "R5"},
-    {0x0006, "R6"},
-    {0x0007, "R7"},
-    {0x0008, "R8"},     
-    {0x0009, "R9"},     
-    {0x000A, "R10"},
-    {0x000B, "R11"},
-    {0x000C, "R12"},    
-    {0x000D, "R13"},    
-    {0x000E, "R14"},    
-    {0x000F, "R15"},    
-    {0x4000, "SCREEN"},
-    {0x6000, "KBD"},
+#define INITIAL_SYMBOLS 2048    
+#define SIDE_SYMBOLS 256        /* Initial size once frozen, variables mostly */
+#define HOT_BITS 6              /* log2 of the entries of the hot cache */
+#define HOT_ENTRIES (1 << HOT_BITS)
+
+#define NO_ID UINT32_MAX
+
+#define NAME_HASH(k) hash_wyhash((k).str, (k).len)
+#define NAME_EQ(a, b) \
+    ((a).len == (b).len && memcmp((a).str, (b).str, (a).len) == 0)
+
+
+/*********************************************************** Data Definitions */
+
+/*
+ * Key of the hash table, a name and its length.  `str` points to the copy of
+ * the name in the arena.
+ */
+typedef struct Name {
+    const char *str;
+    size_t len;
+} Name;
+
+/*
+ * `SymbolMap` maps names to IDs, stored in the slots.  The slots are drawn
+ * from the arena, like the names.
+ */
+DEFINE_HASHTABLE(SymbolMap, Name, uint32_t, NAME_HASH, NAME_EQ)
+
+/*
+ * A frozen symbol, at its index in the perfect hash.  `tag` holds the low bits
+ * of the hash of the name, so most misses never read the name in the blob.
+ * `address` is `ERROR` if the symbol was unbound when frozen.
+ */
+typedef struct frozen_slot {
+    uint32_t name;                  /* Offset in `blob` */
+    uint32_t len;
+    uint32_t id;
+    uint16_t address;
+    uint16_t tag;
+} FrozenSlot;
+
+/*
+ * An entry of the hot cache, empty while `id` is `NO_ID`.  `name` is the copy
+ * in the arena, never the caller's.
+ */
+typedef struct hot_entry {
+    const char *name;
+    uint32_t len;
+    uint32_t id;
+} HotEntry;
+
+/*
+ * Datatype completion for `SymbolTable`:
+ *
+ * Every symbol is interned: the first time it is seen it gets the next ID, and
+ * its address lives in `addresses` at that index.  The predefined symbols own
+ * the first IDs, their index in `PredefinedSymbols`, and are matched by the
+ * generated `predefined_index()`.  The hash table maps every other name to its
+ * ID, inline.  The name of every symbol is allocated from `arena`, and the
+ * hash table keys point to it.
+ *
+ * Names and kinds are kept apart from `addresses`, only the symbol maps
+ * written after the assembly ever read them.
+ *
+ * Once frozen, the symbols interned so far are looked up by `frozen` instead,
+ * and the hash table starts over empty, a side table for the symbols interned
+ * later.
+ *
+ * `hot` caches the last symbol interned at each of its entries, checked before
+ * hashing.  Only interning reads and fills it, `symbol_table_get_addr()` leaves
+ * it alone, so concurrent lookups never write.
+ */
+typedef struct symbol_info {
+    const char *name;
+    SymbolKind kind;                /* Meaningful once bound */
+} SymbolInfo;
+
+struct symbol_table_type {
+    Arena *arena;
+    SymbolMap table;
+    uint16_t *addresses;            /* By ID, `ERROR` while unbound */
+    SymbolInfo *info;               /* By ID */
+    uint32_t count;                 /* IDs handed out */
+    uint32_t capacity;              /* Entries allocated in both arrays */
+    PerfectHash *frozen;            /* `NULL` until frozen */
+    FrozenSlot *slots;              /* By index in `frozen` */
+    char *blob;                     /* Frozen names, in the order of `slots` */
+    uint32_t nfrozen;
+    HotEntry hot[HOT_ENTRIES];
+    unsigned long hot_hits;
+    unsigned long hot_misses;
 };
 
 
 /******************************************************* Private Declarations */
 
-static inline HashFunction djb2;
+static uint32_t new_id(SymbolTable *, const char *, size_t);
+static inline size_t hot_index(const char *, size_t);
+static const FrozenSlot *find_frozen(const SymbolTable *, Name);
+static void release_frozen(SymbolTable *);
 
 
 /***************************************************** Public Implementations */
 
 /*
- * Failure to insert a predefined symbol results in main program termination.  
+ * The predefined symbols take the first IDs, bound to their addresses.  They
+ * are never inserted in the hash table.
  */
-void 
+SymbolTable *
 symbol_table_init(void)
 {
-    uint16_t i;
-
-    Table = cadthashtable_new(MAX_SYMBOL, djb2);
+    SymbolTable *st;
+    Allocator mem;
+    uint32_t i;
+
+    if ((st = calloc(1, sizeof(SymbolTable))) == NULL) {
+        perror("symbol_table_init calloc");
+        errno = ENOMEM;
+        return NULL;
+    }
 
-    if (Table == NULL) {
-        perror("symbol_table_init cadthashtable_new");
-        return;
+    if ((st->arena = arena_init(0)) == NULL) {
+        free(st);
+        return NULL;
+    }
+    mem = arena_allocator(st->arena);
+    if (!SymbolMap_init(&st->table, INITIAL_SYMBOLS, &mem)) {
+        perror("symbol_table_init SymbolMap_init");
+        arena_destroy(st->arena);
+        free(st);
+        return NULL;
     }
 
+    st->capacity = INITIAL_SYMBOLS;
+    st->addresses = malloc(INITIAL_SYMBOLS * sizeof(uint16_t));
+    st->info = malloc(INITIAL_SYMBOLS * sizeof(SymbolInfo));
+    if (st->addresses == NULL || st->info == NULL) {
+        perror("symbol_table_init malloc");
+        symbol_table_destroy(st);
+        errno = ENOMEM;
+        return NULL;
+    }
     for (i = 0; i < ARRAY_SIZE(PredefinedSymbols); i++) {
-        errno = 0;
-        cadthashtable_insert(Table, PredefinedSymbols[i].symbol, 
-                              strlen(PredefinedSymbols[i].symbol)+1,
-                              (void *)&PredefinedSymbols[i].bits);
-        if (errno != 0) {
-            perror("symbol_table_init cadthashtable_insert");
-            errno = ENOTRECOVERABLE;
-            return;
-        }
+        st->addresses[i] = PredefinedSymbols[i].bits;
+        st->info[i].name = PredefinedSymbols[i].symbol;
+        st->info[i].kind = SYMBOL_PREDEFINED;
     }
+    st->count = ARRAY_SIZE(PredefinedSymbols);
+    for (i = 0; i < HOT_ENTRIES; i++) {
+        st->hot[i].id = NO_ID;
+    }
+    return st;
 }
 
 /*
- * Set `errno` and returns if `MAX_SYMBOL` is reached or an error occurs.  Makes
- * a copy of the new symbol and stores it, if possible, with its corresponding
- * address.  
+ * Set `errno` and returns if an error occurs.  The symbol may have been
+ * interned already, by a use ahead of its definition, but not bound.
  */
 void 
-symbol_table_add_entry(const char *symbol, const uint16_t addr)
+symbol_table_add_entry(SymbolTable *st, const char *symbol, const uint16_t addr)
 {
-    char *p;
+    uint32_t id;
 
-    if (SymbolCount == MAX_SYMBOL - ARRAY_SIZE(PredefinedSymbols)) {
-        fprintf(stderr, "MAX_SYMBOL reached");
-        errno = EPERM;
+    errno = 0;
+    if ((id = symbol_table_intern(st, symbol)) == NO_ID) {
         return;
     }
+    symbol_table_bind(st, id, addr, SYMBOL_LABEL);
+}
 
-    errno = 0;
-    if ((p = strdup(symbol)) == NULL) {
-        perror("symbol_add_entry strdup");
-        errno = ENOTRECOVERABLE;
-        return;
+/*
+ * A predefined symbol is matched without hashing, and so is a symbol found in
+ * the hot cache.  Any other is looked up, frozen first, only a miss goes
+ * through `new_id()`.  Whatever the outcome, the symbol takes over its entry of
+ * the hot cache.  Sets `errno` and returns `UINT32_MAX` if an error occurs.
+ */
+uint32_t
+symbol_table_intern(SymbolTable *st, const char *symbol)
+{
+    const FrozenSlot *s;
+    uint32_t *found, id;
+    HotEntry *hot;
+    Name key;
+
+    assert(symbol != NULL);
+
+    key.str = symbol;
+    key.len = strlen(symbol);
+    if ((id = predefined_index(symbol, key.len)) != NO_ID) {
+        return id;
     }
 
-    ProgramSymbols[SymbolCount].symbol = p;
-    ProgramSymbols[SymbolCount].bits = addr;
+    hot = &st->hot[hot_index(symbol, key.len)];
+    if (hot->id != NO_ID && hot->len == key.len &&
+        memcmp(hot->name, symbol, key.len) == 0) {
+        st->hot_hits++;
+        return hot->id;
+    }
+    st->hot_misses++;
+
+    if ((s = find_frozen(st, key)) != NULL) {
+        id = s->id;
+    } else if ((found = SymbolMap_find(&st->table, key)) != NULL) {
+        id = *found;
+    } else if ((id = new_id(st, symbol, key.len)) == NO_ID) {
+        return NO_ID;
+    }
+    hot->name = st->info[id].name;
+    hot->len = (uint32_t)key.len;
+    hot->id = id;
+    return id;
+}
 
-    errno = 0;
-    cadthashtable_insert(Table, symbol, strlen(symbol)+1,
-                            &ProgramSymbols[SymbolCount].bits);
-    if (errno == EEXIST) {
-        fprintf(stderr, "symbol_add_entry duplicate symbol");
-        free(p);
-        errno = ENOTRECOVERABLE;
-        return;
+uint16_t
+symbol_table_lookup_or_insert(SymbolTable *st, const char *symbol,
+                              uint32_t *id)
+{
+    if ((*id = symbol_table_intern(st, symbol)) == NO_ID) {
+        return ERROR;
     }
-    if (errno != 0) {
-        fprintf(stderr, "symbol_add_entry cadthashtable_insert");
-        free(p);
+    return st->addresses[*id];
+}
+
+void
+symbol_table_bind(SymbolTable *st, uint32_t id, uint16_t addr, SymbolKind kind)
+{
+    assert(id < st->count);
+
+    if (st->addresses[id] != ERROR) {
+        fprintf(stderr, "symbol_table_bind duplicate symbol");
         errno = ENOTRECOVERABLE;
         return;
     }
+    st->addresses[id] = addr;
+    st->info[id].kind = kind;
+}
+
+uint16_t
+symbol_table_address(const SymbolTable *st, uint32_t id)
+{
+    assert(id < st->count);
+
+    return st->addresses[id];
+}
+
+uint32_t
+symbol_table_count(const SymbolTable *st)
+{
+    return st->count;
+}
 
-    SymbolCount++;
+const char *
+symbol_table_name(const SymbolTable *st, uint32_t id)
+{
+    assert(id < st->count);
+
+    return st->info[id].name;
 }
 
+SymbolKind
+symbol_table_kind(const SymbolTable *st, uint32_t id)
+{
+    assert(id < st->count);
+
+    return st->info[id].kind;
+}
 
-bool symbol_table_contains(const char *symbol)
+bool symbol_table_contains(SymbolTable *st, const char *symbol)
 {
-    return cadthashtable_lookup(Table, symbol, strlen(symbol)+1) != NULL;
+    return symbol_table_get_addr(st, symbol) != ERROR;
 }
 
 /*
  * One of the reasons for encapsulating the symbol table within an additional
  * module is to hide the need for explicit type casting improving readability.
  */
-uint16_t symbol_table_get_addr(const char *symbol)
+uint16_t symbol_table_get_addr(SymbolTable *st, const char *symbol)
 {
-    uint16_t *addr;
+    const FrozenSlot *s;
+    uint32_t *id, index;
+    Name key;
 
     assert(symbol != NULL);
 
-    addr = (uint16_t*)cadthashtable_lookup(Table, symbol, strlen(symbol)+1);
+    key.str = symbol;
+    key.len = strlen(symbol);
+    if ((index = predefined_index(symbol, key.len)) != NO_ID) {
+        return PredefinedSymbols[index].bits;
+    }
 
-    if (addr == NULL) {
+    if ((s = find_frozen(st, key)) != NULL) {
+        return s->address != ERROR ? s->address : st->addresses[s->id];
+    }
+    if ((id = SymbolMap_find(&st->table, key)) == NULL) {
         return ERROR;
     }
-    return *addr;
+    return st->addresses[*id];
 }
 
 /*
- * Memory deallocation:
- *
- * The first loop eliminates runtime symbols.  Always safe to execute. If no
- * symbols have been loaded into the table, the condition guards against any
- * issues.
- *
- * The second loop checks if the symbol is in the table before each deletion 
- * for avoiding a potential crash.  Observe this routine can be called when  
- * `symbol_table_init` only partially loads the predefined symbols.
- *
- * The final check against `NULL` is in place because this function might be
- * called on an uninitialized symbol table.
+ * The names are hashed once, for both the perfect hash and the tags, and copied
+ * to the blob walking the slots in order.  The new side table is set up before
+ * anything is released, so a failure leaves the table as it was.
  */
-void symbol_table_destroy(void) 
-{ 
-    uint16_t i;
-
-    for (i = 0; i < SymbolCount; i++)
-    {
-        void * e;
-        errno = 0;
-        e = cadthashtable_delete(Table, ProgramSymbols[i].symbol, 
-                                  strlen(ProgramSymbols[i].symbol)+1,
-                                  &ProgramSymbols[i].bits);
-
-        assert(e == &ProgramSymbols[i].bits);
+bool
+symbol_table_freeze(SymbolTable *st)
+{
+    PerfectHash *frozen;
+    FrozenSlot *slots, *s;
+    SymbolMap side;
+    Allocator mem;
+    size_t *hashes, size, len;
+    uint32_t first, n, i;
+    char *blob;
+
+    first = ARRAY_SIZE(PredefinedSymbols);
+    if ((n = st->count - first) == 0) {
+        return true;
+    }
+    mem = arena_allocator(st->arena);
 
-        free(ProgramSymbols[i].symbol);
+    if ((hashes = malloc(n * sizeof(size_t))) == NULL) {
+        perror("symbol_table_freeze malloc");
+        errno = ENOMEM;
+        return false;
+    }
+    size = 0;
+    for (i = 0; i < n; i++) {
+        len = strlen(st->info[first + i].name);
+        hashes[i] = hash_wyhash(st->info[first + i].name, len);
+        size += len;
     }
 
-    for (i = 0; i < ARRAY_SIZE(PredefinedSymbols); i++) {
-        if (symbol_table_contains(PredefinedSymbols[i].symbol)) {
-        errno = 0;
-        (cadthashtable_delete(Table, PredefinedSymbols[i].symbol, 
-                               strlen(PredefinedSymbols[i].symbol)+1,
-                               (void *) &PredefinedSymbols[i].bits));
+    errno = 0;
+    frozen = perfecthash_build(hashes, n);
+    slots = malloc(n * sizeof(FrozenSlot));
+    blob = malloc(size);
+    if (frozen == NULL || slots == NULL || blob == NULL ||
+        !SymbolMap_init(&side, SIDE_SYMBOLS, &mem)) {
+        /* Names whose hashes collide can't be frozen, they are simply not */
+        if (errno == EINVAL) {
+            errno = 0;
         } else {
-            break;
+            perror("symbol_table_freeze");
         }
+        perfecthash_destroy(frozen);
+        free(slots);
+        free(blob);
+        free(hashes);
+        return errno == 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        s = &slots[perfecthash_index(frozen, hashes[i])];
+        s->id = first + i;
+        s->tag = (uint16_t)hashes[i];
+        s->address = st->addresses[first + i];
     }
-    
-    if (Table != NULL) {
-        cadthashtable_destroy(Table);
+    for (i = 0, size = 0; i < n; i++) {
+        s = &slots[i];
+        s->len = (uint32_t)strlen(st->info[s->id].name);
+        s->name = (uint32_t)size;
+        memcpy(blob + size, st->info[s->id].name, s->len);
+        size += s->len;
     }
+    free(hashes);
+
+    release_frozen(st);
+    SymbolMap_destroy(&st->table);
+    st->table = side;
+    st->frozen = frozen;
+    st->slots = slots;
+    st->blob = blob;
+    st->nfrozen = n;
+    return true;
+}
+
+uint32_t
+symbol_table_frozen(const SymbolTable *st)
+{
+    return st->nfrozen;
+}
+
+void
+symbol_table_cache_stats(const SymbolTable *st, unsigned long *hits,
+                         unsigned long *misses)
+{
+    *hits = st->hot_hits;
+    *misses = st->hot_misses;
+}
+
+/*
+ * Statistics of the hash table behind the symbols.
+ */
+void
+symbol_table_stats(SymbolTable *st, HashTableStats *stats)
+{
+    SymbolMap_stats(&st->table, stats);
+}
+
+/*
+ * Every name and slot lives in the arena, so there is nothing to delete entry
+ * by entry.
+ */
+void symbol_table_destroy(SymbolTable *st) 
+{ 
+    if (st == NULL) {
+        return;
+    }
+
+    SymbolMap_destroy(&st->table);
+    release_frozen(st);
+    arena_destroy(st->arena);
+    free(st->addresses);
+    free(st->info);
+    free(st);
 }
 
 
 /**************************************************** Private implementations */
 
 /*
- * Hash function for the ADT.  Slightly modified to match the signature
- * required.  
- * http://www.cse.yorku.ca/~oz/hash.html
+ * Hands out the next ID to the `len` bytes `symbol`, unbound, growing both
+ * arrays by doubling.  The name is copied to the arena, the hash table key
+ * points to the copy.  Returns `NO_ID` setting `errno` on failure.
+ */
+static uint32_t
+new_id(SymbolTable *st, const char *symbol, size_t len)
+{
+    uint16_t *addresses;
+    SymbolInfo *info;
+    uint32_t capacity;
+    char *name;
+    Name key;
+
+    if (st->count == st->capacity) {
+        capacity = st->capacity * 2;
+        addresses = realloc(st->addresses, capacity * sizeof(uint16_t));
+        if (addresses != NULL) {
+            st->addresses = addresses;
+        }
+        info = realloc(st->info, capacity * sizeof(SymbolInfo));
+        if (info != NULL) {
+            st->info = info;
+        }
+        if (addresses == NULL || info == NULL) {
+            perror("symbol_table_intern realloc");
+            errno = ENOTRECOVERABLE;
+            return NO_ID;
+        }
+        st->capacity = capacity;
+    }
+
+    if ((name = arena_alloc(st->arena, len + 1)) == NULL) {
+        perror("symbol_table_intern arena_alloc");
+        errno = ENOTRECOVERABLE;
+        return NO_ID;
+    }
+    memcpy(name, symbol, len + 1);
+
+    key.str = name;
+    key.len = len;
+    errno = 0;
+    if (SymbolMap_insert(&st->table, key, st->count) == NULL) {
+        fprintf(stderr, "symbol_table_intern SymbolMap_insert");
+        errno = ENOTRECOVERABLE;
+        return NO_ID;
+    }
+
+    st->addresses[st->count] = ERROR;
+    st->info[st->count].name = name;
+    st->info[st->count].kind = SYMBOL_LABEL;
+    return st->count++;
+}
+
+/*
+ * Generated code tells its symbols apart by their last bytes, `$ret.12` or
+ * `.WHILE_END3`: up to 8 of them and the length pick the entry of the hot
+ * cache.
  */
-size_t 
-djb2(const void *str, size_t keysize)
+static inline size_t
+hot_index(const char *symbol, size_t len)
 {
-    unsigned long hash = 5381;
-    int c;
-    char *key = (char*)str;
+    uint64_t tail = 0;
+    size_t n;
 
-    (void) keysize;
+    n = len < sizeof(tail) ? len : sizeof(tail);
+    memcpy(&tail, symbol + len - n, n);
+    return (size_t)(((tail ^ len) * 0x9E3779B97F4A7C15ULL) >> (64 - HOT_BITS));
+}
+
+/*
+ * The frozen slot of `key`, if it was interned before the table was frozen.  A
+ * lookup reads the displacement of its bucket, then the slot, then only if the
+ * tag and the length match, the name in the blob.
+ */
+static const FrozenSlot *
+find_frozen(const SymbolTable *st, Name key)
+{
+    const FrozenSlot *s;
+    size_t h;
 
-    while ((c = *key++)) {
-        hash = ((hash << 5) + hash) + (unsigned long)c; /* hash * 33 + c */
+    if (st->frozen == NULL) {
+        return NULL;
+    }
+    h = hash_wyhash(key.str, key.len);
+    s = &st->slots[perfecthash_index(st->frozen, h)];
+    if (s->tag != (uint16_t)h || s->len != key.len ||
+        memcmp(st->blob + s->name, key.str, key.len) != 0) {
+        return NULL;
     }
+    return s;
+}
 
-    return hash;
+static void
+release_frozen(SymbolTable *st)
+{
+    perfecthash_destroy(st->frozen);
+    free(st->slots);
+    free(st->blob);
+    st->frozen = NULL;
+    st->slots = NULL;
+    st->blob = NULL;
+    st->nfrozen = 0;
 }
@@ -0,0 +1,313 @@
+#define _POSIX_C_SOURCE 200809L     /* mmap() */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/shared_defs.h"
+#include "symmap.h"
+
+
+/*********************************************************** Data Definitions */
+
+/*
+ * A bound symbol, as sorted before writing.
+ */
+typedef struct Symbol {
+    SymMapSpace space;
+    uint16_t address;
+    SymbolKind kind;
+    const char *name;
+} Symbol;
+
+/*
+ * Datatype completion for `SymMap`:
+ */
+struct symmap_type {
+    void *map;
+    size_t size;
+    const SymMapHeader *header;
+    const SymMapEntry *entries;
+    const char *names;
+};
+
+
+/********************************************************** Data declarations */
+
+static const char *const KindNames[] = {
+    [SYMBOL_PREDEFINED] = "predefined",
+    [SYMBOL_LABEL] = "label",
+    [SYMBOL_VARIABLE] = "variable",
+};
+
+
+/******************************************************* Private Declarations */
+
+static Symbol *sorted_symbols(const SymbolTable *, uint32_t *);
+static int compare_symbols(const void *, const void *);
+static bool is_valid(const SymMap *);
+
+
+/***************************************************** Public Implementations */
+
+bool
+symmap_write_text(const SymbolTable *st, FILE *out)
+{
+    Symbol *symbols;
+    uint32_t n, i;
+
+    if ((symbols = sorted_symbols(st, &n)) == NULL) {
+        return false;
+    }
+    for (i = 0; i < n; i++) {
+        fprintf(out, "%s %04X %-10s %s\n",
+                symbols[i].space == SYMMAP_ROM ? "ROM" : "RAM",
+                symbols[i].address, KindNames[symbols[i].kind],
+                symbols[i].name);
+    }
+    free(symbols);
+
+    if (ferror(out)) {
+        errno = EIO;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The header, the entries and the names are written in turn.  Name offsets
+ * are known beforehand, adding up the lengths.
+ */
+bool
+symmap_write_snapshot(const SymbolTable *st, const char *path)
+{
+    SymMapHeader header;
+    SymMapEntry entry;
+    Symbol *symbols;
+    uint32_t n, i, offset;
+    FILE *out;
+    bool ok;
+
+    if ((symbols = sorted_symbols(st, &n)) == NULL) {
+        return false;
+    }
+    if ((out = fopen(path, "wb")) == NULL) {
+        perror("symmap_write_snapshot fopen");
+        free(symbols);
+        return false;
+    }
+
+    memcpy(header.magic, SYMMAP_MAGIC, sizeof(header.magic));
+    header.version = SYMMAP_VERSION;
+    header.count = n;
+    header.names = (uint32_t)(sizeof(SymMapHeader) + n * sizeof(SymMapEntry));
+    fwrite(&header, sizeof(header), 1, out);
+
+    memset(&entry, 0, sizeof(entry));
+    for (i = 0, offset = 0; i < n; i++) {
+        entry.address = symbols[i].address;
+        entry.space = (uint8_t)symbols[i].space;
+        entry.kind = (uint8_t)symbols[i].kind;
+        entry.name = offset;
+        fwrite(&entry, sizeof(entry), 1, out);
+        offset += (uint32_t)strlen(symbols[i].name) + 1;
+    }
+    for (i = 0; i < n; i++) {
+        fwrite(symbols[i].name, strlen(symbols[i].name) + 1, 1, out);
+    }
+    free(symbols);
+
+    ok = !ferror(out);
+    if (fclose(out) != 0 || !ok) {
+        perror("symmap_write_snapshot");
+        errno = EIO;
+        return false;
+    }
+    return true;
+}
+
+SymMap *
+symmap_open(const char *path)
+{
+    struct stat sb;
+    SymMap *map;
+    int fd, error;
+
+    if ((map = calloc(1, sizeof(SymMap))) == NULL) {
+        perror("symmap_open calloc");
+        errno = ENOMEM;
+        return NULL;
+    }
+    if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &sb) == -1) {
+        goto fail;
+    }
+    if ((size_t)sb.st_size < sizeof(SymMapHeader)) {
+        errno = EINVAL;
+        goto fail;
+    }
+
+    map->size = (size_t)sb.st_size;
+    map->map = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map->map == MAP_FAILED) {
+        goto fail;
+    }
+    close(fd);
+
+    map->header = map->map;
+    map->entries = (const SymMapEntry *)(map->header + 1);
+    if (!is_valid(map)) {
+        symmap_close(map);
+        errno = EINVAL;
+        return NULL;
+    }
+    map->names = (const char *)map->map + map->header->names;
+    return map;
+
+/* `perror()` itself may leave `errno` set to something else */
+fail:
+    error = errno;
+    perror("symmap_open");
+    if (fd != -1) {
+        close(fd);
+    }
+    free(map);
+    errno = error;
+    return NULL;
+}
+
+uint32_t
+symmap_count(const SymMap *map)
+{
+    return map->header->count;
+}
+
+/*
+ * Finds the first entry not below `space` and `address`, the entries being
+ * sorted by both.
+ */
+const char *
+symmap_find(const SymMap *map, SymMapSpace space, uint16_t address)
+{
+    const SymMapEntry *e;
+    uint32_t lo, hi, mid;
+
+    lo = 0;
+    hi = map->header->count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        e = &map->entries[mid];
+        if (e->space < space || (e->space == space && e->address < address)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == map->header->count) {
+        return NULL;
+    }
+    e = &map->entries[lo];
+    if (e->space != space || e->address != address) {
+        return NULL;
+    }
+    return map->names + e->name;
+}
+
+void
+symmap_close(SymMap *map)
+{
+    if (map == NULL) {
+        return;
+    }
+    munmap(map->map, map->size);
+    free(map);
+}
+
+
+/**************************************************** Private implementations */
+
+/*
+ * Returns the `n` symbols bound in `st`, sorted, in an array to be freed by the
+ * caller.  Returns `NULL` setting `errno` on failure.
+ */
+static Symbol *
+sorted_symbols(const SymbolTable *st, uint32_t *n)
+{
+    Symbol *symbols;
+    uint32_t id, count;
+    uint16_t address;
+
+    count = symbol_table_count(st);
+    if ((symbols = malloc(count * sizeof(Symbol))) == NULL) {
+        perror("symmap malloc");
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    *n = 0;
+    for (id = 0; id < count; id++) {
+        if ((address = symbol_table_address(st, id)) == ERROR) {
+            continue;
+        }
+        symbols[*n].kind = symbol_table_kind(st, id);
+        symbols[*n].space =
+            symbols[*n].kind == SYMBOL_LABEL ? SYMMAP_ROM : SYMMAP_RAM;
+        symbols[*n].address = address;
+        symbols[*n].name = symbol_table_name(st, id);
+        (*n)++;
+    }
+    qsort(symbols, *n, sizeof(Symbol), compare_symbols);
+    return symbols;
+}
+
+static int
+compare_symbols(const void *a, const void *b)
+{
+    const Symbol *x = a, *y = b;
+
+    if (x->space != y->space) {
+        return x->space < y->space ? -1 : 1;
+    }
+    if (x->address != y->address) {
+        return x->address < y->address ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+/*
+ * Whether the mapped file is a snapshot this build can read: its entries fit,
+ * and so does every name, null-terminated.
+ */
+static bool
+is_valid(const SymMap *map)
+{
+    const SymMapHeader *h = map->header;
+    const char *names;
+    size_t names_size;
+    uint32_t i;
+
+    if (memcmp(h->magic, SYMMAP_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != SYMMAP_VERSION ||
+        h->names != sizeof(SymMapHeader) + (size_t)h->count *
+                    sizeof(SymMapEntry) ||
+        h->names > map->size) {
+        return false;
+    }
+
+    names = (const char *)map->map + h->names;
+    names_size = map->size - h->names;
+    if (h->count != 0 &&
+        (names_size == 0 || names[names_size - 1] != '\0')) {
+        return false;
+    }
+    for (i = 0; i < h->count; i++) {
+        if (map->entries[i].name >= names_size) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -1,24 +1,59 @@
 #!/bin/env sh
 
-# Runs the assembler on each .asm file supplied for testing.  
+# Runs the assembler on each .asm file supplied for testing, once per mode.
 # Compares the output against correctly compiled files. Aborts and exits on 
 # failure, removes the produced output on success.
 
 test_files_folder="tests/resources/asm-files"
 comparison_folder="tests/resources/expected-output"
 
+for mode in "" "-s" "-j 4"; do
+  for asm_file in "$test_files_folder"/*.asm; do
+
+    file=$(basename "$asm_file")
+    file_no_ext="${file%.asm}"
+
+    ./bin/hackassembler $mode "$asm_file" 
+
+    diff "$test_files_folder/$file_no_ext.hack" "$comparison_folder/$file_no_ext.hack" > /dev/null 2>&1
+    if [ ! $? -eq 0 ]; then
+      echo "Failed comparison ($mode): $test_files_folder/$file_no_ext.hack $comparison_folder/$file_no_ext.hack"
+      exit 1
+    else
+      rm "$test_files_folder/$file_no_ext.hack"
+    fi
+  done
+done
+
+# The same files again, piped through the standard input and output.
 for asm_file in "$test_files_folder"/*.asm; do
 
   file=$(basename "$asm_file")
   file_no_ext="${file%.asm}"
 
-  ./bin/hackassembler "$asm_file" 
-
-  diff "$test_files_folder/$file_no_ext.hack" "$comparison_folder/$file_no_ext.hack" > /dev/null 2>&1
+  cat "$asm_file" | ./bin/hackassembler - | diff - "$comparison_folder/$file_no_ext.hack" > /dev/null 2>&1
   if [ ! $? -eq 0 ]; then
-    echo "Failed comparison: $test_files_folder/$file_no_ext.hack $comparison_folder/$file_no_ext.hack"
+    echo "Failed comparison (pipe): $asm_file $comparison_folder/$file_no_ext.hack"
+    exit 1
+  fi
+done
+
+# Every format at once: the .hack still matches, and the raw image holds 2
+# bytes per line of it.
+for asm_file in "$test_files_folder"/*.asm; do
+
+  file=$(basename "$asm_file")
+  file_no_ext="${file%.asm}"
+  out="$test_files_folder/$file_no_ext"
+
+  ./bin/hackassembler -f hack -f bin -f binbe -f ihex -f readmemh "$asm_file"
+
+  lines=$(wc -l < "$comparison_folder/$file_no_ext.hack")
+  if ! diff "$out.hack" "$comparison_folder/$file_no_ext.hack" > /dev/null 2>&1 ||
+     [ "$(wc -c < "$out.bin")" -ne $((2 * lines)) ] ||
+     [ "$(wc -l < "$out.mem")" -ne "$lines" ]; then
+    echo "Failed comparison (formats): $asm_file"
     exit 1
-  else
-    rm "$test_files_folder/$file_no_ext.hack"
   fi
+  rm "$out.hack" "$out.bin" "$out.be.bin" "$out.hex" "$out.mem"
 done
@@ -0,0 +1,92 @@
+#include "minunit.h"
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include "../include/arena.h"
+
+static Arena *Ar;
+
+void test_setup(void)
+{
+    Ar = arena_init(1024);
+}
+
+void test_teardown(void)
+{
+    arena_destroy(Ar);
+}
+
+MU_TEST(test_arena_alloc)
+{
+    char *a, *b;
+
+    a = arena_alloc(Ar, 5);
+    b = arena_alloc(Ar, 3);
+    mu_check(a != NULL && b != NULL);
+    mu_check((uintptr_t)a % ARENA_ALIGN == 0);
+    mu_check((uintptr_t)b % ARENA_ALIGN == 0);
+    mu_check(b >= a + 5);
+
+    memcpy(a, "LOOP", 5);
+    memcpy(b, "i\0", 2);
+    mu_assert_string_eq("LOOP", a);
+    mu_assert_string_eq("i", b);
+    mu_assert_int_eq(2 * ARENA_ALIGN, (int)arena_used(Ar));
+}
+
+MU_TEST(test_arena_many_blocks)
+{
+    uint16_t *addr[5000];
+    int i;
+
+    for (i = 0; i < 5000; i++) {
+        addr[i] = arena_alloc(Ar, sizeof(uint16_t));
+        mu_check(addr[i] != NULL);
+        *addr[i] = (uint16_t)i;
+    }
+    for (i = 0; i < 5000; i++) {
+        mu_assert_int_eq(i, *addr[i]);
+    }
+}
+
+MU_TEST(test_arena_large)
+{
+    char *small, *large, *next;
+
+    small = arena_alloc(Ar, 16);
+    large = arena_alloc(Ar, 4096);
+    next = arena_alloc(Ar, 16);
+
+    /* The large block doesn't replace the one small requests bump through */
+    mu_check(large != NULL);
+    memset(large, 0xAA, 4096);
+    mu_check(next == small + 16);
+}
+
+MU_TEST(test_arena_allocator)
+{
+    Allocator mem = arena_allocator(Ar);
+    char *p;
+
+    p = mem.alloc(mem.ctx, 32);
+    mu_check(p != NULL);
+    mem.release(mem.ctx, p);
+    mu_assert_int_eq(32, (int)arena_used(Ar));
+}
+
+MU_TEST_SUITE(test_suite) 
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_arena_alloc);
+	MU_RUN_TEST(test_arena_many_blocks);
+	MU_RUN_TEST(test_arena_large);
+	MU_RUN_TEST(test_arena_allocator);
+}
+
+int main(int argc, char *argv[]) 
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
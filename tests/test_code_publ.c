@@ -64,6 +64,39 @@ MU_TEST(test_code_jump)
     mu_assert_int_eq(0x7, code_jump("JMP"));
 
     mu_assert_int_eq(ERROR, code_comp("Some nonsense"));
+    mu_assert_int_eq(ERROR, code_jump("Some nonsense"));
+}
+
+MU_TEST(test_code_near_misses)
+{
+    /* Prefixes, extensions and mnemonics of the wrong field */
+    mu_assert_int_eq(ERROR, code_dest("AMDA"));
+    mu_assert_int_eq(ERROR, code_dest("MA"));
+    mu_assert_int_eq(ERROR, code_dest("D+1"));
+    mu_assert_int_eq(ERROR, code_comp(""));
+    mu_assert_int_eq(ERROR, code_comp("D+"));
+    mu_assert_int_eq(ERROR, code_comp("D+1;"));
+    mu_assert_int_eq(ERROR, code_comp("1+D"));
+    mu_assert_int_eq(ERROR, code_comp("MD"));
+    mu_assert_int_eq(ERROR, code_jump("JM"));
+    mu_assert_int_eq(ERROR, code_jump("JMPS"));
+    mu_assert_int_eq(ERROR, code_jump("jmp"));
+    mu_assert_int_eq(ERROR, code_jump("D"));
+}
+
+MU_TEST(test_code_c_instruction)
+{
+    Field none = {"", 0};
+    Field m = {"M=D", 1}, d = {"D", 1}, dm = {"D|M;JMP", 3}, jmp = {"JMP", 3};
+    Field bad = {"X", 1};
+
+    mu_assert_int_eq(0xE308, code_c_instruction(m, d, none));
+    mu_assert_int_eq(0xF54F, code_c_instruction(m, dm, jmp));
+    mu_assert_int_eq(0xF547, code_c_instruction(none, dm, jmp));
+    mu_assert_int_eq(ERROR, code_c_instruction(bad, d, none));
+    mu_assert_int_eq(ERROR, code_c_instruction(none, bad, none));
+    mu_assert_int_eq(ERROR, code_c_instruction(none, d, bad));
+    mu_assert_int_eq(ERROR, code_c_instruction(none, none, none));
 }
 
 MU_TEST_SUITE(test_suite) 
@@ -72,6 +105,8 @@ MU_TEST_SUITE(test_suite)
 	MU_RUN_TEST(test_code_dest);
 	MU_RUN_TEST(test_code_comp);
 	MU_RUN_TEST(test_code_jump);
+	MU_RUN_TEST(test_code_near_misses);
+	MU_RUN_TEST(test_code_c_instruction);
 }
 
 int main(int argc, char *argv[]) 
@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+#include "minunit.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/emitter.h"
+
+#define NWORDS 20000                /* Fills the buffer a couple of times */
+
+static FILE *Output;
+static Emitter *Em;
+
+void test_setup(void)
+{
+    Output = tmpfile();
+    Em = emitter_init(fileno(Output), EMITTER_HACK);
+}
+
+void test_teardown(void)
+{
+    emitter_destroy(Em);
+    fclose(Output);
+}
+
+/*
+ * Formats `word` a bit at a time, as the assembler used to.
+ */
+static void reference_format(uint16_t word, char *line)
+{
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        line[i] = (word & (0x8000 >> i)) ? '1' : '0';
+    }
+    line[16] = '\n';
+}
+
+/*
+ * Whether `file` holds exactly the `size` bytes of `expected`.
+ */
+static int file_matches(FILE *file, const char *expected, size_t size)
+{
+    char *data;
+    int match;
+
+    data = malloc(size + 1);
+    rewind(file);
+    match = fread(data, 1, size + 1, file) == size &&
+            memcmp(data, expected, size) == 0;
+    free(data);
+    return match;
+}
+
+/*
+ * Emits `n` words in `format` to a file of its own, through `emitter_word()`
+ * then `emitter_words()` from the `split`-th on.  Returns the file, to be
+ * closed by the caller.
+ */
+static FILE *emit(EmitterFormat format, const uint16_t *words, size_t n,
+                  size_t split)
+{
+    Emitter *em;
+    FILE *file;
+    size_t i;
+
+    file = tmpfile();
+    em = emitter_init(fileno(file), format);
+    for (i = 0; i < split; i++) {
+        emitter_word(em, words[i]);
+    }
+    emitter_words(em, words + split, n - split);
+    emitter_finish(em);
+    emitter_destroy(em);
+    return file;
+}
+
+/*
+ * Whether the output holds exactly the lines of the words from 0 to `n` - 1.
+ */
+static int output_matches(unsigned n)
+{
+    char expected[HACKTEXT_LINE], line[HACKTEXT_LINE];
+    unsigned i;
+
+    rewind(Output);
+    for (i = 0; i < n; i++) {
+        reference_format((uint16_t)i, expected);
+        if (fread(line, 1, HACKTEXT_LINE, Output) != HACKTEXT_LINE ||
+            memcmp(line, expected, HACKTEXT_LINE) != 0) {
+            return 0;
+        }
+    }
+    return fgetc(Output) == EOF;
+}
+
+MU_TEST(test_emitter_words)
+{
+    unsigned i;
+
+    for (i = 0; i < NWORDS; i++) {
+        emitter_word(Em, (uint16_t)i);
+    }
+    mu_check(emitter_flush(Em));
+    mu_check(output_matches(NWORDS));
+}
+
+MU_TEST(test_emitter_bulk)
+{
+    uint16_t *words;
+    unsigned i;
+
+    /* Pending words go first, runs larger than the buffer are split */
+    words = malloc(NWORDS * sizeof(uint16_t));
+    for (i = 0; i < NWORDS; i++) {
+        words[i] = (uint16_t)i;
+    }
+    for (i = 0; i < 10; i++) {
+        emitter_word(Em, words[i]);
+    }
+    emitter_words(Em, words + 10, 3);
+    emitter_words(Em, words + 13, NWORDS - 13);
+    mu_check(emitter_flush(Em));
+    mu_check(output_matches(NWORDS));
+    free(words);
+}
+
+MU_TEST(test_emitter_formats)
+{
+    const uint16_t words[] = {0x0010, 0xE308, 0x7FFF};
+    FILE *file;
+
+    file = emit(EMITTER_BIN_LE, words, 3, 1);
+    mu_check(file_matches(file, "\x10\x00\x08\xE3\xFF\x7F", 6));
+    fclose(file);
+    file = emit(EMITTER_BIN_BE, words, 3, 1);
+    mu_check(file_matches(file, "\x00\x10\xE3\x08\x7F\xFF", 6));
+    fclose(file);
+    file = emit(EMITTER_READMEMH, words, 3, 1);
+    mu_check(file_matches(file, "0010\nE308\n7FFF\n", 15));
+    fclose(file);
+    file = emit(EMITTER_IHEX, words, 3, 1);
+    mu_check(file_matches(file, ":060000000010E3087FFF81\n:00000001FF\n", 36));
+    fclose(file);
+    file = emit(EMITTER_HACK, words, 3, 1);
+    mu_check(file_matches(file, "0000000000010000\n1110001100001000\n"
+                                "0111111111111111\n", 3 * HACKTEXT_LINE));
+    fclose(file);
+}
+
+MU_TEST(test_emitter_ihex)
+{
+    uint16_t words[NWORDS];
+    FILE *whole, *split;
+    char *expected;
+    long size;
+    unsigned i;
+
+    /* Full records at every 8th word, however the words were batched */
+    for (i = 0; i < NWORDS; i++) {
+        words[i] = (uint16_t)(i * 40503u);
+    }
+    whole = emit(EMITTER_IHEX, words, NWORDS, 0);
+    split = emit(EMITTER_IHEX, words, NWORDS, 13);
+    fseek(whole, 0, SEEK_END);
+    size = ftell(whole);
+    mu_check(size == (NWORDS / 8) * 44 + 12);
+    expected = malloc((size_t)size);
+    rewind(whole);
+    mu_check(fread(expected, 1, (size_t)size, whole) == (size_t)size);
+    mu_check(file_matches(split, expected, (size_t)size));
+    mu_check(memcmp(expected, ":10000000", 9) == 0);
+    mu_check(memcmp(expected + 44, ":10001000", 9) == 0);
+    free(expected);
+    fclose(whole);
+    fclose(split);
+}
+
+MU_TEST(test_emitter_format_names)
+{
+    EmitterFormat f;
+
+    for (f = EMITTER_HACK; f < EMITTER_FORMATS; f++) {
+        mu_check(emitter_format(emitter_format_name(f)) == f);
+    }
+    mu_check(emitter_format("elf") == EMITTER_FORMATS);
+    mu_check(strcmp(emitter_format_extension(EMITTER_IHEX), ".hex") == 0);
+}
+
+MU_TEST(test_emitter_error)
+{
+    Emitter *closed;
+    int fds[2];
+
+    mu_check(pipe(fds) == 0);
+    close(fds[1]);
+    mu_check((closed = emitter_init(fds[1], EMITTER_HACK)) != NULL);
+    emitter_word(closed, 0x0001);
+    errno = 0;
+    mu_check(emitter_flush(closed) == false);
+    mu_check(errno == EBADF);
+
+    /* Sticky */
+    mu_check(emitter_flush(closed) == false);
+    emitter_destroy(closed);
+    close(fds[0]);
+}
+
+MU_TEST_SUITE(test_suite)
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_emitter_words);
+	MU_RUN_TEST(test_emitter_bulk);
+	MU_RUN_TEST(test_emitter_formats);
+	MU_RUN_TEST(test_emitter_ihex);
+	MU_RUN_TEST(test_emitter_format_names);
+	MU_RUN_TEST(test_emitter_error);
+}
+
+int main(int argc, char *argv[])
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
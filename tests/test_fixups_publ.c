@@ -0,0 +1,61 @@
+#include "minunit.h"
+#include <errno.h>
+#include "../include/fixups.h"
+#include "../include/common/shared_defs.h"
+
+static Fixups *Fx;
+
+void test_setup(void)
+{
+    Fx = fixups_init();
+}
+
+void test_teardown(void)
+{
+    fixups_destroy(Fx);
+}
+
+MU_TEST(test_fixups_chain)
+{
+    errno = 0;
+    mu_assert_int_eq(ERROR, fixups_add(Fx, "END", 2));
+    mu_assert_int_eq(2, fixups_add(Fx, "END", 7));
+    mu_assert_int_eq(7, fixups_add(Fx, "END", 9));
+    mu_check(errno == 0);
+
+    mu_assert_int_eq(9, fixups_take(Fx, "END"));
+    mu_assert_int_eq(ERROR, fixups_take(Fx, "END"));
+    mu_assert_int_eq(ERROR, fixups_take(Fx, "nope"));
+}
+
+MU_TEST(test_fixups_next_pending)
+{
+    uint16_t head;
+
+    fixups_add(Fx, "i", 0);
+    fixups_add(Fx, "LOOP", 1);
+    fixups_add(Fx, "sum", 3);
+    fixups_add(Fx, "i", 4);
+    fixups_take(Fx, "LOOP");
+
+    mu_assert_string_eq("i", fixups_next_pending(Fx, &head));
+    mu_assert_int_eq(4, head);
+    mu_assert_string_eq("sum", fixups_next_pending(Fx, &head));
+    mu_assert_int_eq(3, head);
+    mu_check(fixups_next_pending(Fx, &head) == NULL);
+}
+
+MU_TEST_SUITE(test_suite) 
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_fixups_chain);
+	MU_RUN_TEST(test_fixups_next_pending);
+}
+
+int main(int argc, char *argv[]) 
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
@@ -1,28 +1,29 @@
+#define _POSIX_C_SOURCE 200809L
+#define CHUNK_LINES 4               /* Splits even the smallest test files */
 #include "minunit.h"
+#include <sys/wait.h>
 #include "../src/hackassembler.c"
 
+static Assembler As;
+
 void test_setup(void)
 {
-    OutputStream = tmpfile();
+    memset(&As, 0, sizeof(As));
+    As.outputs[0] = tmpfile();
+    As.emitters[0] = emitter_init(fileno(As.outputs[0]), EMITTER_HACK);
+    As.formats[0] = EMITTER_HACK;
+    As.nformats = 1;
     return;
 }
 
 void test_teardown(void)
 {
-    fclose(OutputStream);
+    emitter_destroy(As.emitters[0]);
+    fclose(As.outputs[0]);
+    free(As.program);
     return;
 }
 
-MU_TEST(test_num_to_address)
-{
-    mu_assert_int_eq(0x0000, num_to_address("0"));
-    mu_assert_int_eq(0x0AAA, num_to_address("2730"));
-    mu_assert_int_eq(0, num_to_address("0"));
-    mu_assert_int_eq(ERROR, num_to_address("-10"));
-    mu_assert_int_eq(ERROR, num_to_address("65535"));
-    mu_assert_int_eq(ERROR, num_to_address("100000"));
-}
-
 MU_TEST(test_write_to_binary_stream)
 {
     size_t i; 
@@ -32,27 +33,222 @@ MU_TEST(test_write_to_binary_stream)
                 "1011111011101111\n"
                 "0000000000000001\n";
 
-    Instruction = 0x0000;
-    write_to_binary_stream();
-    Instruction = 0xE000;
-    write_to_binary_stream();
-    Instruction = 0xBEEF;
-    write_to_binary_stream();
-    Instruction = 0x0001;
-    write_to_binary_stream();
+    As.instruction = 0x0000;
+    write_to_binary_stream(&As);
+    As.instruction = 0xE000;
+    write_to_binary_stream(&As);
+    As.instruction = 0xBEEF;
+    write_to_binary_stream(&As);
+    As.instruction = 0x0001;
+    write_to_binary_stream(&As);
 
-    rewind(OutputStream);
+    mu_check(emitter_flush(As.emitters[0]));
+    rewind(As.outputs[0]);
 
-    for (i = 0; ((c = fgetc(OutputStream)) != EOF); i++) {
+    for (i = 0; ((c = fgetc(As.outputs[0])) != EOF); i++) {
         mu_assert_int_eq(*(str + i), c);
     }
 }
 
+MU_TEST(test_several_formats)
+{
+    const uint16_t words[] = {0x0010, 0xE308};
+    unsigned char bytes[4];
+
+    /* Every word to every output, from the same call */
+    As.outputs[1] = tmpfile();
+    As.emitters[1] = emitter_init(fileno(As.outputs[1]), EMITTER_BIN_BE);
+    As.formats[1] = EMITTER_BIN_BE;
+    As.nformats = 2;
+    As.instruction = words[0];
+    write_to_binary_stream(&As);
+    write_words(&As, words + 1, 1);
+    mu_check(emitter_finish(As.emitters[0]));
+    mu_check(emitter_finish(As.emitters[1]));
+
+    rewind(As.outputs[1]);
+    mu_check(fread(bytes, 1, 4, As.outputs[1]) == 4);
+    mu_check(bytes[0] == 0x00 && bytes[1] == 0x10);
+    mu_check(bytes[2] == 0xE3 && bytes[3] == 0x08);
+    mu_check(fgetc(As.outputs[1]) == EOF);
+    rewind(As.outputs[0]);
+    mu_check(fgetc(As.outputs[0]) == '0');
+    fseek(As.outputs[0], 0, SEEK_END);
+    mu_check(ftell(As.outputs[0]) == 2 * HACKTEXT_LINE);
+
+    emitter_destroy(As.emitters[1]);
+    fclose(As.outputs[1]);
+}
+
+MU_TEST(test_backpatch)
+{
+    As.instruction_number = 0;
+
+    As.instruction = ERROR;            /* First use of a symbol at 0 */
+    hold_instruction(&As);
+    As.instruction = 0xEC10;
+    hold_instruction(&As);
+    As.instruction = 0;                /* Second use at 2, chained to 0 */
+    hold_instruction(&As);
+
+    backpatch(&As, 2, 0x002A);
+    mu_assert_int_eq(0x002A, As.program[0]);
+    mu_assert_int_eq(0xEC10, As.program[1]);
+    mu_assert_int_eq(0x002A, As.program[2]);
+    mu_assert_int_eq(3, As.instruction_number);
+}
+
+/*
+ * Writes a program of `n` A-instructions loading `prefix` followed by their
+ * index, then `tail`, to a temporary file whose name is stored in `path`.
+ */
+static void write_program(char *path, const char *prefix, unsigned n,
+                          const char *tail)
+{
+    FILE *file;
+    unsigned i;
+
+    sprintf(path, "/tmp/test_program%ld.asm", (long)getpid());
+    file = fopen(path, "w");
+    for (i = 0; i < n; i++) {
+        fprintf(file, "@%s%u\n", prefix, i);
+    }
+    fputs(tail, file);
+    fclose(file);
+}
+
+/*
+ * Runs `mode` over the program at `path` in a child process, which is expected
+ * to die, its standard error saved to `errors`.  Returns whether it exited
+ * with `EXIT_FAILURE`, rather than crashing or succeeding.
+ */
+static int dies(char *path, void (*mode)(Assembler *), char *errors,
+                size_t size)
+{
+    char errpath[64];
+    FILE *file;
+    size_t len;
+    pid_t pid;
+    int status;
+
+    sprintf(errpath, "/tmp/test_errors%ld", (long)getpid());
+    if ((pid = fork()) == 0) {
+        freopen(errpath, "w", stderr);
+        As.parser = parser_init(path);
+        As.symbols = symbol_table_init();
+        As.cache = instcache_init();
+        mode(&As);
+        _exit(EXIT_SUCCESS);
+    }
+    if (waitpid(pid, &status, 0) != pid) {
+        return 0;
+    }
+    file = fopen(errpath, "r");
+    len = fread(errors, 1, size - 1, file);
+    errors[len] = '\0';
+    fclose(file);
+    remove(errpath);
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE;
+}
+
+/*
+ * The `-j 4` mode.
+ */
+static void parallel_4(Assembler *as)
+{
+    as->threads = 4;
+    parallel_passes(as);
+}
+
+MU_TEST(test_variables_overflow)
+{
+    void (*modes[])(Assembler *) = {single_pass, two_passes, parallel_4};
+    char path[64], errors[1024];
+    size_t i;
+
+    for (i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+        /* The last address an A-instruction can load goes to the last one */
+        write_program(path, "v", 0x7FFF - 15, "");
+        mu_check((As.parser = parser_init(path)) != NULL);
+        mu_check((As.symbols = symbol_table_init()) != NULL);
+        modes[i](&As);
+        mu_assert_int_eq(0x7FFF, As.base_address);
+        symbol_table_destroy(As.symbols);
+        parser_destroy(As.parser);
+
+        /* One more aborts, rather than emitting a C-instruction */
+        write_program(path, "v", 32760, "");
+        mu_check(dies(path, modes[i], errors, sizeof(errors)));
+        mu_check(strstr(errors, "Variables exceed") != NULL);
+        mu_check(strstr(errors, "Parsing line") == NULL);
+        if (modes[i] != single_pass) {      /* At its first use */
+            mu_check(strstr(errors, "Instruction 32752.") != NULL);
+        }
+        remove(path);
+    }
+}
+
+MU_TEST(test_rom_overflow)
+{
+    char path[64], errors[1024];
+
+    /* A forward reference past the ROM is an error, not a failed assertion */
+    write_program(path, "", 32768, "@FWD\n(FWD)\n");
+    mu_check(dies(path, single_pass, errors, sizeof(errors)));
+    mu_check(strstr(errors, "Program exceeds the ROM size.") != NULL);
+    mu_check(strstr(errors, "Parsing line 32769.") != NULL);
+
+    /* Found once every chunk is lexed, so at no line in particular */
+    mu_check(dies(path, parallel_4, errors, sizeof(errors)));
+    mu_check(strstr(errors, "Program exceeds the ROM size.") != NULL);
+    mu_check(strstr(errors, "Instruction 32768.") != NULL);
+    mu_check(strstr(errors, "Parsing line") == NULL);
+    remove(path);
+}
+
+MU_TEST(test_parallel_passes)
+{
+    char *names[] = {"Max", "MaxL", "Rect", "RectL"};
+    char path[64];
+    FILE *expected;
+    size_t i;
+    int a, b;
+
+    for (i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        sprintf(path, "./tests/resources/asm-files/%s.asm", names[i]);
+        As.threads = 3;
+        mu_check((As.parser = parser_init(path)) != NULL);
+        mu_check((As.symbols = symbol_table_init()) != NULL);
+
+        rewind(As.outputs[0]);
+        parallel_passes(&As);
+        mu_check(As.chunks == NULL);
+        mu_check(emitter_flush(As.emitters[0]));
+
+        sprintf(path, "./tests/resources/expected-output/%s.hack", names[i]);
+        mu_check((expected = fopen(path, "r")) != NULL);
+        rewind(As.outputs[0]);
+        do {
+            a = fgetc(As.outputs[0]);
+            b = fgetc(expected);
+            mu_assert_int_eq(b, a);
+        } while (a != EOF && b != EOF);
+
+        fclose(expected);
+        symbol_table_destroy(As.symbols);
+        parser_destroy(As.parser);
+    }
+}
+
 MU_TEST_SUITE(test_suite) 
 {
 	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
-	MU_RUN_TEST(test_num_to_address);
 	MU_RUN_TEST(test_write_to_binary_stream);
+	MU_RUN_TEST(test_several_formats);
+	MU_RUN_TEST(test_backpatch);
+	MU_RUN_TEST(test_variables_overflow);
+	MU_RUN_TEST(test_rom_overflow);
+	MU_RUN_TEST(test_parallel_passes);
 }
 
 int main(int argc, char *argv[]) 
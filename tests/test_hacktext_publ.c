@@ -0,0 +1,141 @@
+#include "minunit.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/hacktext.h"
+
+#define NWORDS 65536                /* Every word */
+
+static uint16_t *Words;
+static uint16_t *Parsed;
+static char *Text;
+static char *Expected;
+
+/*
+ * Formats `word` a bit at a time, as the assembler used to.
+ */
+static void reference_format(uint16_t word, char *line)
+{
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        line[i] = (word & (0x8000 >> i)) ? '1' : '0';
+    }
+    line[16] = '\n';
+}
+
+void test_setup(void)
+{
+    uint32_t i;
+
+    Words = malloc(NWORDS * sizeof(uint16_t));
+    Parsed = malloc(NWORDS * sizeof(uint16_t));
+    Text = malloc((size_t)NWORDS * HACKTEXT_LINE);
+    Expected = malloc((size_t)NWORDS * HACKTEXT_LINE);
+    for (i = 0; i < NWORDS; i++) {
+        /* Not in order, so neighbouring words differ in every bit */
+        Words[i] = (uint16_t)(i * 40503u);
+        reference_format(Words[i], Expected + (size_t)i * HACKTEXT_LINE);
+    }
+}
+
+void test_teardown(void)
+{
+    hacktext_select(HACKTEXT_SCALAR);
+    free(Words);
+    free(Parsed);
+    free(Text);
+    free(Expected);
+}
+
+MU_TEST(test_hacktext_line)
+{
+    char line[HACKTEXT_LINE];
+
+    hacktext_line(0xBEEF, line);
+    mu_check(memcmp(line, "1011111011101111\n", HACKTEXT_LINE) == 0);
+    hacktext_line(0x0000, line);
+    mu_check(memcmp(line, "0000000000000000\n", HACKTEXT_LINE) == 0);
+}
+
+MU_TEST(test_hacktext_kernels)
+{
+    HackTextKernel k;
+    size_t n, count;
+
+    mu_check(hacktext_select(HACKTEXT_SCALAR));
+    for (k = HACKTEXT_SCALAR; k <= HACKTEXT_AVX2; k++) {
+        if (!hacktext_select(k)) {
+            printf("\n%s not supported, skipped", hacktext_kernel_name(k));
+            continue;
+        }
+        mu_check(hacktext_kernel() == k);
+
+        /* Every word, then every length around a vector, for the tails */
+        hacktext_format(Words, NWORDS, Text);
+        mu_check(memcmp(Text, Expected, (size_t)NWORDS * HACKTEXT_LINE) == 0);
+        for (count = 0; count <= 40; count++) {
+            memset(Text, 'x', (count + 1) * HACKTEXT_LINE);
+            hacktext_format(Words + 3, count, Text);
+            mu_check(memcmp(Text, Expected + 3 * HACKTEXT_LINE,
+                            count * HACKTEXT_LINE) == 0);
+            mu_check(Text[count * HACKTEXT_LINE] == 'x');
+        }
+
+        memset(Parsed, 0, NWORDS * sizeof(uint16_t));
+        mu_check(hacktext_parse(Expected, (size_t)NWORDS * HACKTEXT_LINE,
+                                Parsed, &n));
+        mu_check(n == NWORDS);
+        mu_check(memcmp(Parsed, Words, NWORDS * sizeof(uint16_t)) == 0);
+    }
+}
+
+MU_TEST(test_hacktext_malformed)
+{
+    HackTextKernel k;
+    size_t n, bad, j;
+    char saved;
+
+    for (k = HACKTEXT_SCALAR; k <= HACKTEXT_AVX2; k++) {
+        if (!hacktext_select(k)) {
+            continue;
+        }
+        /* Any byte of any of the first lines, whatever the kernel's stride */
+        for (bad = 0; bad < 5; bad++) {
+            for (j = 0; j < HACKTEXT_LINE; j++) {
+                saved = Expected[bad * HACKTEXT_LINE + j];
+                Expected[bad * HACKTEXT_LINE + j] = j == 16 ? '0' : '2';
+                errno = 0;
+                mu_check(!hacktext_parse(Expected, 8 * HACKTEXT_LINE, Parsed,
+                                         &n));
+                mu_check(errno == EINVAL);
+                mu_check(n == bad);
+                Expected[bad * HACKTEXT_LINE + j] = saved;
+            }
+        }
+
+        /* A partial line at the end */
+        mu_check(!hacktext_parse(Expected, 3 * HACKTEXT_LINE + 16, Parsed, &n));
+        mu_check(n == 3);
+        mu_check(hacktext_parse(Expected, 0, Parsed, &n));
+        mu_check(n == 0);
+    }
+}
+
+MU_TEST_SUITE(test_suite)
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_hacktext_line);
+	MU_RUN_TEST(test_hacktext_kernels);
+	MU_RUN_TEST(test_hacktext_malformed);
+}
+
+int main(int argc, char *argv[])
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
@@ -0,0 +1,100 @@
+#include "minunit.h"
+#include <errno.h>
+#include <string.h>
+#include "../src/hashfuncs.c"
+
+MU_TEST(test_hash_select)
+{
+    const char *name;
+    size_t i;
+
+    mu_check(hash_select(NULL) == hash_select(DEFAULT_HASH));
+    for (i = 0; (name = hash_name(i)) != NULL; i++) {
+        mu_check(hash_select(name) != NULL);
+    }
+    mu_check(i == ARRAY_SIZE(Suite));
+
+    errno = 0;
+    mu_check(hash_select("md5") == NULL);
+    mu_check(errno == EINVAL);
+}
+
+/*
+ * Published check values of the string "123456789".
+ */
+MU_TEST(test_hash_check_values)
+{
+    const char *check = "123456789";
+
+    mu_check(fnv1a(check, 9) == (size_t)0x06d5573923c6cdfcULL);
+    mu_check(crc32c_bytewise(check, 9) == 0xE3069283U);
+    mu_check(hash_select("crc32c")(check, 9) == 0xE3069283U);
+}
+
+MU_TEST(test_hash_length_aware)
+{
+    const char key[] = "LOOP\0LOOP\0";
+    const char *name;
+    HashFunction *fn;
+    size_t i;
+
+    /* Only `size` bytes count, null bytes included */
+    for (i = 0; (name = hash_name(i)) != NULL; i++) {
+        fn = hash_select(name);
+        mu_check(fn(key, 5) == fn(key + 5, 5));
+        mu_check(fn(key, 5) != fn(key, 4));
+        mu_check(fn(key, 4) != fn(key, 10));
+    }
+}
+
+MU_TEST(test_hash_crc32c_kernels)
+{
+    char key[64];
+    size_t i;
+
+    for (i = 0; i < sizeof(key); i++) {
+        key[i] = (char)('A' + i * 7 % 26);
+    }
+#ifdef HAVE_SSE42
+    if (__builtin_cpu_supports("sse4.2")) {
+        for (i = 0; i <= sizeof(key); i++) {
+            mu_check(crc32c_sse42(key, i) == crc32c_bytewise(key, i));
+        }
+    }
+#endif
+}
+
+MU_TEST(test_hash_wyhash_sizes)
+{
+    char key[64];
+    size_t i, j;
+
+    /* Every size path spreads a single flipped byte */
+    memset(key, 'x', sizeof(key));
+    for (i = 1; i <= sizeof(key); i++) {
+        for (j = 0; j < i; j++) {
+            size_t h = hash_wyhash(key, i);
+
+            key[j] = 'y';
+            mu_check(hash_wyhash(key, i) != h);
+            key[j] = 'x';
+        }
+    }
+}
+
+MU_TEST_SUITE(test_suite) 
+{
+	MU_RUN_TEST(test_hash_select);
+	MU_RUN_TEST(test_hash_check_values);
+	MU_RUN_TEST(test_hash_length_aware);
+	MU_RUN_TEST(test_hash_crc32c_kernels);
+	MU_RUN_TEST(test_hash_wyhash_sizes);
+}
+
+int main(int argc, char *argv[]) 
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
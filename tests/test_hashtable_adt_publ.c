@@ -0,0 +1,323 @@
+#include "minunit.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "../include/arena.h"
+#include "../include/hashtable_adt.h"
+#include "../include/hashtable_tmpl.h"
+
+#define NKEYS 20000
+
+static HashTableADT *Table;
+static int Items[NKEYS];
+
+/*
+ * Deliberately poor hash: every key lands on one of four values, so probe
+ * sequences run across many groups.
+ */
+static size_t weak_hash(const void *key, size_t size)
+{
+    return ((const unsigned char *)key)[size - 2] & 0x3;
+}
+
+static size_t sum_hash(const void *key, size_t size)
+{
+    const unsigned char *p = key;
+    size_t hash = 0, i;
+
+    for (i = 0; i < size; i++) {
+        hash = hash * 31 + p[i];
+    }
+    return hash;
+}
+
+/*
+ * Identity hash, the table mixes it.  Collisions come from equal residues.
+ */
+#define INT_HASH(k) ((size_t)(unsigned)(k))
+#define INT_EQ(a, b) ((a) == (b))
+
+DEFINE_HASHTABLE(IntMap, int, uint16_t, INT_HASH, INT_EQ)
+
+void test_setup(void)
+{
+    Table = cadthashtable_new(16, sum_hash, NULL);
+}
+
+void test_teardown(void)
+{
+    cadthashtable_destroy(Table);
+}
+
+MU_TEST(test_hashtable_new_invalid)
+{
+    errno = 0;
+    mu_check(cadthashtable_new(0, sum_hash, NULL) == NULL);
+    mu_check(errno == EINVAL);
+    errno = 0;
+    mu_check(cadthashtable_new(16, NULL, NULL) == NULL);
+    mu_check(errno == EINVAL);
+}
+
+MU_TEST(test_hashtable_insert_lookup)
+{
+    mu_check(cadthashtable_insert(Table, "LOOP", 5, &Items[0]) == &Items[0]);
+    mu_check(cadthashtable_insert(Table, "END", 4, &Items[1]) == &Items[1]);
+
+    mu_check(cadthashtable_lookup(Table, "LOOP", 5) == &Items[0]);
+    mu_check(cadthashtable_lookup(Table, "END", 4) == &Items[1]);
+    mu_check(cadthashtable_lookup(Table, "END", 3) == NULL);
+    mu_check(cadthashtable_lookup(Table, "i", 2) == NULL);
+
+    errno = 0;
+    mu_check(cadthashtable_insert(Table, "LOOP", 5, &Items[2]) == NULL);
+    mu_check(errno == EEXIST);
+    mu_check(cadthashtable_lookup(Table, "LOOP", 5) == &Items[0]);
+}
+
+MU_TEST(test_hashtable_growth)
+{
+    char key[16];
+    int i;
+
+    for (i = 0; i < NKEYS; i++) {
+        sprintf(key, "sym.%d", i);
+        mu_check(cadthashtable_insert(Table, key, strlen(key)+1, &Items[i])
+                 == &Items[i]);
+
+        /* Visible all along the incremental rehash */
+        sprintf(key, "sym.%d", i / 2);
+        mu_check(cadthashtable_lookup(Table, key, strlen(key)+1)
+                 == &Items[i / 2]);
+    }
+    for (i = 0; i < NKEYS; i++) {
+        sprintf(key, "sym.%d", i);
+        mu_check(cadthashtable_lookup(Table, key, strlen(key)+1) == &Items[i]);
+    }
+    mu_check(cadthashtable_lookup(Table, "sym.-1", 7) == NULL);
+}
+
+MU_TEST(test_hashtable_delete)
+{
+    char key[16];
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "sym.%d", i);
+        cadthashtable_insert(Table, key, strlen(key)+1, &Items[i]);
+    }
+    for (i = 0; i < 1000; i += 2) {
+        sprintf(key, "sym.%d", i);
+        mu_check(cadthashtable_delete(Table, key, strlen(key)+1, &Items[i])
+                 == &Items[i]);
+    }
+    mu_check(cadthashtable_delete(Table, "sym.0", 6, &Items[0]) == NULL);
+
+    /* Tombstones don't hide the survivors, and deleted keys can come back */
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "sym.%d", i);
+        mu_check(cadthashtable_lookup(Table, key, strlen(key)+1)
+                 == (i % 2 ? &Items[i] : NULL));
+    }
+    for (i = 0; i < 1000; i += 2) {
+        sprintf(key, "sym.%d", i);
+        mu_check(cadthashtable_insert(Table, key, strlen(key)+1, &Items[i])
+                 == &Items[i]);
+    }
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "sym.%d", i);
+        mu_check(cadthashtable_lookup(Table, key, strlen(key)+1) == &Items[i]);
+    }
+}
+
+MU_TEST(test_hashtable_collisions)
+{
+    HashTableADT *ht;
+    char key[16];
+    int i;
+
+    ht = cadthashtable_new(1, weak_hash, NULL);
+    for (i = 0; i < 500; i++) {
+        sprintf(key, "k%d", i);
+        mu_check(cadthashtable_insert(ht, key, strlen(key)+1, &Items[i])
+                 == &Items[i]);
+    }
+    for (i = 0; i < 500; i++) {
+        sprintf(key, "k%d", i);
+        mu_check(cadthashtable_lookup(ht, key, strlen(key)+1) == &Items[i]);
+    }
+    cadthashtable_destroy(ht);
+}
+
+MU_TEST(test_hashtable_arena)
+{
+    HashTableADT *ht;
+    Allocator mem;
+    Arena *arena;
+    char key[16];
+    int i;
+
+    arena = arena_init(0);
+    mem = arena_allocator(arena);
+    ht = cadthashtable_new(1, sum_hash, &mem);
+    for (i = 0; i < 5000; i++) {
+        sprintf(key, "sym.%d", i);
+        mu_check(cadthashtable_insert(ht, key, strlen(key)+1, &Items[i])
+                 == &Items[i]);
+    }
+    for (i = 0; i < 5000; i++) {
+        sprintf(key, "sym.%d", i);
+        mu_check(cadthashtable_lookup(ht, key, strlen(key)+1) == &Items[i]);
+    }
+    mu_check(arena_used(arena) > 0);
+    arena_destroy(arena);
+}
+
+MU_TEST(test_hashtable_stats)
+{
+    HashTableStats st;
+    HashTableADT *ht;
+    size_t i, total;
+    char key[16];
+
+    cadthashtable_stats(NULL, &st);
+    mu_check(errno == EINVAL);
+    mu_check(st.nelems == 0);
+
+    cadthashtable_stats(Table, &st);
+    mu_check(st.nelems == 0 && st.nbuckets >= 16 && st.lookups == 0);
+
+    for (i = 0; i < 100; i++) {
+        sprintf(key, "key%zu", i);
+        cadthashtable_insert(Table, key, strlen(key)+1, &Items[i]);
+    }
+    cadthashtable_lookup(Table, "key7", 5);
+    cadthashtable_lookup(Table, "nokey", 6);
+    cadthashtable_delete(Table, "key8", 5, &Items[8]);
+
+    cadthashtable_stats(Table, &st);
+    mu_check(st.nelems == 99);
+    mu_check(st.tombstones >= 1);
+    mu_check(st.lookups == 103);
+    mu_check(st.probes >= st.lookups);
+    mu_check(st.compares >= 2);
+    mu_check(st.max_chain >= 1);
+    for (i = 0, total = 0; i < HT_HISTOGRAM_SIZE; i++) {
+        total += st.histogram[i];
+    }
+    mu_check(total == st.nelems);
+
+    /* Every key of the weak hash shares four home groups */
+    ht = cadthashtable_new(1, weak_hash, NULL);
+    for (i = 0; i < 500; i++) {
+        sprintf(key, "k%zu", i);
+        cadthashtable_insert(ht, key, strlen(key)+1, &Items[i]);
+    }
+    cadthashtable_stats(ht, &st);
+    mu_check(st.nelems == 500);
+    mu_check(st.max_chain > HT_HISTOGRAM_SIZE);
+    mu_check(st.mean_chain > 1.0);
+    mu_check(st.histogram[HT_HISTOGRAM_SIZE - 1] > 0);
+    cadthashtable_destroy(ht);
+}
+
+MU_TEST(test_hashtable_tmpl)
+{
+    HashTableStats st;
+    uint16_t *val;
+    IntMap map;
+    int i;
+
+    mu_check(IntMap_init(&map, 1, NULL));
+    mu_check(IntMap_find(&map, 42) == NULL);
+
+    /* Grows well past the initial 16 slots */
+    for (i = 0; i < NKEYS; i++) {
+        mu_check((val = IntMap_insert(&map, i * 16, (uint16_t)i)) != NULL);
+        mu_check(*val == (uint16_t)i);
+    }
+    errno = 0;
+    mu_check(IntMap_insert(&map, 16, 0) == NULL);
+    mu_check(errno == EEXIST);
+
+    for (i = 0; i < NKEYS; i++) {
+        mu_check((val = IntMap_find(&map, i * 16)) != NULL);
+        mu_check(*val == (uint16_t)i);
+    }
+    mu_check(IntMap_find(&map, 1) == NULL);
+
+    /* Values are stored inline, and can be updated through the pointer */
+    *IntMap_find(&map, 32) = 0xBEEF;
+    mu_check(*IntMap_find(&map, 32) == 0xBEEF);
+
+    IntMap_stats(&map, &st);
+    mu_check(st.nelems == NKEYS);
+    mu_check(st.nbuckets >= NKEYS);
+    mu_check(st.load_factor <= 0.75);
+    mu_check(st.mean_chain >= 1.0);
+    mu_check(st.lookups >= 2 * NKEYS);
+    IntMap_destroy(&map);
+}
+
+/*
+ * Growing 128 slots moves 64 old ones per insertion, so the elements are
+ * found in both arrays in between.
+ */
+MU_TEST(test_hashtable_tmpl_migration)
+{
+    HashTableStats st;
+    Allocator mem;
+    Arena *arena;
+    IntMap map;
+    int i;
+
+    arena = arena_init(0);
+    mem = arena_allocator(arena);
+    mu_check(IntMap_init(&map, 96, &mem));
+    for (i = 0; i < 97; i++) {
+        mu_check(IntMap_insert(&map, i, (uint16_t)i) != NULL);
+    }
+
+    IntMap_stats(&map, &st);
+    mu_check(st.nbuckets == 128 + 256);
+    mu_check(st.tombstones > 0);
+    for (i = 0; i < 97; i++) {
+        mu_check(IntMap_find(&map, i) != NULL);
+        mu_check(*IntMap_find(&map, i) == (uint16_t)i);
+    }
+    errno = 0;
+    mu_check(IntMap_insert(&map, 96, 0) == NULL);
+    mu_check(errno == EEXIST);
+
+    mu_check(IntMap_insert(&map, 97, 97) != NULL);
+    IntMap_stats(&map, &st);
+    mu_check(st.nbuckets == 256 && st.tombstones == 0 && st.nelems == 98);
+    for (i = 0; i < 98; i++) {
+        mu_check(*IntMap_find(&map, i) == (uint16_t)i);
+    }
+    mu_check(arena_used(arena) >= (128 + 256) * sizeof(IntMap_slot));
+    IntMap_destroy(&map);
+    arena_destroy(arena);
+}
+
+MU_TEST_SUITE(test_suite) 
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_hashtable_new_invalid);
+	MU_RUN_TEST(test_hashtable_insert_lookup);
+	MU_RUN_TEST(test_hashtable_growth);
+	MU_RUN_TEST(test_hashtable_delete);
+	MU_RUN_TEST(test_hashtable_collisions);
+	MU_RUN_TEST(test_hashtable_arena);
+	MU_RUN_TEST(test_hashtable_stats);
+	MU_RUN_TEST(test_hashtable_tmpl);
+	MU_RUN_TEST(test_hashtable_tmpl_migration);
+}
+
+int main(int argc, char *argv[]) 
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
@@ -0,0 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+#include "minunit.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "../include/hashfuncs.h"
+#include "../include/hashtable_mt.h"
+
+#define NTHREADS 8
+#define NREADERS 2
+#define NKEYS 20000
+
+/*
+ * Every inserting thread tries every key, each from a different starting
+ * point, pairing it with its own item.  Only minunit's main thread asserts,
+ * the workers count what went wrong.
+ */
+typedef struct worker {
+    pthread_t thread;
+    int id;
+    unsigned long inserted;     /* Successful insertions */
+    unsigned long bad_errno;    /* Failures other than `EEXIST` */
+    unsigned long missing;      /* Keys not found right after inserting */
+    unsigned long foreign;      /* Lookups returning an unknown item */
+} Worker;
+
+static HashTableMT *Table;
+static int Items[NTHREADS][NKEYS];
+static int Winner[NKEYS];
+static int Done;
+
+void test_setup(void)
+{
+    Table = cadthashtable_mt_new(1, hash_select(NULL));
+}
+
+void test_teardown(void)
+{
+    cadthashtable_mt_destroy(Table);
+}
+
+/*
+ * Whether `item` is one of the items paired with key `i` by some thread.
+ */
+static int known_item(const void *item, int i)
+{
+    int t;
+
+    for (t = 0; t < NTHREADS; t++) {
+        if (item == &Items[t][i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *inserter(void *arg)
+{
+    Worker *w = arg;
+    char key[16];
+    void *item;
+    int n, i;
+
+    for (n = 0; n < NKEYS; n++) {
+        i = (n + w->id * (NKEYS / NTHREADS)) % NKEYS;
+        sprintf(key, "L%d", i);
+        errno = 0;
+        if (cadthashtable_mt_insert(Table, key, strlen(key)+1, &Items[w->id][i])
+            != NULL) {
+            Winner[i] = w->id;
+            w->inserted++;
+        } else if (errno != EEXIST) {
+            w->bad_errno++;
+        }
+        if ((item = cadthashtable_mt_lookup(Table, key, strlen(key)+1))
+            == NULL) {
+            w->missing++;
+        } else if (!known_item(item, i)) {
+            w->foreign++;
+        }
+    }
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    Worker *w = arg;
+    char key[16];
+    void *item;
+    int i = 0;
+
+    while (!__atomic_load_n(&Done, __ATOMIC_ACQUIRE)) {
+        i = (i + 7919) % NKEYS;
+        sprintf(key, "L%d", i);
+        item = cadthashtable_mt_lookup(Table, key, strlen(key)+1);
+        if (item != NULL && !known_item(item, i)) {
+            w->foreign++;
+        }
+    }
+    return NULL;
+}
+
+MU_TEST(test_hashtable_mt_invalid)
+{
+    errno = 0;
+    mu_check(cadthashtable_mt_new(0, hash_select(NULL)) == NULL);
+    mu_check(errno == EINVAL);
+    mu_check(cadthashtable_mt_new(1, NULL) == NULL);
+    mu_check(cadthashtable_mt_insert(Table, "", 0, &Items[0][0]) == NULL);
+    mu_check(errno == EINVAL);
+    mu_check(cadthashtable_mt_lookup(Table, "nokey", 6) == NULL);
+}
+
+MU_TEST(test_hashtable_mt_single)
+{
+    mu_check(cadthashtable_mt_insert(Table, "LOOP", 5, &Items[0][0])
+             == &Items[0][0]);
+    mu_check(cadthashtable_mt_insert(Table, "LOOP", 5, &Items[0][1]) == NULL);
+    mu_check(errno == EEXIST);
+    mu_check(cadthashtable_mt_lookup(Table, "LOOP", 5) == &Items[0][0]);
+    mu_check(cadthashtable_mt_lookup(Table, "END", 4) == NULL);
+    mu_check(cadthashtable_mt_count(Table) == 1);
+}
+
+MU_TEST(test_hashtable_mt_stress)
+{
+    Worker inserters[NTHREADS] = {{0}}, readers[NREADERS] = {{0}};
+    unsigned long inserted = 0;
+    char key[16];
+    int i, t;
+
+    Done = 0;
+    for (t = 0; t < NREADERS; t++) {
+        pthread_create(&readers[t].thread, NULL, reader, &readers[t]);
+    }
+    for (t = 0; t < NTHREADS; t++) {
+        inserters[t].id = t;
+        pthread_create(&inserters[t].thread, NULL, inserter, &inserters[t]);
+    }
+    for (t = 0; t < NTHREADS; t++) {
+        pthread_join(inserters[t].thread, NULL);
+        inserted += inserters[t].inserted;
+        mu_check(inserters[t].bad_errno == 0);
+        mu_check(inserters[t].missing == 0);
+        mu_check(inserters[t].foreign == 0);
+    }
+    __atomic_store_n(&Done, 1, __ATOMIC_RELEASE);
+    for (t = 0; t < NREADERS; t++) {
+        pthread_join(readers[t].thread, NULL);
+        mu_check(readers[t].foreign == 0);
+    }
+
+    /* Exactly one insertion of every key won, and its item is the one kept */
+    mu_check(inserted == NKEYS);
+    mu_check(cadthashtable_mt_count(Table) == NKEYS);
+    for (i = 0; i < NKEYS; i++) {
+        sprintf(key, "L%d", i);
+        mu_check(cadthashtable_mt_lookup(Table, key, strlen(key)+1)
+                 == &Items[Winner[i]][i]);
+    }
+}
+
+MU_TEST_SUITE(test_suite)
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_hashtable_mt_invalid);
+	MU_RUN_TEST(test_hashtable_mt_single);
+	MU_RUN_TEST(test_hashtable_mt_stress);
+}
+
+int main(int argc, char *argv[])
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
@@ -0,0 +1,81 @@
+#include "minunit.h"
+#include <errno.h>
+#include <string.h>
+#include "../include/instcache.h"
+
+static InstCache *Cache;
+
+void test_setup(void)
+{
+    Cache = instcache_init();
+}
+
+void test_teardown(void)
+{
+    instcache_destroy(Cache);
+}
+
+MU_TEST(test_instcache_hit_and_miss)
+{
+    unsigned long hits, misses;
+
+    mu_assert_int_eq(ERROR, instcache_lookup(Cache, "M=D", 3));
+    instcache_insert(Cache, "M=D", 3, 0xE308);
+
+    mu_assert_int_eq(0xE308, instcache_lookup(Cache, "M=D", 3));
+    mu_assert_int_eq(ERROR, instcache_lookup(Cache, "D=M", 3));
+    mu_assert_int_eq(ERROR, instcache_lookup(Cache, "M=D;", 4));
+    mu_assert_int_eq(ERROR, instcache_lookup(Cache, "M=", 2));
+
+    instcache_stats(Cache, &hits, &misses);
+    mu_assert_int_eq(1, (int)hits);
+    mu_assert_int_eq(4, (int)misses);
+}
+
+MU_TEST(test_instcache_eviction)
+{
+    char line[16];
+    int i, found;
+
+    /* More lines than slots: some are evicted, the last one never is */
+    for (i = 0; i < 2048; i++) {
+        sprintf(line, "D=%d", i);
+        instcache_insert(Cache, line, strlen(line), (uint16_t)i);
+    }
+
+    found = 0;
+    for (i = 0; i < 2048; i++) {
+        sprintf(line, "D=%d", i);
+        if (instcache_lookup(Cache, line, strlen(line)) == i) {
+            found++;
+        }
+    }
+    mu_check(found > 0 && found < 2048);
+    mu_assert_int_eq(2047, instcache_lookup(Cache, "D=2047", 6));
+}
+
+MU_TEST(test_instcache_long_lines)
+{
+    const char *line = "AMD=D|M;JMP    // comment";
+
+    instcache_insert(Cache, line, strlen(line), 0xFD5F);
+    mu_assert_int_eq(ERROR, instcache_lookup(Cache, line, strlen(line)));
+    instcache_insert(Cache, "", 0, 0xFD5F);
+    mu_assert_int_eq(ERROR, instcache_lookup(Cache, "", 0));
+}
+
+MU_TEST_SUITE(test_suite) 
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_instcache_hit_and_miss);
+	MU_RUN_TEST(test_instcache_eviction);
+	MU_RUN_TEST(test_instcache_long_lines);
+}
+
+int main(int argc, char *argv[]) 
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
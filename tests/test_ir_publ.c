@@ -0,0 +1,91 @@
+#include "minunit.h"
+#include <errno.h>
+#include <string.h>
+#include "../include/ir.h"
+
+static Ir *Program;
+
+void test_setup(void)
+{
+    Program = ir_init();
+}
+
+void test_teardown(void)
+{
+    ir_destroy(Program);
+}
+
+MU_TEST(test_ir_add)
+{
+    const Ir *ir;
+
+    errno = 0;
+    ir_add_symbol(Program, "i");
+    ir_add_word(Program, 0xE308);
+    ir_add_word(Program, 0x0007);
+    ir_add_symbol(Program, "LOOP");
+    mu_check(errno == 0);
+
+    ir = Program;
+    mu_assert_int_eq(4, ir->count);
+
+    mu_assert_int_eq(IR_SYMBOL, ir->kind[0]);
+    mu_assert_string_eq("i", ir->names + ir->operand[0]);
+    mu_assert_int_eq(IR_WORD, ir->kind[1]);
+    mu_assert_int_eq(0xE308, (int)ir->operand[1]);
+    mu_assert_int_eq(IR_WORD, ir->kind[2]);
+    mu_assert_int_eq(0x0007, (int)ir->operand[2]);
+    mu_assert_int_eq(IR_SYMBOL, ir->kind[3]);
+    mu_assert_string_eq("LOOP", ir->names + ir->operand[3]);
+}
+
+MU_TEST(test_ir_add_id)
+{
+    const Ir *ir;
+
+    ir_add_id(Program, 23);
+    ir_add_symbol(Program, "j");
+    ir_set_word(Program, 0, 0x0010);
+
+    ir = Program;
+    mu_assert_int_eq(2, ir->count);
+    mu_assert_int_eq(IR_WORD, ir->kind[0]);
+    mu_assert_int_eq(0x0010, (int)ir->operand[0]);
+
+    ir_add_id(Program, 24);
+    mu_assert_int_eq(IR_ID, ir->kind[2]);
+    mu_assert_int_eq(24, (int)ir->operand[2]);
+}
+
+MU_TEST(test_ir_growth)
+{
+    const Ir *ir;
+    char name[16];
+    int i;
+
+    for (i = 0; i < 5000; i++) {
+        sprintf(name, "var.%d", i);
+        ir_add_symbol(Program, name);
+    }
+
+    ir = Program;
+    mu_assert_int_eq(5000, ir->count);
+    mu_assert_string_eq("var.0", ir->names + ir->operand[0]);
+    mu_assert_string_eq("var.4999", ir->names + ir->operand[4999]);
+}
+
+MU_TEST_SUITE(test_suite) 
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_ir_add);
+	MU_RUN_TEST(test_ir_add_id);
+	MU_RUN_TEST(test_ir_growth);
+}
+
+int main(int argc, char *argv[]) 
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
@@ -0,0 +1,120 @@
+#include "minunit.h"
+#include "../src/lineindex.c"
+
+#include <string.h>
+
+static const char source[] = 
+    "// Comment line\n"
+    "\n"
+    "   @SP   \n"
+    "\tAM=M+1 // increment\r\n"
+    "  \t  \n"
+    "(LOOP)//label\n"
+    "0;JMP";
+
+static const Kernels *kernel_sets[] = {
+    &Scalar,
+#ifdef HAVE_SSE2
+    &Sse2,
+    &Avx2,
+#endif
+};
+
+/* Called before each test case is executed. */
+void test_setup(void) { }
+
+/* Called after each test case is executed. */
+void test_teardown(void) { }
+
+MU_TEST(test_lineindex_build)
+{
+    Line *lines;
+    size_t n;
+
+    lines = lineindex_build(source, strlen(source), &n);
+    mu_check(lines != NULL);
+    mu_assert_int_eq(4, (int)n);
+
+    mu_assert_int_eq(3, (int)lines[0].number);
+    mu_check(strncmp("@SP", source + lines[0].offset, lines[0].length) == 0);
+    mu_assert_int_eq(3, (int)lines[0].length);
+
+    mu_assert_int_eq(4, (int)lines[1].number);
+    mu_assert_int_eq(6, (int)lines[1].length);
+    mu_check(strncmp("AM=M+1", source + lines[1].offset, 6) == 0);
+
+    mu_assert_int_eq(6, (int)lines[2].number);
+    mu_assert_int_eq(6, (int)lines[2].length);
+    mu_check(strncmp("(LOOP)", source + lines[2].offset, 6) == 0);
+
+    /* Last line, without a trailing newline */
+    mu_assert_int_eq(7, (int)lines[3].number);
+    mu_assert_int_eq(5, (int)lines[3].length);
+    mu_assert_int_eq(strlen(source) - 5, (int)lines[3].offset);
+
+    free(lines);
+}
+
+MU_TEST(test_lineindex_empty)
+{
+    Line *lines;
+    size_t n = 1;
+
+    lines = lineindex_build("", 0, &n);
+    mu_check(lines != NULL);
+    mu_assert_int_eq(0, (int)n);
+    free(lines);
+
+    lines = lineindex_build("// Only\n\n   // comments", 23, &n);
+    mu_check(lines != NULL);
+    mu_assert_int_eq(0, (int)n);
+    free(lines);
+}
+
+/*
+ * Every kernel set must agree with the scalar one at every starting offset, so
+ * matches land in the vector body as well as in the scalar tail.
+ */
+MU_TEST(test_lineindex_kernels)
+{
+    char text[256];
+    size_t i, k, n;
+    const char alphabet[] = " \t\r/\nxD=";
+
+    srand(2024);
+    for (i = 0; i < sizeof(text); i++) {
+        text[i] = alphabet[(size_t)rand() % (sizeof(alphabet) - 1)];
+    }
+    n = sizeof(text);
+
+    for (k = 0; k < sizeof(kernel_sets) / sizeof(*kernel_sets); k++) {
+        if (kernel_sets[k]->skip_blanks == avx2_skip_blanks
+            && !__builtin_cpu_supports("avx2")) {
+            continue;
+        }
+        for (i = 0; i <= n; i++) {
+            mu_assert_int_eq((int)scalar_skip_blanks(text, i, n),
+                             (int)kernel_sets[k]->skip_blanks(text, i, n));
+            mu_assert_int_eq((int)scalar_find_newline(text, i, n),
+                             (int)kernel_sets[k]->find_newline(text, i, n));
+            mu_assert_int_eq((int)scalar_find_end(text, i, n),
+                             (int)kernel_sets[k]->find_end(text, i, n));
+        }
+    }
+}
+
+MU_TEST_SUITE(test_suite) 
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_lineindex_build);
+	MU_RUN_TEST(test_lineindex_empty);
+	MU_RUN_TEST(test_lineindex_kernels);
+}
+
+int main(int argc, char *argv[]) 
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
@@ -5,8 +5,15 @@
 static char* bad_file = "./tests/resources/parser-tester.file";
 static char* asm_file = "./tests/resources/parser-tester.asm";
 
+static Parser *Ps;
+static Parser Stub;                 /* For tests that set the line directly */
+
 /* Called before each test case is executed. */
-void test_setup(void) { }
+void test_setup(void)
+{
+    memset(&Stub, 0, sizeof(Stub));
+    Ps = &Stub;
+}
 
 /* Called after each test case is executed. */
 void test_teardown(void) { }
@@ -19,60 +26,6 @@ MU_TEST(test_is_extension_asm)
     mu_check(is_extension_asm("Test.") == false);
 }
 
-MU_TEST(test_discard_leading_withe_spaces)
-{
-    char str0[] = "\n";
-    char str1[] = "  \n";
-    char str2[] = "\t  Not blank\n";
-
-    token = str0;
-    discard_leading_withe_spaces();
-    mu_assert_string_eq("", token);
-
-    token = str1;
-    discard_leading_withe_spaces();
-    mu_assert_string_eq("", token);
-
-    token = str2;
-    discard_leading_withe_spaces();
-    mu_assert_string_eq("Not blank\n", token);
-}
-
-MU_TEST(test_is_blank_line)
-{
-    char str0[] = "";
-    char str1[] = "\n";
-    char str2[] = "  Not blank";
-
-    token = str0;
-    mu_check(is_blank_line() == true);
-
-    token = str1;
-    mu_check(is_blank_line() == false);
-
-    token = str2;
-    mu_check(is_blank_line() == false);
-}
-
-MU_TEST(test_is_comment_line)
-{
-    char str0[] = "// Yes";
-    char str1[] = "No\n";
-    char str2[] = "@2\n";
-
-    line_len = 6;
-    token = str0;
-    mu_check(is_comment_line() == true);
-
-    line_len = 3;
-    token = str1;
-    mu_check(is_comment_line() == false);
-
-    line_len = 3;
-    token = str2;
-    mu_check(is_comment_line() == false);
-}
-
 MU_TEST(test_parser_init)
 {
     mu_check(parser_init(NULL) == NULL); 
@@ -80,221 +33,307 @@ MU_TEST(test_parser_init)
 
     mu_check(parser_init(bad_file) == NULL); 
 
-    mu_check(parser_init(asm_file) != NULL); 
-    mu_check(buffer == NULL);
-    mu_check(token == NULL);
-    mu_check(line_len == 0);
-    mu_check((int)command == -1);
+    mu_check((Ps = parser_init(asm_file)) != NULL); 
+    mu_check(Ps->buffer == NULL);
+    mu_check(Ps->line_len == 0);
+    mu_assert_int_eq(6, (int)Ps->nlines);
+
+    parser_destroy(Ps);
 }
 
 MU_TEST(test_parser_advance)
 {
-    /* Test reading a line */
-    parser_init(asm_file);
-    parser_advance();
-    mu_assert_string_eq("// This file is part of www.nand2tetris.org\n",
-                        buffer);
-    mu_assert_string_eq("// This file is part of www.nand2tetris.org\n",
-                        token);
-    mu_assert_int_eq(strlen("// This file is part of www.nand2tetris.org\n"),
-                        (int)line_len);
-    mu_assert_int_eq(1, (int)line_num);
-
-    parser_destroy();
-
-    /* Test reaching EOF condition.  Test file has 13 lines */
-    parser_init(asm_file);
-    for (int i = 0; i < 14; i++) {
-        parser_advance();
-        mu_assert_int_eq(i + 1, (int)line_num);
+    /* Test reading a line, comments and indentation are skipped */
+    Ps = parser_init(asm_file);
+    parser_advance(Ps);
+    mu_assert_string_eq("@2", Ps->buffer);
+    mu_assert_string_eq("@2", Ps->buffer);
+    mu_assert_int_eq(strlen("@2"), (int)Ps->line_len);
+    mu_assert_int_eq(8, (int)Ps->line_num);
+    /* The line is served straight from the mapping */
+    mu_check(Ps->buffer == Ps->map + Ps->lines[0].offset);
+
+    parser_destroy(Ps);
+
+    /* Test reaching EOF condition.  Test file has 6 commands */
+    Ps = parser_init(asm_file);
+    for (int i = 0; i < 6; i++) {
+        parser_advance(Ps);
+        mu_assert_int_eq(i + 8, (int)Ps->line_num);
     }
-    mu_check(line_len == -1);
-    mu_check(feof(fp));
+    parser_advance(Ps);
+    mu_check(Ps->line_len == -1);
+    mu_check(Ps->next_line == Ps->nlines);
 
-    parser_destroy();
+    parser_destroy(Ps);
 }
 
 MU_TEST(test_parser_has_more_commands)
 {
-    parser_init(asm_file);
+    Ps = parser_init(asm_file);
 
-    parser_advance();
-    mu_check(parser_has_more_commands() == true);
+    parser_advance(Ps);
+    mu_check(parser_has_more_commands(Ps) == true);
     /* The parser should have buffered line 8 */
-    mu_assert_string_eq("@2\n", token);
-    mu_assert_int_eq(strlen("    @2\n"), (int)line_len);
-    mu_assert_int_eq(8, (int)line_num);
+    mu_assert_string_eq("@2", Ps->buffer);
+    mu_assert_int_eq(strlen("@2"), (int)Ps->line_len);
+    mu_assert_int_eq(8, (int)Ps->line_num);
 
-    parser_advance();
-    mu_check(parser_has_more_commands() == true);
+    parser_advance(Ps);
+    mu_check(parser_has_more_commands(Ps) == true);
     /* Has buffered line 9? */
-    mu_assert_string_eq("D=A\n", token);
-    mu_assert_int_eq(strlen("    D=A\n"), (int)line_len);
-    mu_assert_int_eq(9, (int)line_num);
-
-    for (int i = 0; i < 5; i++) {
-        parser_advance();
-        mu_assert_int_eq(i + 10, (int)line_num);
+    mu_assert_string_eq("D=A", Ps->buffer);
+    mu_assert_int_eq(strlen("D=A"), (int)Ps->line_len);
+    mu_assert_int_eq(9, (int)Ps->line_num);
+
+    for (int i = 0; i < 4; i++) {
+        parser_advance(Ps);
+        mu_check(parser_has_more_commands(Ps) == true);
+        mu_assert_int_eq(i + 10, (int)Ps->line_num);
     }
-    mu_check(parser_has_more_commands() == false);
+    parser_advance(Ps);
+    mu_check(parser_has_more_commands(Ps) == false);
 
-    parser_destroy();
+    parser_destroy(Ps);
 }
 
-MU_TEST(test_parser_get_command_type)
+/* Points the stub parser at a line, as `parser_advance()` would */
+static bool lex(char *line, Command *cmd)
 {
-    char str0[] = "@2\n";
-    char str1[] = "(LABEL)\n";
-    char str2[] = "D=A\n";
-    char str3[] = "Nonsense\n";
-    char str4[] = "44\n";
-
-    token = str0;
-    mu_assert_int_eq(A_COMMAND, parser_get_command_type());
-    mu_assert_int_eq(A_COMMAND, command);
-    token = str1;
-    mu_assert_int_eq(L_COMMAND, parser_get_command_type());
-    mu_assert_int_eq(L_COMMAND, command);
-    token = str2;
-    mu_assert_int_eq(C_COMMAND, parser_get_command_type());
-    mu_assert_int_eq(C_COMMAND, command);
-    token = str3;
-    mu_assert_int_eq(C_COMMAND, parser_get_command_type());
-    mu_assert_int_eq(C_COMMAND, command);
-    token = str4;
-    mu_assert_int_eq(C_COMMAND, parser_get_command_type());
-    mu_assert_int_eq(C_COMMAND, command);
+    Stub.buffer = line;
+    Stub.line_len = (ssize_t)strlen(line);
+    return parser_command(&Stub, cmd);
 }
 
-MU_TEST(test_parser_symbol)
+static bool field_eq(const char *s, Field f)
 {
-    char str0[] = "@2";
-    char str1[] = "@19  \n";
-    char str2[] = "@R0\n";
-    char str3[] = "@R2\t// Comment";
-    char str4[] = "@CUSTOM_LABEL";
-    char str5[] = "(LABEL)";
-    char str6[] = "(LABEL_)\n";
-    char str7[] = "(__LABEL)\t\t // Comment";
-    char str8[] = "88";
-    char str9[] = "Nonsense";
-
-    command = A_COMMAND;
-
-    token = str0;
-    mu_assert_string_eq("2", parser_symbol());
-    token = str1;
-    mu_assert_string_eq("19", parser_symbol());
-    token = str2;
-    mu_assert_string_eq("R0", parser_symbol());
-    token = str3;
-    mu_assert_string_eq("R2", parser_symbol());
-    token = str4;
-    mu_assert_string_eq("CUSTOM_LABEL", parser_symbol());
-
-    command = L_COMMAND;
-
-    token = str5;
-    mu_assert_string_eq("LABEL", parser_symbol());
-    token = str6;
-    mu_assert_string_eq("LABEL_", parser_symbol());
-    token = str7;
-    mu_assert_string_eq("__LABEL", parser_symbol());
-    token = str8;
-    mu_assert_string_eq("88", parser_symbol());
-    token = str9;
-    mu_assert_string_eq("Nonsense", parser_symbol());
+    return strlen(s) == f.len && strncmp(s, f.str, f.len) == 0;
 }
 
-MU_TEST(test_parser_dest)
+MU_TEST(test_parser_command_a)
 {
-    char str0[] = "M=D\n";
-    char str1[] = "0;JMP  \n";
-    char str2[] = "D=D-M\n";
-    char str3[] = "0;JMPR2\t// Comment";
+    Command cmd;
+    char str0[] = "@2";
+    char str1[] = "@19";
+    char str2[] = "@R0";
+    char str3[] = "@CUSTOM_LABEL";
+    char str4[] = "@sys.init$ret:1";
+    char str5[] = "@32767";
+    char str6[] = "@007";
+
+    mu_check(lex(str0, &cmd));
+    mu_assert_int_eq(A_COMMAND, cmd.type);
+    mu_assert_int_eq(0, (int)cmd.symbol.len);
+    mu_assert_int_eq(2, cmd.value);
 
-    command = C_COMMAND;
+    mu_check(lex(str1, &cmd));
+    mu_assert_int_eq(19, cmd.value);
 
-    token = str0;
-    mu_assert_string_eq("M", parser_dest());
+    mu_check(lex(str2, &cmd));
+    mu_assert_int_eq(A_COMMAND, cmd.type);
+    mu_assert_string_eq("R0", cmd.symbol.str);
 
-    token = str1;
-    mu_assert_string_eq("", parser_dest());
+    mu_check(lex(str3, &cmd));
+    mu_assert_string_eq("CUSTOM_LABEL", cmd.symbol.str);
 
-    token = str2;
-    mu_assert_string_eq("D", parser_dest());
+    mu_check(lex(str4, &cmd));
+    mu_assert_string_eq("sys.init$ret:1", cmd.symbol.str);
 
-    token = str3;
-    mu_assert_string_eq("", parser_dest());
+    mu_check(lex(str5, &cmd));
+    mu_assert_int_eq(32767, cmd.value);
+
+    mu_check(lex(str6, &cmd));
+    mu_assert_int_eq(7, cmd.value);
 }
 
-MU_TEST(test_parser_comp)
+MU_TEST(test_parser_command_l)
 {
-    char str0[] = "D+1\n";
-    char str1[] = "0;JMP  \n";
-    char str2[] = "D-M\n";
-    char str3[] = "0;JMP\t// Comment";
-    char str4[] = "Bad Input";
+    Command cmd;
+    char str0[] = "(LABEL)";
+    char str1[] = "(LABEL_)";
+    char str2[] = "(__LABEL)";
+    char str3[] = "(a.b$c:1)";
 
-    command = C_COMMAND;
+    mu_check(lex(str0, &cmd));
+    mu_assert_int_eq(L_COMMAND, cmd.type);
+    mu_assert_string_eq("LABEL", cmd.symbol.str);
+    mu_assert_int_eq(5, (int)cmd.symbol.len);
 
-    token = str0;
-    mu_assert_string_eq("D+1", parser_comp());
-    
-    token = str1;
-    mu_assert_string_eq("0", parser_comp());
-    
-    token = str2;
-    mu_assert_string_eq("D-M", parser_comp());
-    
-    token = str3;
-    mu_assert_string_eq("0", parser_comp());
-    
-    token = str4;
-    mu_assert_string_eq("Bad", parser_comp());
+    mu_check(lex(str1, &cmd));
+    mu_assert_string_eq("LABEL_", cmd.symbol.str);
+
+    mu_check(lex(str2, &cmd));
+    mu_assert_string_eq("__LABEL", cmd.symbol.str);
+
+    mu_check(lex(str3, &cmd));
+    mu_assert_string_eq("a.b$c:1", cmd.symbol.str);
 }
 
-MU_TEST(test_parser_jump)
+MU_TEST(test_parser_command_c)
 {
-    char str1[] = "JMP\n";
-    char str2[] = "\n";
-    char str3[] = "JGT\t// Comment";
-    char str4[] = "\t// Comment";
-    char str5[] = "";
+    Command cmd;
+    char str0[] = "M=D";
+    char str1[] = "0;JMP";
+    char str2[] = "D=D-M";
+    char str3[] = "AMD=M+1;JGT";
+    char str4[] = "D|M";
+    char str5[] = "-1";
+
+    mu_check(lex(str0, &cmd));
+    mu_assert_int_eq(C_COMMAND, cmd.type);
+    mu_check(field_eq("M", cmd.dest));
+    mu_check(field_eq("D", cmd.comp));
+    mu_check(field_eq("", cmd.jump));
+
+    mu_check(lex(str1, &cmd));
+    mu_check(field_eq("", cmd.dest));
+    mu_check(field_eq("0", cmd.comp));
+    mu_check(field_eq("JMP", cmd.jump));
+
+    mu_check(lex(str2, &cmd));
+    mu_check(field_eq("D", cmd.dest));
+    mu_check(field_eq("D-M", cmd.comp));
+    mu_check(field_eq("", cmd.jump));
+
+    mu_check(lex(str3, &cmd));
+    mu_check(field_eq("AMD", cmd.dest));
+    mu_check(field_eq("M+1", cmd.comp));
+    mu_check(field_eq("JGT", cmd.jump));
+
+    mu_check(lex(str4, &cmd));
+    mu_check(field_eq("", cmd.dest));
+    mu_check(field_eq("D|M", cmd.comp));
+
+    mu_check(lex(str5, &cmd));
+    mu_check(field_eq("-1", cmd.comp));
+
+    /* Fields are not terminated, the line is left untouched */
+    mu_assert_string_eq("AMD=M+1;JGT", str3);
+}
 
-    command = C_COMMAND;
+MU_TEST(test_parser_command_malformed)
+{
+    Command cmd;
+    char *bad[] = {
+        "@", "@-10", "@32768", "@65535", "@100000", "@1x", "@x y", "@_x-",
+        "()", "(1A)", "(LABEL", "(LABEL))", "(LA BEL)",
+        "=D", "M=", "D;", ";JMP", "M=D=A", "D;JMP;", "D;J1", "Bad Input", "_D",
+    };
+    char line[16];
+    size_t i;
+
+    for (i = 0; i < sizeof(bad) / sizeof(*bad); i++) {
+        strcpy(line, bad[i]);
+        errno = 0;
+        mu_check(lex(line, &cmd) == false);
+        mu_check(errno == EINVAL);
+    }
+    errno = 0;
+}
+
+MU_TEST(test_parser_rewind)
+{
+    Command cmd;
+
+    Ps = parser_init(asm_file);
 
-    token = str1;
-    mu_assert_string_eq("JMP", parser_jump());
+    parser_advance(Ps);
+    mu_check(parser_has_more_commands(Ps) == true);
+    mu_check(parser_command(Ps, &cmd) == true);
+    mu_assert_int_eq(A_COMMAND, cmd.type);
+    mu_assert_int_eq(2, cmd.value);
 
-    token = str2;
-    mu_assert_string_eq("", parser_jump());
+    /* Terminators written during the first pass must not leak into the next */
+    parser_rewind(Ps);
+    mu_check(Ps->map != NULL);
+    mu_assert_int_eq(0, (int)Ps->line_num);
 
-    token = str3;
-    mu_assert_string_eq("JGT", parser_jump());
+    parser_advance(Ps);
+    mu_check(parser_has_more_commands(Ps) == true);
+    mu_assert_string_eq("@2", Ps->buffer);
+    mu_assert_int_eq(8, (int)Ps->line_num);
 
-    token = str4;
-    mu_assert_string_eq("", parser_jump());
+    parser_destroy(Ps);
+}
 
-    token = str5;
-    mu_assert_string_eq("", parser_jump());
+MU_TEST(test_parser_slice)
+{
+    Parser *slice;
+
+    Ps = parser_init(asm_file);
+    mu_assert_int_eq(6, (int)parser_length(Ps));
+
+    /* The third and fourth commands, on lines 10 and 11 */
+    mu_check((slice = parser_slice(Ps, 2, 2)) != NULL);
+    mu_assert_int_eq(2, (int)parser_length(slice));
+    parser_advance(slice);
+    mu_assert_int_eq(10, slice->line_num);
+    parser_advance(slice);
+    mu_assert_int_eq(11, slice->line_num);
+    parser_advance(slice);
+    mu_check(parser_has_more_commands(slice) == false);
+
+    errno = 0;
+    parser_rewind(slice);
+    mu_check(errno == EPERM);
+    errno = 0;
+
+    /* The parser it was taken from is left where it was */
+    mu_assert_int_eq(6, (int)parser_length(Ps));
+    parser_advance(Ps);
+    mu_assert_string_eq("@2", Ps->buffer);
+
+    parser_destroy(slice);
+    parser_destroy(Ps);
+}
+
+MU_TEST(test_parser_stdin)
+{
+    int fds[2];
+    const char src[] = "// Comment\n@2\nD=A";
+    
+    /* A pipe on the standard input can't be mapped, nor rewound */
+    mu_check(pipe(fds) == 0);
+    mu_check(write(fds[1], src, sizeof(src) - 1) == sizeof(src) - 1);
+    close(fds[1]);
+    mu_check(dup2(fds[0], STDIN_FILENO) == STDIN_FILENO);
+    close(fds[0]);
+
+    mu_check((Ps = parser_init("-")) != NULL);
+    mu_check(Ps->buffered == true);
+    mu_assert_int_eq(sizeof(src) - 1, (int)Ps->map_size);
+
+    parser_advance(Ps);
+    mu_check(parser_has_more_commands(Ps) == true);
+    mu_assert_string_eq("@2", Ps->buffer);
+    parser_advance(Ps);
+    mu_check(parser_has_more_commands(Ps) == true);
+    mu_assert_string_eq("D=A", Ps->buffer);
+    parser_advance(Ps);
+    mu_check(parser_has_more_commands(Ps) == false);
+
+    errno = 0;
+    parser_rewind(Ps);
+    mu_check(errno == ESPIPE);
+
+    errno = 0;
+    parser_destroy(Ps);
 }
 
 MU_TEST_SUITE(test_suite) 
 {
 	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
     MU_RUN_TEST(test_is_extension_asm);
-    MU_RUN_TEST(test_discard_leading_withe_spaces);
-    MU_RUN_TEST(test_is_blank_line);
-    MU_RUN_TEST(test_is_comment_line);
     MU_RUN_TEST(test_parser_init);
     MU_RUN_TEST(test_parser_advance);
     MU_RUN_TEST(test_parser_has_more_commands);
-    MU_RUN_TEST(test_parser_get_command_type);
-    MU_RUN_TEST(test_parser_symbol);
-    MU_RUN_TEST(test_parser_dest);
-    MU_RUN_TEST(test_parser_comp);
-    MU_RUN_TEST(test_parser_jump);
+    MU_RUN_TEST(test_parser_command_a);
+    MU_RUN_TEST(test_parser_command_l);
+    MU_RUN_TEST(test_parser_command_c);
+    MU_RUN_TEST(test_parser_command_malformed);
+    MU_RUN_TEST(test_parser_rewind);
+    MU_RUN_TEST(test_parser_slice);
+    MU_RUN_TEST(test_parser_stdin);
 }
 
 int main(int argc, char *argv[]) 
@@ -0,0 +1,104 @@
+#include "minunit.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/hashfuncs.h"
+#include "../include/perfecthash.h"
+
+#define NKEYS 40000
+
+static size_t Hashes[NKEYS];
+static unsigned char Seen[NKEYS];
+
+void test_setup(void)
+{
+    char key[16];
+    int i;
+
+    for (i = 0; i < NKEYS; i++) {
+        sprintf(key, "L.%d", i);
+        Hashes[i] = hash_wyhash(key, strlen(key));
+    }
+    memset(Seen, 0, sizeof(Seen));
+}
+
+void test_teardown(void)
+{
+}
+
+/*
+ * Whether `ph` sends the first `n` hashes to every index below `n`, once each.
+ */
+static int is_minimal_perfect(const PerfectHash *ph, uint32_t n)
+{
+    uint32_t i, index;
+
+    memset(Seen, 0, n);
+    for (i = 0; i < n; i++) {
+        if ((index = perfecthash_index(ph, Hashes[i])) >= n || Seen[index]) {
+            return 0;
+        }
+        Seen[index] = 1;
+    }
+    return 1;
+}
+
+MU_TEST(test_perfecthash_invalid)
+{
+    size_t twice[3];
+
+    errno = 0;
+    mu_check(perfecthash_build(Hashes, 0) == NULL);
+    mu_check(errno == EINVAL);
+
+    twice[0] = Hashes[0];
+    twice[1] = Hashes[1];
+    twice[2] = Hashes[0];
+    errno = 0;
+    mu_check(perfecthash_build(twice, 3) == NULL);
+    mu_check(errno == EINVAL);
+}
+
+MU_TEST(test_perfecthash_small)
+{
+    PerfectHash *ph;
+    uint32_t n;
+
+    /* Every size up to a few buckets, where collisions modulo `n` abound */
+    for (n = 1; n <= 64; n++) {
+        ph = perfecthash_build(Hashes, n);
+        mu_check(ph != NULL);
+        mu_check(is_minimal_perfect(ph, n));
+        perfecthash_destroy(ph);
+    }
+}
+
+MU_TEST(test_perfecthash_large)
+{
+    PerfectHash *ph;
+
+    ph = perfecthash_build(Hashes, NKEYS);
+    mu_check(ph != NULL);
+    mu_check(is_minimal_perfect(ph, NKEYS));
+
+    /* About 2 bytes per key */
+    mu_check(perfecthash_size(ph) <= 3 * NKEYS);
+    perfecthash_destroy(ph);
+}
+
+MU_TEST_SUITE(test_suite)
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_perfecthash_invalid);
+	MU_RUN_TEST(test_perfecthash_small);
+	MU_RUN_TEST(test_perfecthash_large);
+}
+
+int main(int argc, char *argv[])
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
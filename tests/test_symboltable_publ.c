@@ -1,54 +1,238 @@
 #include "minunit.h"
 #include <errno.h>
+#include <stdio.h>
 #include "../include/symboltable.h"
+#include "../include/common/predefined.h"
 #include "../include/common/shared_defs.h"
 
+static SymbolTable *St;
+
 void test_setup(void)
 {
-    symbol_table_init();
+    St = symbol_table_init();
 }
 
 void test_teardown(void)
 {
-    symbol_table_destroy();
+    symbol_table_destroy(St);
 }
 
 MU_TEST(test_symbol_table_init)
 {
-    mu_check(symbol_table_contains("SP") == true);
-    mu_check(symbol_table_contains("LCL") == true);
-    mu_check(symbol_table_contains("THAT") == true);
-    mu_check(symbol_table_contains("SCREEN") == true);
-    mu_check(symbol_table_contains("LOL") == false);
-    mu_check(symbol_table_contains("wut?") == false);
-
-    mu_assert_int_eq(0x0001, symbol_table_get_addr("R1"));
-    mu_assert_int_eq(0x000F, symbol_table_get_addr("R15"));
-    mu_assert_int_eq(ERROR, symbol_table_get_addr("ACK"));
-    mu_assert_int_eq(0x0000, symbol_table_get_addr("SP"));
-    mu_assert_int_eq(0x0002, symbol_table_get_addr("R2"));
-    mu_assert_int_eq(0x0002, symbol_table_get_addr("ARG"));
+    mu_check(symbol_table_contains(St, "SP") == true);
+    mu_check(symbol_table_contains(St, "LCL") == true);
+    mu_check(symbol_table_contains(St, "THAT") == true);
+    mu_check(symbol_table_contains(St, "SCREEN") == true);
+    mu_check(symbol_table_contains(St, "LOL") == false);
+    mu_check(symbol_table_contains(St, "wut?") == false);
+
+    mu_assert_int_eq(0x0001, symbol_table_get_addr(St, "R1"));
+    mu_assert_int_eq(0x000F, symbol_table_get_addr(St, "R15"));
+    mu_assert_int_eq(ERROR, symbol_table_get_addr(St, "ACK"));
+    mu_assert_int_eq(0x0000, symbol_table_get_addr(St, "SP"));
+    mu_assert_int_eq(0x0002, symbol_table_get_addr(St, "R2"));
+    mu_assert_int_eq(0x0002, symbol_table_get_addr(St, "ARG"));
 }
 
 MU_TEST(test_symbol_table_program_symbols)
 {
-    symbol_table_add_entry("LOOP", 0x0A8);
-    mu_check(symbol_table_contains("LOOP") == true);
-    mu_check(symbol_table_get_addr("LOOP") == 0x00A8);
+    symbol_table_add_entry(St, "LOOP", 0x0A8);
+    mu_check(symbol_table_contains(St, "LOOP") == true);
+    mu_check(symbol_table_get_addr(St, "LOOP") == 0x00A8);
+
+    symbol_table_add_entry(St, "LABEL", 0x002B);
+    mu_check(symbol_table_contains(St, "LABEL") == true);
+    mu_check(symbol_table_get_addr(St, "LABEL") == 0x002B);
+
+    symbol_table_add_entry(St, "LABEL", 0x002B);
+    mu_check(errno != 0);
+    errno = 0;
+
+    symbol_table_add_entry(St, "MAIN", 0xBEEF);
+    mu_check(symbol_table_contains(St, "MAIN") == true);
+    mu_check(symbol_table_get_addr(St, "MAIN") == 0xBEEF);
+
+    mu_check(symbol_table_contains(St, "nope") == false);
+}
+
+MU_TEST(test_symbol_table_independent)
+{
+    SymbolTable *other;
+
+    mu_check((other = symbol_table_init()) != NULL);
+
+    symbol_table_add_entry(St, "LOOP", 0x0010);
+    symbol_table_add_entry(other, "LOOP", 0x0020);
+    mu_check(symbol_table_get_addr(St, "LOOP") == 0x0010);
+    mu_check(symbol_table_get_addr(other, "LOOP") == 0x0020);
+    mu_check(symbol_table_contains(other, "SP") == true);
+
+    symbol_table_destroy(other);
+    mu_check(symbol_table_get_addr(St, "LOOP") == 0x0010);
+}
+
+MU_TEST(test_symbol_table_intern)
+{
+    uint32_t loop, i, sp;
+
+    loop = symbol_table_intern(St, "LOOP");
+    i = symbol_table_intern(St, "i");
+    sp = symbol_table_intern(St, "SP");
+
+    mu_check(loop != i && loop != sp && i != sp);
+    mu_check(symbol_table_intern(St, "LOOP") == loop);
+    mu_check(loop + 1 == i);
+
+    /* Interned, not bound */
+    mu_assert_int_eq(ERROR, symbol_table_address(St, loop));
+    mu_check(symbol_table_contains(St, "LOOP") == false);
+    mu_assert_int_eq(0x0000, symbol_table_address(St, sp));
+
+    errno = 0;
+    symbol_table_bind(St, loop, 0x0042, SYMBOL_LABEL);
+    mu_check(errno == 0);
+    mu_assert_int_eq(0x0042, symbol_table_address(St, loop));
+    mu_assert_int_eq(0x0042, symbol_table_get_addr(St, "LOOP"));
+
+    symbol_table_bind(St, loop, 0x0043, SYMBOL_LABEL);
+    mu_check(errno != 0);
+    errno = 0;
+
+    symbol_table_add_entry(St, "i", 0x0010);
+    mu_check(errno == 0);
+    mu_assert_int_eq(0x0010, symbol_table_address(St, i));
+}
+
+MU_TEST(test_symbol_table_many)
+{
+    char symbol[16];
+    int i;
 
-    symbol_table_add_entry("LABEL", 0x002B);
-    mu_check(symbol_table_contains("LABEL") == true);
-    mu_check(symbol_table_get_addr("LABEL") == 0x002B);
+    /* Far more than the table is sized for at first, there is no cap */
+    for (i = 0; i < 100000; i++) {
+        sprintf(symbol, "L.%d", i);
+        errno = 0;
+        symbol_table_add_entry(St, symbol, (uint16_t)(i & 0x7FFF));
+        mu_check(errno == 0);
+    }
+    for (i = 0; i < 100000; i++) {
+        sprintf(symbol, "L.%d", i);
+        mu_assert_int_eq(i & 0x7FFF, symbol_table_get_addr(St, symbol));
+    }
+    mu_assert_int_eq(0x4000, symbol_table_get_addr(St, "SCREEN"));
+}
+
+MU_TEST(test_symbol_table_predefined)
+{
+    HashTableStats stats;
+    uint32_t i;
 
-    symbol_table_add_entry("LABEL", 0x002B);
+    /* Every predefined symbol is its index, without a hash table entry */
+    for (i = 0; i < ARRAY_SIZE(PredefinedSymbols); i++) {
+        mu_check(symbol_table_intern(St, PredefinedSymbols[i].symbol) == i);
+        mu_check(symbol_table_address(St, i) == PredefinedSymbols[i].bits);
+    }
+    symbol_table_stats(St, &stats);
+    mu_check(stats.nelems == 0);
+
+    /* Near misses are program symbols */
+    mu_check(symbol_table_contains(St, "R16") == false);
+    mu_check(symbol_table_contains(St, "R1X") == false);
+    mu_check(symbol_table_contains(St, "R") == false);
+    mu_check(symbol_table_contains(St, "sp") == false);
+    mu_check(symbol_table_contains(St, "SPX") == false);
+    mu_check(symbol_table_contains(St, "SCREAN") == false);
+    mu_check(symbol_table_contains(St, "THAN") == false);
+    mu_check(symbol_table_contains(St, "") == false);
+    mu_check(symbol_table_intern(St, "R16") == ARRAY_SIZE(PredefinedSymbols));
+
+    /* And predefined symbols can't be redefined */
+    symbol_table_add_entry(St, "KBD", 0x0001);
     mu_check(errno != 0);
     errno = 0;
+    mu_assert_int_eq(0x6000, symbol_table_get_addr(St, "KBD"));
+}
+
+MU_TEST(test_symbol_table_freeze)
+{
+    HashTableStats stats;
+    char symbol[16];
+    uint32_t var, late;
+    int i;
+
+    mu_check(symbol_table_freeze(St) == true);
+    mu_check(symbol_table_frozen(St) == 0);
+
+    for (i = 0; i < 5000; i++) {
+        sprintf(symbol, "L.%d", i);
+        symbol_table_add_entry(St, symbol, (uint16_t)i);
+    }
+    var = symbol_table_intern(St, "var");
+
+    errno = 0;
+    mu_check(symbol_table_freeze(St) == true);
+    mu_check(errno == 0);
+    mu_check(symbol_table_frozen(St) == 5001);
+    symbol_table_stats(St, &stats);
+    mu_check(stats.nelems == 0);
+
+    /* Same IDs and addresses, and a symbol unbound when frozen can be bound */
+    for (i = 0; i < 5000; i++) {
+        sprintf(symbol, "L.%d", i);
+        mu_assert_int_eq(i, symbol_table_get_addr(St, symbol));
+    }
+    mu_check(symbol_table_intern(St, "var") == var);
+    mu_check(symbol_table_contains(St, "var") == false);
+    symbol_table_bind(St, var, 0x0010, SYMBOL_VARIABLE);
+    mu_assert_int_eq(0x0010, symbol_table_get_addr(St, "var"));
+    mu_assert_int_eq(0x4000, symbol_table_get_addr(St, "SCREEN"));
+
+    /* Misses, near ones included, go to the side table */
+    mu_check(symbol_table_contains(St, "L.5000") == false);
+    mu_check(symbol_table_contains(St, "L.") == false);
+    late = symbol_table_intern(St, "late");
+    mu_check(late == var + 1);
+    symbol_table_add_entry(St, "L.1", 0x0001);
+    mu_check(errno != 0);
+    errno = 0;
+    symbol_table_stats(St, &stats);
+    mu_check(stats.nelems == 1);
+
+    /* Freezing again takes in the side table */
+    mu_check(symbol_table_freeze(St) == true);
+    mu_check(symbol_table_frozen(St) == 5002);
+    mu_check(symbol_table_intern(St, "late") == late);
+    mu_assert_int_eq(0x0010, symbol_table_get_addr(St, "var"));
+}
+
+MU_TEST(test_symbol_table_lookup_or_insert)
+{
+    unsigned long hits, misses;
+    uint32_t id, ret;
+    int i;
+
+    /* New, interned unbound */
+    mu_assert_int_eq(ERROR, symbol_table_lookup_or_insert(St, "ret", &ret));
+    mu_check(ret == symbol_table_intern(St, "ret"));
+    symbol_table_bind(St, ret, 0x0123, SYMBOL_LABEL);
+    mu_assert_int_eq(0x0123, symbol_table_lookup_or_insert(St, "ret", &id));
+    mu_check(id == ret);
+    mu_assert_int_eq(0x0004, symbol_table_lookup_or_insert(St, "THAT", &id));
+    mu_check(id == 9);
 
-    symbol_table_add_entry("MAIN", 0xBEEF);
-    mu_check(symbol_table_contains("MAIN") == true);
-    mu_check(symbol_table_get_addr("MAIN") == 0xBEEF);
+    /* Repeats hit the hot cache, predefined symbols never count */
+    symbol_table_cache_stats(St, &hits, &misses);
+    mu_check(hits == 2 && misses == 1);
+    for (i = 0; i < 100; i++) {
+        mu_assert_int_eq(0x0123, symbol_table_lookup_or_insert(St, "ret", &id));
+        symbol_table_lookup_or_insert(St, "SP", &id);
+    }
+    symbol_table_cache_stats(St, &hits, &misses);
+    mu_check(hits == 102 && misses == 1);
 
-    mu_check(symbol_table_contains("nope") == false);
+    /* A name sharing the length and the tail of a cached one is no hit */
+    mu_assert_int_eq(ERROR, symbol_table_lookup_or_insert(St, "Ret", &id));
+    mu_check(id != ret);
 }
 
 MU_TEST_SUITE(test_suite) 
@@ -56,6 +240,12 @@ MU_TEST_SUITE(test_suite)
 	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
 	MU_RUN_TEST(test_symbol_table_init);
 	MU_RUN_TEST(test_symbol_table_program_symbols);
+	MU_RUN_TEST(test_symbol_table_independent);
+	MU_RUN_TEST(test_symbol_table_intern);
+	MU_RUN_TEST(test_symbol_table_many);
+	MU_RUN_TEST(test_symbol_table_predefined);
+	MU_RUN_TEST(test_symbol_table_freeze);
+	MU_RUN_TEST(test_symbol_table_lookup_or_insert);
 }
 
 int main(int argc, char *argv[]) 
@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200809L
+#include "minunit.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "../include/symmap.h"
+#include "../include/symboltable.h"
+
+#define SNAPSHOT "tests/bin/test_symmap.symtab"
+
+static SymbolTable *St;
+
+void test_setup(void)
+{
+    uint32_t id;
+
+    St = symbol_table_init();
+    symbol_table_add_entry(St, "LOOP", 0x0004);
+    symbol_table_add_entry(St, "END", 0x0002);
+    symbol_table_add_entry(St, "ALSO_END", 0x0002);
+    id = symbol_table_intern(St, "i");
+    symbol_table_bind(St, id, 0x0010, SYMBOL_VARIABLE);
+
+    /* Interned, never bound: left out of the maps */
+    symbol_table_intern(St, "unbound");
+}
+
+void test_teardown(void)
+{
+    symbol_table_destroy(St);
+}
+
+MU_TEST(test_symmap_text)
+{
+    char line[64];
+    FILE *out;
+
+    mu_check((out = tmpfile()) != NULL);
+    mu_check(symmap_write_text(St, out));
+    rewind(out);
+
+    /* Labels first, by address then name */
+    fgets(line, sizeof(line), out);
+    mu_assert_string_eq("ROM 0002 label      ALSO_END\n", line);
+    fgets(line, sizeof(line), out);
+    mu_assert_string_eq("ROM 0002 label      END\n", line);
+    fgets(line, sizeof(line), out);
+    mu_assert_string_eq("ROM 0004 label      LOOP\n", line);
+    fgets(line, sizeof(line), out);
+    mu_assert_string_eq("RAM 0000 predefined R0\n", line);
+    fgets(line, sizeof(line), out);
+    mu_assert_string_eq("RAM 0000 predefined SP\n", line);
+
+    while (fgets(line, sizeof(line), out) != NULL) {
+        if (strstr(line, " i\n") != NULL) {
+            mu_assert_string_eq("RAM 0010 variable   i\n", line);
+        }
+        mu_check(strstr(line, "unbound") == NULL);
+    }
+    fclose(out);
+}
+
+MU_TEST(test_symmap_snapshot)
+{
+    SymMap *map;
+
+    mu_check(symmap_write_snapshot(St, SNAPSHOT));
+    mu_check((map = symmap_open(SNAPSHOT)) != NULL);
+
+    /* 23 predefined symbols, 3 labels and a variable */
+    mu_check(symmap_count(map) == 27);
+    mu_assert_string_eq("ALSO_END", symmap_find(map, SYMMAP_ROM, 0x0002));
+    mu_assert_string_eq("LOOP", symmap_find(map, SYMMAP_ROM, 0x0004));
+    mu_check(symmap_find(map, SYMMAP_ROM, 0x0003) == NULL);
+    mu_check(symmap_find(map, SYMMAP_ROM, 0x0010) == NULL);
+    mu_assert_string_eq("i", symmap_find(map, SYMMAP_RAM, 0x0010));
+    mu_assert_string_eq("R0", symmap_find(map, SYMMAP_RAM, 0x0000));
+    mu_assert_string_eq("KBD", symmap_find(map, SYMMAP_RAM, 0x6000));
+    mu_check(symmap_find(map, SYMMAP_RAM, 0x7FFF) == NULL);
+
+    symmap_close(map);
+    remove(SNAPSHOT);
+}
+
+MU_TEST(test_symmap_invalid)
+{
+    FILE *out;
+
+    errno = 0;
+    mu_check(symmap_open("tests/bin/no_such.symtab") == NULL);
+    mu_check(errno == ENOENT);
+
+    /* Truncated snapshot */
+    mu_check(symmap_write_snapshot(St, SNAPSHOT));
+    truncate(SNAPSHOT, 40);
+    errno = 0;
+    mu_check(symmap_open(SNAPSHOT) == NULL);
+    mu_check(errno == EINVAL);
+
+    /* Not a snapshot at all */
+    out = fopen(SNAPSHOT, "w");
+    fputs("ROM 0000 label      LOOP\n", out);
+    fclose(out);
+    mu_check(symmap_open(SNAPSHOT) == NULL);
+    mu_check(errno == EINVAL);
+    remove(SNAPSHOT);
+}
+
+MU_TEST_SUITE(test_suite)
+{
+	MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
+	MU_RUN_TEST(test_symmap_text);
+	MU_RUN_TEST(test_symmap_snapshot);
+	MU_RUN_TEST(test_symmap_invalid);
+}
+
+int main(int argc, char *argv[])
+{
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+
+	return MU_EXIT_CODE;
+}
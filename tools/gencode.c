@@ -0,0 +1,121 @@
+/*
+ * Build-time generator of the mnemonic hash tables of `code.c`.
+ *
+ * For each table of `common/mnemonics.h`, searches for the smallest power of
+ * two size and a multiplier such that `(key * multiplier) >> shift` sends every
+ * mnemonic key to a slot of its own: a perfect hash.  The slots are then
+ * printed as C initializers to the standard output, the encoded bits already
+ * shifted into place.  Empty slots hold the impossible key `UINT32_MAX` and
+ * `ERROR`.
+ *
+ * Usage: gencode > code_hash.h
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/mnemonics.h"
+
+#define MAX_BITS 8                  /* Largest table tried, 256 slots */
+#define TRIES (1UL << 20)           /* Multipliers tried per size */
+
+static bool emit(const char *, const char *, const SymbolAddressPair [],
+                 size_t, unsigned);
+static bool is_perfect(const SymbolAddressPair [], size_t, uint32_t, unsigned);
+
+int
+main(void)
+{
+    printf("/*\n"
+           " * Generated by tools/gencode.c from common/mnemonics.h, do not "
+           "edit.\n"
+           " */\n"
+           "#ifndef CODE_HASH_H\n"
+           "#define CODE_HASH_H\n");
+
+    if (!emit("Dest", "DEST", Destinations, ARRAY_SIZE(Destinations), 3) ||
+        !emit("Comp", "COMP", Computations, ARRAY_SIZE(Computations), 6) ||
+        !emit("Jump", "JUMP", Jumps, ARRAY_SIZE(Jumps), 0)) {
+        return EXIT_FAILURE;
+    }
+
+    printf("\n#endif /* CODE_HASH_H */\n");
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Prints the multiplier and shift macros, prefixed with `macro`, and the slots
+ * of the table `name`, its bits shifted left by `shift`.  Returns `false` if no
+ * perfect hash was found.
+ */
+static bool
+emit(const char *name, const char *macro, const SymbolAddressPair pairs[],
+     size_t n, unsigned shift)
+{
+    uint32_t multiplier, key = 0;
+    unsigned bits, slot;
+    unsigned long t;
+    size_t j;
+
+    for (bits = 1; (1UL << bits) < n; bits++)
+        ;
+
+    for ( ; bits <= MAX_BITS; bits++) {
+        for (t = 0; t < TRIES; t++) {
+            multiplier = (uint32_t)(t * 2654435761UL) | 1;
+            if (is_perfect(pairs, n, multiplier, bits)) {
+                goto found;
+            }
+        }
+    }
+    fprintf(stderr, "gencode: no perfect hash for %s\n", name);
+    return false;
+
+found:
+    printf("\n#define %s_MULTIPLIER 0x%08XU\n", macro, multiplier);
+    printf("#define %s_SHIFT %u\n\n", macro, 32 - bits);
+    printf("static const Slot %sSlots[%u] = {\n", name, 1U << bits);
+
+    for (slot = 0; slot < 1U << bits; slot++) {
+        for (j = 0; j < n; j++) {
+            key = mnemonic_key(pairs[j].symbol,
+                               (uint32_t)strlen(pairs[j].symbol));
+            if ((uint32_t)(key * multiplier) >> (32 - bits) == slot) {
+                break;
+            }
+        }
+        if (j == n) {
+            printf("    {0xFFFFFFFFU, 0x%04X},\n", ERROR);
+        } else {
+            printf("    {0x%08XU, 0x%04X},   /* \"%s\" */\n", key,
+                   (unsigned)(pairs[j].bits << shift), pairs[j].symbol);
+        }
+    }
+    printf("};\n");
+    return true;
+}
+
+/*
+ * Whether `multiplier` sends the `n` keys to distinct slots of a table of
+ * `1 << bits` slots.
+ */
+static bool
+is_perfect(const SymbolAddressPair pairs[], size_t n, uint32_t multiplier,
+           unsigned bits)
+{
+    bool used[1U << MAX_BITS] = {false};
+    uint32_t key, slot;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        key = mnemonic_key(pairs[i].symbol, (uint32_t)strlen(pairs[i].symbol));
+        slot = (uint32_t)(key * multiplier) >> (32 - bits);
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+/*
+ * Build-time generator of the predefined symbol matcher of `symboltable.c`.
+ *
+ * Prints to the standard output a function that switches on the length of a
+ * string, then on its first and last bytes packed together, and compares the
+ * bytes in between against the one predefined symbol left, if any.  Symbols of
+ * up to two bytes are matched by the switches alone.  The function returns the
+ * index of the symbol in `PredefinedSymbols`, or `UINT32_MAX`.
+ *
+ * Fails if two symbols share their length, first and last bytes: the matcher
+ * would need one more level.
+ *
+ * Usage: gensymbols > predefined_match.h
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/predefined.h"
+
+static size_t max_length(void);
+static uint32_t edge_key(const char *);
+static int is_unique(size_t);
+
+int
+main(void)
+{
+    const char *s;
+    size_t len, i;
+
+    for (i = 0; i < ARRAY_SIZE(PredefinedSymbols); i++) {
+        if (!is_unique(i)) {
+            fprintf(stderr, "gensymbols: \"%s\" shares its length, first and "
+                    "last bytes\n", PredefinedSymbols[i].symbol);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("/*\n"
+           " * Generated by tools/gensymbols.c from common/predefined.h, do "
+           "not edit.\n"
+           " */\n"
+           "#ifndef PREDEFINED_MATCH_H\n"
+           "#define PREDEFINED_MATCH_H\n\n"
+           "/*\n"
+           " * Returns the index in `PredefinedSymbols` of the `len` bytes "
+           "`s`, or\n"
+           " * `UINT32_MAX` if they aren't a predefined symbol.\n"
+           " */\n"
+           "static inline uint32_t\n"
+           "predefined_index(const char *s, size_t len)\n"
+           "{\n"
+           "    switch (len) {\n");
+
+    for (len = 1; len <= max_length(); len++) {
+        for (i = 0; i < ARRAY_SIZE(PredefinedSymbols); i++) {
+            if (strlen(PredefinedSymbols[i].symbol) == len) {
+                break;
+            }
+        }
+        if (i == ARRAY_SIZE(PredefinedSymbols)) {
+            continue;
+        }
+
+        printf("    case %zu:\n"
+               "        switch ((uint32_t)(uint8_t)s[0] << 8 | "
+               "(uint8_t)s[%zu]) {\n", len, len - 1);
+        for ( ; i < ARRAY_SIZE(PredefinedSymbols); i++) {
+            s = PredefinedSymbols[i].symbol;
+            if (strlen(s) != len) {
+                continue;
+            }
+            printf("        case 0x%04X:   /* \"%s\" */\n", edge_key(s), s);
+            if (len <= 2) {
+                printf("            return %zu;\n", i);
+            } else {
+                printf("            return memcmp(s + 1, \"%.*s\", %zu) == 0 "
+                       "? %zu : UINT32_MAX;\n", (int)(len - 2), s + 1,
+                       len - 2, i);
+            }
+        }
+        printf("        }\n"
+               "        break;\n");
+    }
+
+    printf("    }\n"
+           "    return UINT32_MAX;\n"
+           "}\n\n"
+           "#endif /* PREDEFINED_MATCH_H */\n");
+    return EXIT_SUCCESS;
+}
+
+static size_t
+max_length(void)
+{
+    size_t i, len, max = 0;
+
+    for (i = 0; i < ARRAY_SIZE(PredefinedSymbols); i++) {
+        len = strlen(PredefinedSymbols[i].symbol);
+        max = len > max ? len : max;
+    }
+    return max;
+}
+
+/*
+ * The first and last bytes of `s`, as the generated switch packs them.
+ */
+static uint32_t
+edge_key(const char *s)
+{
+    return (uint32_t)(uint8_t)s[0] << 8 | (uint8_t)s[strlen(s) - 1];
+}
+
+/*
+ * Whether no symbol before the `i`th shares its length and edge bytes.
+ */
+static int
+is_unique(size_t i)
+{
+    const char *s = PredefinedSymbols[i].symbol;
+    size_t j;
+
+    for (j = 0; j < i; j++) {
+        if (strlen(PredefinedSymbols[j].symbol) == strlen(s) &&
+            edge_key(PredefinedSymbols[j].symbol) == edge_key(s)) {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,283 @@
+/*
+ * Benchmark of the hash function suite over the symbols of Hack programs.
+ *
+ * Collects every symbol of the `.asm` files given, as `@symbol` and `(LABEL)`,
+ * the way the symbol table keys them: the bare name and its length, without
+ * the terminating null.  Then, for each hash function, reports:
+ *
+ * + Collisions of the full hash between distinct symbols.
+ * + The longest and mean chain of a table with one bucket per distinct symbol,
+ *   rounded up to a power of two, indexed by the low bits of the raw hash.
+ * + Nanoseconds per hash over the distinct symbols.
+ * + Nanoseconds per lookup in a `HashTableADT`, replaying every use of a
+ *   symbol in program order.
+ * + Nanoseconds per lookup replaying the same uses in a table generated by
+ *   `DEFINE_HASHTABLE()`, keyed as the `SymbolMap` of `symboltable.c` is, but
+ *   hashing through a pointer to the function.
+ *
+ * A last row replays them in the `SymbolMap` itself, its hash expanded in
+ * place, so the one the symbol table ships with can be told apart.
+ *
+ * Usage: hashbench file.asm...
+ */
+#define _POSIX_C_SOURCE 200809L     /* clock_gettime() */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hashfuncs.h"
+#include "hashtable_adt.h"
+#include "hashtable_tmpl.h"
+
+#define MAX_LINE 512
+#define ROUNDS 200
+
+/*
+ * Same key, hash and equality as the `SymbolMap` of `symboltable.c`.
+ */
+typedef struct Name {
+    const char *str;
+    size_t len;
+} Name;
+
+#define NAME_HASH(k) hash_wyhash((k).str, (k).len)
+#define PTR_HASH(k) Hash((k).str, (k).len)
+#define NAME_EQ(a, b) \
+    ((a).len == (b).len && memcmp((a).str, (b).str, (a).len) == 0)
+
+static HashFunction *Hash;      /* Hash of `PtrMap`, the one reported */
+
+DEFINE_HASHTABLE(SymbolMap, Name, uint32_t, NAME_HASH, NAME_EQ)
+DEFINE_HASHTABLE(PtrMap, Name, uint32_t, PTR_HASH, NAME_EQ)
+
+typedef struct Symbols {
+    Name *names;                /* Distinct symbols */
+    size_t count;
+    uint32_t *uses;             /* Every use, as an index into `names` */
+    size_t nuses;
+} Symbols;
+
+static void collect(const char *, Symbols *, SymbolMap *);
+static void report(const char *, HashFunction *, const Symbols *);
+static double SymbolMap_lookups(const Symbols *);
+static double PtrMap_lookups(const Symbols *);
+static void *append(void *, size_t *, size_t, const void *, size_t);
+static double now(void);
+static int compare_hashes(const void *, const void *);
+
+static volatile size_t Sink;    /* Keeps the hashing loops alive */
+
+int
+main(int argc, char *argv[])
+{
+    Symbols s = {NULL, 0, NULL, 0};
+    SymbolMap seen;
+    const char *name;
+    size_t i;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s file.asm...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!SymbolMap_init(&seen, 1024, NULL)) {
+        perror("hashbench SymbolMap_init");
+        return EXIT_FAILURE;
+    }
+    for (i = 1; i < (size_t)argc; i++) {
+        collect(argv[i], &s, &seen);
+    }
+    SymbolMap_destroy(&seen);
+
+    printf("%zu distinct symbols, %zu uses\n\n", s.count, s.nuses);
+    printf("%-9s %10s %9s %10s %9s %11s %11s\n", "hash", "collisions",
+           "max chain", "mean chain", "ns/hash", "ns/lookup", "ns/tmpl");
+    for (i = 0; (name = hash_name(i)) != NULL; i++) {
+        report(name, hash_select(name), &s);
+    }
+    printf("%-9s %10s %9s %10s %9s %11s %11.2f\n", "SymbolMap", "", "", "",
+           "", "", SymbolMap_lookups(&s));
+
+    for (i = 0; i < s.count; i++) {
+        free((char *)s.names[i].str);
+    }
+    free(s.names);
+    free(s.uses);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Appends the symbols of `path` to `s`, using `seen` to keep them distinct.
+ */
+static void
+collect(const char *path, Symbols *s, SymbolMap *seen)
+{
+    char line[MAX_LINE], *p, *end;
+    uint32_t *found, id;
+    Name name;
+    FILE *f;
+
+    if ((f = fopen(path, "r")) == NULL) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        for (p = line; *p == ' ' || *p == '\t'; p++)
+            ;
+        if ((*p != '@' || (p[1] >= '0' && p[1] <= '9')) && *p != '(') {
+            continue;
+        }
+        for (end = ++p; *end && !strchr(") \t\r\n/", *end); end++)
+            ;
+        *end = '\0';
+
+        name.str = p;
+        name.len = (size_t)(end - p);
+        if ((found = SymbolMap_find(seen, name)) != NULL) {
+            id = *found;
+        } else {
+            id = (uint32_t)s->count;
+            name.str = strdup(p);
+            SymbolMap_insert(seen, name, id);
+            s->names = append(s->names, &s->count, sizeof(Name), &name,
+                              sizeof(Name));
+        }
+        s->uses = append(s->uses, &s->nuses, sizeof(uint32_t), &id,
+                         sizeof(uint32_t));
+    }
+    fclose(f);
+}
+
+static void
+report(const char *name, HashFunction *fn, const Symbols *s)
+{
+    size_t *hashes, *chains, nbuckets, i, r, collisions, max, used;
+    HashTableADT *ht;
+    const Name *n;
+    double t0, hash_ns, lookup_ns;
+
+    hashes = malloc(s->count * sizeof(size_t));
+    for (i = 0; i < s->count; i++) {
+        hashes[i] = fn(s->names[i].str, s->names[i].len);
+    }
+
+    for (nbuckets = 1; nbuckets < s->count; nbuckets *= 2)
+        ;
+    chains = calloc(nbuckets, sizeof(size_t));
+    max = used = 0;
+    for (i = 0; i < s->count; i++) {
+        if (chains[hashes[i] & (nbuckets - 1)]++ == 0) {
+            used++;
+        }
+        if (chains[hashes[i] & (nbuckets - 1)] > max) {
+            max = chains[hashes[i] & (nbuckets - 1)];
+        }
+    }
+
+    qsort(hashes, s->count, sizeof(size_t), compare_hashes);
+    for (collisions = 0, i = 1; i < s->count; i++) {
+        collisions += hashes[i] == hashes[i - 1];
+    }
+
+    t0 = now();
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < s->count; i++) {
+            Sink += fn(s->names[i].str, s->names[i].len);
+        }
+    }
+    hash_ns = (now() - t0) * 1e9 / (double)(ROUNDS * s->count);
+
+    ht = cadthashtable_new(s->count, fn, NULL);
+    for (i = 0; i < s->count; i++) {
+        cadthashtable_insert(ht, s->names[i].str, s->names[i].len,
+                             &s->names[i]);
+    }
+    t0 = now();
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < s->nuses; i++) {
+            n = &s->names[s->uses[i]];
+            Sink += (size_t)cadthashtable_lookup(ht, n->str, n->len);
+        }
+    }
+    lookup_ns = (now() - t0) * 1e9 / (double)(ROUNDS * s->nuses);
+    cadthashtable_destroy(ht);
+
+    Hash = fn;
+    printf("%-9s %10zu %9zu %10.2f %9.2f %11.2f %11.2f\n", name, collisions,
+           max, used ? (double)s->count / (double)used : 0.0, hash_ns,
+           lookup_ns, PtrMap_lookups(s));
+
+    free(chains);
+    free(hashes);
+}
+
+/*
+ * Nanoseconds per lookup replaying every use in `SymbolMap`, then in `PtrMap`
+ * hashing with `Hash`.  Both are filled with the distinct symbols first.
+ */
+#define MAP_LOOKUPS(map)                                                      \
+static double                                                                 \
+map##_lookups(const Symbols *s)                                               \
+{                                                                             \
+    size_t i, r;                                                              \
+    double t0, ns;                                                            \
+    map t;                                                                    \
+                                                                              \
+    if (!map##_init(&t, s->count, NULL)) {                                    \
+        perror("hashbench " #map "_init");                                    \
+        exit(EXIT_FAILURE);                                                   \
+    }                                                                         \
+    for (i = 0; i < s->count; i++) {                                          \
+        map##_insert(&t, s->names[i], (uint32_t)i);                           \
+    }                                                                         \
+    t0 = now();                                                               \
+    for (r = 0; r < ROUNDS; r++) {                                            \
+        for (i = 0; i < s->nuses; i++) {                                      \
+            Sink += *map##_find(&t, s->names[s->uses[i]]);                    \
+        }                                                                     \
+    }                                                                         \
+    ns = (now() - t0) * 1e9 / (double)(ROUNDS * s->nuses);                    \
+    map##_destroy(&t);                                                        \
+    return ns;                                                                \
+}
+
+MAP_LOOKUPS(SymbolMap)
+MAP_LOOKUPS(PtrMap)
+
+/*
+ * Appends the `size` bytes at `elem` to the array `base` of `*count` elements
+ * of `width` bytes, reallocating it.  Exits on failure.
+ */
+static void *
+append(void *base, size_t *count, size_t width, const void *elem, size_t size)
+{
+    char *grown;
+
+    if ((grown = realloc(base, (*count + 1) * width)) == NULL) {
+        perror("hashbench realloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(grown + *count * width, elem, size);
+    (*count)++;
+    return grown;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int
+compare_hashes(const void *a, const void *b)
+{
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,157 @@
+/*
+ * Benchmark of the conversions between words and `.hack` text.
+ *
+ * Formats an array of pseudo-random words, then parses the text back, and
+ * reports gigabytes of text per second for:
+ *
+ * + The bit-by-bit loop and one `fputc()` per character, the way
+ *   `write_to_binary_stream()` used to, to `/dev/null`.
+ * + `emitter_word()`, the way `write_to_binary_stream()` does now, to
+ *   `/dev/null`.
+ * + `hacktext_format()` and `hacktext_parse()` into memory, with every kernel
+ *   the CPU supports.
+ *
+ * Usage: textbench [words]
+ */
+#define _POSIX_C_SOURCE 200809L     /* clock_gettime(), fileno() */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "emitter.h"
+#include "hacktext.h"
+
+#define DEFAULT_WORDS (1 << 20)
+#define MIN_SECONDS 0.5             /* Every measure runs at least as long */
+
+static double measure(void (*)(void));
+static void stdio_loop(void);
+static void emitter_loop(void);
+static void format_loop(void);
+static void parse_loop(void);
+static double now(void);
+
+static uint16_t *Words;
+static size_t Count;
+static char *Text;
+static FILE *Null;
+static volatile size_t Sink;    /* Keeps the parsing loop alive */
+
+int
+main(int argc, char *argv[])
+{
+    HackTextKernel k;
+    size_t i;
+    uint32_t x = 2463534242u;
+
+    Count = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_WORDS;
+    Words = malloc(Count * sizeof(uint16_t));
+    Text = malloc(Count * HACKTEXT_LINE);
+    if (Count == 0 || Words == NULL || Text == NULL ||
+        (Null = fopen("/dev/null", "w")) == NULL) {
+        fprintf(stderr, "Usage: %s [words]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < Count; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        Words[i] = (uint16_t)x;
+    }
+
+    printf("%zu words, %zu bytes of text\n\n", Count, Count * HACKTEXT_LINE);
+    printf("%-28s %8s\n", "conversion", "GB/s");
+    printf("%-28s %8.2f\n", "bit loop + fputc() (old)", measure(stdio_loop));
+    printf("%-28s %8.2f\n", "emitter_word()", measure(emitter_loop));
+    for (k = HACKTEXT_SCALAR; k <= HACKTEXT_AVX2; k++) {
+        if (!hacktext_select(k)) {
+            continue;
+        }
+        printf("format %-21s %8.2f\n", hacktext_kernel_name(k),
+               measure(format_loop));
+        printf("parse  %-21s %8.2f\n", hacktext_kernel_name(k),
+               measure(parse_loop));
+    }
+
+    fclose(Null);
+    free(Words);
+    free(Text);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Runs `loop` over all the words until `MIN_SECONDS` passed, and returns the
+ * rate in gigabytes of text per second.
+ */
+static double
+measure(void (*loop)(void))
+{
+    double t0, elapsed;
+    size_t rounds;
+
+    hacktext_format(Words, Count, Text);
+    loop();                     /* Warm up */
+    t0 = now();
+    rounds = 0;
+    do {
+        loop();
+        rounds++;
+    } while ((elapsed = now() - t0) < MIN_SECONDS);
+    return (double)(rounds * Count * HACKTEXT_LINE) / elapsed * 1e-9;
+}
+
+static void
+stdio_loop(void)
+{
+    uint16_t mask;
+    size_t i, j;
+
+    for (i = 0; i < Count; i++) {
+        mask = 0x8000;
+        for (j = 0; j < 16; j++) {
+            fputc((Words[i] & mask) ? '1' : '0', Null);
+            mask >>= 1;
+        }
+        fputc('\n', Null);
+    }
+}
+
+static void
+emitter_loop(void)
+{
+    Emitter *em;
+    size_t i;
+
+    em = emitter_init(fileno(Null), EMITTER_HACK);
+    for (i = 0; i < Count; i++) {
+        emitter_word(em, Words[i]);
+    }
+    emitter_flush(em);
+    emitter_destroy(em);
+}
+
+static void
+format_loop(void)
+{
+    hacktext_format(Words, Count, Text);
+}
+
+static void
+parse_loop(void)
+{
+    size_t n;
+
+    hacktext_parse(Text, Count * HACKTEXT_LINE, Words, &n);
+    Sink += n;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}